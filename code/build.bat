@@ -1,7 +1,7 @@
 @echo off
 
 
-set FLAGS=-Zi -Od -nologo  -Fe"arcade_game.exe"
+set FLAGS=-Zi -Od -nologo -fp:precise -Fe"arcade_game.exe"
 set ADD_INC=/I ../include
 set LIBS=../lib/raylibdll.lib
 
@@ -0,0 +1,10 @@
+@echo off
+
+set FLAGS=-O2 -Zi -nologo -fp:precise
+set ADD_INC=/I ../include
+
+cd ../build
+cl %FLAGS% -Fe"game_test.exe" %ADD_INC% ../code/main_test.cpp
+cl %FLAGS% -Fe"game_test_30hz.exe" -DSIM_TICKS_PER_SECOND=30 %ADD_INC% ../code/main_test.cpp
+cl %FLAGS% -Fe"game_test_det.exe" -DGAME_DETERMINISTIC=1 %ADD_INC% ../code/main_test.cpp
+cd ../code
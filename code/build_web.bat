@@ -1,6 +1,6 @@
 @echo off
 
-set FLAGS=-std=c++14 -Os -Wall  -Wno-missing-braces
+set FLAGS=-std=c++14 -Os -ffp-contract=off -Wall  -Wno-missing-braces
 set FLAGS=%FLAGS% ../lib/libraylib.a -I. -I../include/ -L. -L../lib/libraylib.a 
 set FLAGS=%FLAGS% -s TOTAL_MEMORY=67108864 -s USE_GLFW=3 --shell-file minshell.html
 set FLAGS=%FLAGS% --preload-file ../run_tree/imgs/ --preload-file ../run_tree/fonts/
@@ -1,10 +1,23 @@
 #include "game_base.cpp"
+#include "game_bit_set.cpp"
+#include "game_atomic.cpp"
+#include "game_sort.cpp"
+#include "game_jobs.cpp"
+#include "game_cpu.cpp"
 #include "game_math.cpp"
+#include "game_fixed.cpp"
 #include "game_memory.cpp"
+#include "game_contacts.cpp"
+#include "game_kinematics.cpp"
 
 #include "game_asset_catalog.cpp"
 #include "game_timer.cpp"
+#include "game_timing_wheel.cpp"
+#include "game_script.cpp"
 #include "game_random.cpp"
+#include "game_hash.cpp"
+#include "game_replay.cpp"
+#include "game_snapshot.cpp"
 
 #include "game_draw.cpp"
 
@@ -35,6 +48,7 @@ b32 check_circle_vs_circle(Vec2 p0, f32 r0, Vec2 p1, f32 r1) {
 }
 
 f32 random_angle(void) { return(2.0f*Pi32*random_f32()); }
+f32 random_angle(Random_Series* series) { return(2.0f*Pi32*random_f32(series)); }
 
 Vec2 random_offscreen_pos(f32 offset) {
  Vec2 r = random_screen_pos();
@@ -76,7 +90,7 @@ Polygon polygon_create(s32 point_count, f32 jaggedness, f32 start_angle) {
   f32 angle_step = (2*Pi32)/(f32)point_count;
   Vec2* points = r.points;
   Loop(i, point_count) {
-    f32 scale = 1.0f - random_f32()*jaggedness;
+    f32 scale = 1.0f - random_f32(random_stream(Random_Stream_Cosmetic))*jaggedness;
     points[i] = vec2(angle)*scale;
     angle += angle_step;
   }
@@ -89,19 +103,17 @@ void polygon_lerp(Polygon a, Polygon b, f32 lerp_t, Polygon* out) {
   Assert(a.point_count == b.point_count);
   Assert(a.point_count == out->point_count);
   
-  Loop(i, a.point_count) {
-    out->points[i] = vec2_lerp(a.points[i], b.points[i], lerp_t);
-  }
+  vec2_lerp_n(out->points, a.points, b.points, a.point_count, lerp_t);
 }
 
 void draw_polygon(Polygon polygon, Vec2 center, f32 scale, f32 rot, Vec4 color) {
+  Vec2 points[64];
+  Assert(polygon.point_count <= (s32)ArrayCount(points));
+  vec2_transform_points(points, polygon.points, polygon.point_count, rot, scale, center);
+  
   Loop(i, polygon.point_count) {
     s32 next_index = (i + 1)%polygon.point_count;
-
-    Vec2 p1 = center + vec2_rotate(polygon.points[i], rot)*scale;    
-    Vec2 p2 = center + vec2_rotate(polygon.points[next_index], rot)*scale;
-   
-    draw_triangle(p1, center, p2, color);
+    draw_triangle(points[i], center, points[next_index], color);
   }
 }
 
@@ -117,6 +129,22 @@ enum Entity_Type {
   Entity_Type_Infector          = (1 << 6),
 };
 
+// One slot per type bit, used to index the per-type entity lists.
+#define ENTITY_TYPE_SLOT_COUNT 8
+
+// Every entity type, the struct it's stored as and its update and draw procs. The
+// update/draw loops, the dispatch and the size checks are all generated from this, so a
+// new enemy is one line here plus its struct and procs.
+//
+// X(type, struct_name, update_proc, draw_proc)
+#define ENTITY_TYPE_TABLE(X) \
+  X(Entity_Type_Player,            Player,            update_player,            draw_player)            \
+  X(Entity_Type_Goon,              Goon,              update_goon,              draw_goon)              \
+  X(Entity_Type_Laser_Turret,      Laser_Turret,      update_laser_turret,      draw_laser_turret)      \
+  X(Entity_Type_Triple_Gun_Turret, Triple_Gun_Turret, update_triple_gun_turret, draw_triple_gun_turret) \
+  X(Entity_Type_Chain_Activator,   Chain_Activator,   update_chain_activator,   draw_chain_activator)   \
+  X(Entity_Type_Infector,          Infector,          update_infector,          draw_infector)
+
 enum Entity_State {
   Entity_State_None,
   
@@ -144,10 +172,11 @@ struct Entity_Base {
   Entity_Index index;
   Entity_Id    id;
   Entity_Type  type;
+  s32 type_list_index;  // where this entity sits in gs->entities_by_type
+  s32 state_list_index; // where this entity sits in gs->entities_by_state
   
-  Vec2 pos;
+  // position and velocity are in Game_State::entity_kinematics, see entity_pos
   Vec2 dir;
-  Vec2 vel;
   f32 move_speed;
   f32 rotation;
   f32 scale;
@@ -162,6 +191,8 @@ struct Entity_Base {
   Timer state_timer;
   Entity_State state;
   
+  Script script; // behaviour of the scripted entity types, see *_script
+  
   b32 is_active;
 };
 
@@ -186,12 +217,10 @@ struct Player : public Entity_Base {
 struct Laser_Turret : public Entity_Base {
   f32 shoot_angle;
   s32 blinked_count;
-  Timer blink_timer;
 };
 
 struct Triple_Gun_Turret : public Entity_Base {
   s32 projectiles_left_to_spawn;
-  Timer projectile_spawn_timer;
 };
 
 struct Chain_Activator : public Entity_Base {
@@ -231,16 +260,24 @@ struct Entity {
   Entity_Type type;
 };
 
+#define X(type, struct_name, update_proc, draw_proc) \
+  static_assert(sizeof(struct_name) <= sizeof(Entity), #struct_name " doesn't fit in Entity"); \
+  static_assert(((type) & ((type) - 1)) == 0, #type " must be a single bit");
+ENTITY_TYPE_TABLE(X)
+#undef X
+
 
 void entity_set_hit_points(Entity_Base* base, s32 ammount) {
   base->initial_hit_points = ammount;
   base->hit_points = ammount;
 }
 
-void entity_change_state(Entity_Base* base, Entity_State state) {
-  base->state = state;
-  base->has_entered_state = false;
-}
+// Changes state and gives up the rest of the tick, so the next state starts on the next
+// tick like it does in the switch based FSMs.
+#define ScriptChangeState(script, entity, new_state) do { entity_change_state(entity, new_state); ScriptYield(script); } while(0)
+
+#define ScriptWait(script, seconds) \
+  ScriptWaitTicks(script, get_game_state()->sim_tick, ticks_from_seconds(seconds, SIM_DELTA_TIME))
 
 b32 entity_enter_state(Entity_Base* base) {
   f32 r = !base->has_entered_state;
@@ -248,23 +285,40 @@ b32 entity_enter_state(Entity_Base* base) {
   return r;
 }
 
+// Position and velocity are in the pool's Kinematics, under the same index.
 struct Projectile {
-  Vec2 pos, vel, dir;
+  Vec2 dir;
   f32 rotation;
   f32 move_speed;
   f32 radius;
   
   Vec4 color;
   
-  b32 has_life_time;
-  Timer life_timer;
+  Wheel_Handle expire_timer; // only for projectiles given a life time
   
   Timer emit_timer;
     
   Entity_Type from_type;
   Entity_Id   from_id;
+};
 
-  b32 is_active;
+// Projectiles live in one pool per owner, so every consumer only walks the bullets it
+// can actually interact with.
+enum Projectile_Faction {
+  Projectile_Faction_Player,   // hits enemies and grows chain circles
+  Projectile_Faction_Chain,    // triple gun turret bullets, spawn chain circles
+  Projectile_Faction_Infector, // infect chain circles
+  
+  Projectile_Faction_Count,
+};
+
+struct Projectile_Pool {
+  Projectile* projectiles;
+  Kinematics kinematics;
+  u64 active_mask[BIT_SET_WORD_COUNT(MAX_PROJECTILES)];
+  u64 offscreen_mask[BIT_SET_WORD_COUNT(MAX_PROJECTILES)]; // written by the last move
+  s32 capacity;
+  s32 next_index;
 };
 
 struct Chain_Circle {
@@ -272,22 +326,34 @@ struct Chain_Circle {
   f32 radius;
   f32 target_radius;
   f32 emerge_time;
+  b32 has_emerged; // as of the start of this tick's update
   f32 life_time;
   f32 life_prolong_time;
   
   b32 is_infected;
   Timer infection_timer;
   f32 infection;
+};
+
+// The laser turret shot. It's drawn and collides as a row of LASER_BEAM_SEGMENT_COUNT
+// segments, segment i sits at origin + dir*segment_step*i. Only [first_segment, end_segment)
+// is still alive, chain circles burn segments away and can split a beam in two.
+struct Laser_Beam {
+  Vec2 origin, dir;
+  f32 rotation;
+  f32 radius;
+  f32 segment_step;
+  s32 first_segment, end_segment;
   
-  b32 is_active;
+  u32 spawn_tick;
+  Wheel_Handle expire_timer;
+  u32 shooter_id; // with spawn_tick, keys the per segment jitter
 };
 
 struct Explosion {
   Vec2 pos;
   f32 scale, rot;
-  Timer timer;
-  
-  b32 is_active;
+  Wheel_Handle expire_timer;
 };
 
 struct Score_Dot {
@@ -297,20 +363,15 @@ struct Score_Dot {
   
   f32 pulse_time;    
   f32 pulse_radius;
-  
-  b32 is_active;
 };
 
 
+// Position and velocity are in Game_State::particle_kinematics.
 struct Particle {
-  Vec2 pos, vel;
-  f32 friction;
   f32 radius;
   f32 rotation;
-  Timer life_timer;
+  Wheel_Handle expire_timer;
   Vec4 color;
-  
-  b32 is_active;
 };
 
 
@@ -328,6 +389,74 @@ struct High_Score {
   s32 lives;
 };
 
+//
+// Sim events
+//
+// Side effects of the update (sounds, spawns, damage) are queued while the tick runs and
+// applied together at its end, see drain_sim_events.
+//
+
+enum Sim_Event_Type {
+  Sim_Event_Sound,
+  Sim_Event_Spawn_Chain_Circle,
+  Sim_Event_Spawn_Score_Dot,
+  Sim_Event_Spawn_Explosion,
+  Sim_Event_Damage,
+};
+
+enum Game_Sound {
+  Game_Sound_Player_Shoot,
+  Game_Sound_Explosion,
+  Game_Sound_Laser_Shot,
+  Game_Sound_Score_Pickup,
+  Game_Sound_Player_Hit,
+};
+
+// Who pushed the event, in the order the systems run in update_game.
+enum Sim_Event_Source {
+  Sim_Event_Source_None,
+  Sim_Event_Source_Entity,
+  Sim_Event_Source_Projectile,
+  Sim_Event_Source_Laser_Beam,
+};
+
+// What the other entities get to see of an entity while update_entities runs: how it was
+// at the start of the tick.
+struct Entity_Snapshot {
+  Entity_Type  type;
+  Entity_State state;
+  Vec2 pos;
+  f32  radius;
+  b32  is_active;
+};
+
+struct Sim_Event {
+  Sim_Event_Type type;
+  Vec2 pos; // where to spawn, not used by Damage
+  
+  union {
+    Game_Sound sound;
+    struct { f32 radius; b32 is_infected; } chain_circle;
+    struct { b32 is_special; } score_dot;
+    struct { f32 scale, time; } explosion;
+    struct { Entity_Index target; s32 amount; f32 death_explosion_scale; s32 bullet_index; } damage;
+  };
+};
+
+// Any number of producers push, the slot comes from an atomic add on count. It's only
+// read once the tick is over and every producer is done.
+struct Sim_Event_Queue {
+  Sim_Event* events;
+  u64* keys;
+  u32* order;
+  u64* tmp_keys;
+  u32* tmp_order;
+  s32 capacity;
+  
+  volatile s32 count;
+  volatile s32 dropped; // since the start, shown in the debug info and checked by game_test
+};
+
 struct Game_State {
   // game controls
   Timer show_game_controls_timer;
@@ -340,43 +469,9 @@ struct Game_State {
   s32 option_index;
   s32 master_volume;
   
-  // game objects
-  Entity* entities;
-  s32 entity_count;
-  s32 next_entity_id;
-  
-  Projectile* projectiles;
-  s32 next_projectile_index;
-  s32 active_projectile_count;
-  
-  Chain_Circle* chain_circles;
-  s32 next_chain_circle_index;
-  s32 active_chain_circle_count;
-
-  Score_Dot* score_dots;
-  s32 next_score_dot_index;
-  s32 active_score_dot_count;
-
-  Explosion* explosions;
-  s32 next_explosion_index;
-  s32 active_explosion_count;
-  
-  Particle* particles;
-  s32 next_particle_index;
-  s32 active_particles_count;
-  
-  // level state
-  f32 level_duration;
-  f32 level_time_passed;
-  s32 score;
   High_Score high_score;
   b32 got_high_score;
   
-  struct {
-    Timer goon, laser_turret, triple_turret, activator, infector;
-  } spawn_timer;
-  b32 are_spawn_timers_init;
-  
   // explosion polygon instance
   Polygon explosion_polygons[8];
   s32 explosion_polygon_index;
@@ -404,21 +499,130 @@ struct Game_State {
   Timer song_timer;
   b32 is_level_music_done;
 
+  // simulation
+  f32 sim_time_accumulator;
+  Sim_Event_Queue sim_events;
+  Snapshot_Ring snapshots; // of everything from sim_tick down, see save_sim_snapshot
+  
   // perf
   b32 show_debug_info;
   f64 update_time;
   f64 draw_time;
+  
+  // Simulation state, from here to the end. Anything that isn't goes above.
+  u32 sim_tick;
+  Sim_Input input; // of the tick that's running
+  Random_State random; // only up to date in a snapshot, the live streams are in game_random
+  
+  // game objects
+  Entity* entities;
+  Kinematics entity_kinematics; // indexed like entities
+  s32 entity_count;
+  s32 next_entity_id;
+  
+  // entity indices grouped by type, kept up to date by new_entity and actually_remove_entities
+  Entity_Index entities_by_type[ENTITY_TYPE_SLOT_COUNT][MAX_ENTITIES];
+  s32 entity_count_by_type[ENTITY_TYPE_SLOT_COUNT];
+  
+  // the same per (type, state), moved between buckets by entity_change_state
+  Entity_Index entities_by_state[ENTITY_TYPE_SLOT_COUNT][Entity_State_Count][MAX_ENTITIES];
+  s32 entity_count_by_state[ENTITY_TYPE_SLOT_COUNT][Entity_State_Count];
+  
+  // the previous tick as seen by update_entities, indexed like entities, see take_entity_snapshots
+  Entity_Snapshot entity_snapshots[MAX_ENTITIES];
+  s32 entity_snapshot_count;
+  u64 player_bullet_snapshot_mask[BIT_SET_WORD_COUNT(MAX_PROJECTILES)];
+  
+  Projectile_Pool projectile_pools[Projectile_Faction_Count];
+  s32 active_projectile_count;
+  
+  Chain_Circle* chain_circles;
+  u64 active_chain_circle_mask[BIT_SET_WORD_COUNT(MAX_CHAIN_CIRCLES)];
+  s32 next_chain_circle_index;
+  s32 active_chain_circle_count;
+
+  Score_Dot* score_dots;
+  u64 active_score_dot_mask[BIT_SET_WORD_COUNT(MAX_SCORE_DOTS)];
+  s32 next_score_dot_index;
+  s32 active_score_dot_count;
+
+  Laser_Beam* laser_beams;
+  u64 active_laser_beam_mask[BIT_SET_WORD_COUNT(MAX_LASER_BEAMS)];
+  s32 next_laser_beam_index;
+  
+  Explosion* explosions;
+  u64 active_explosion_mask[BIT_SET_WORD_COUNT(MAX_EXPLOSIONS)];
+  s32 next_explosion_index;
+  s32 active_explosion_count;
+  
+  Particle* particles;
+  Kinematics particle_kinematics;
+  u64 active_particle_mask[BIT_SET_WORD_COUNT(MAX_PARTICLES)];
+  s32 next_particle_index;
+  s32 active_particles_count;
+  
+  // level state
+  f32 level_duration;
+  f32 level_time_passed;
+  s32 score;
+  
+  struct {
+    Timer goon, laser_turret, triple_turret, activator, infector;
+  } spawn_timer;
+  b32 are_spawn_timers_init;
+  
+  // Lifetimes of particles, explosions and laser beams, see process_timer_events.
+  Timing_Wheel timer_wheel;
 };
 
 
-global_var Game_State global_game_state;
+// Lives at the start of the sim block, see init_game.
+global_var Game_State* global_game_state;
+
+Game_State* get_game_state(void) { return global_game_state; }
+
+s32 entity_type_slot(Entity_Type type) {
+  Assert(type != Entity_Type_None);
+  s32 r = find_first_set_bit_u64((u64)type);
+  Assert(r < ENTITY_TYPE_SLOT_COUNT);
+  return r;
+}
+
+void entity_state_bucket_add(Entity_Base* base) {
+  Game_State* gs = get_game_state();
+  s32 slot = entity_type_slot(base->type);
+  
+  s32* count = &gs->entity_count_by_state[slot][base->state];
+  base->state_list_index = *count;
+  gs->entities_by_state[slot][base->state][*count] = base->index;
+  *count += 1;
+}
+
+void entity_state_bucket_remove(Entity_Base* base) {
+  Game_State* gs = get_game_state();
+  s32 slot = entity_type_slot(base->type);
+  
+  s32* count = &gs->entity_count_by_state[slot][base->state];
+  Entity_Index moved = gs->entities_by_state[slot][base->state][*count - 1];
+  gs->entities_by_state[slot][base->state][base->state_list_index] = moved;
+  gs->entities[moved.value].base.state_list_index = base->state_list_index;
+  *count -= 1;
+}
 
-Game_State* get_game_state(void) { return &global_game_state; }
+void entity_change_state(Entity_Base* base, Entity_State state) {
+  if(base->state != state) {
+    entity_state_bucket_remove(base);
+    base->state = state;
+    entity_state_bucket_add(base);
+  }
+  base->has_entered_state = false;
+}
 
 Entity* new_entity(Entity_Type type = Entity_Type_None) {
   Game_State* gs = get_game_state();
 
   Assert(gs->entity_count < MAX_ENTITIES);
+  Assert(type != Entity_Type_None);
 
   Entity* entity = &gs->entities[gs->entity_count];
   *entity = {};
@@ -432,6 +636,15 @@ Entity* new_entity(Entity_Type type = Entity_Type_None) {
   base->state = Entity_State_Initial;
   base->is_active = true;
   
+  kinematics_place(&gs->entity_kinematics, base->index.value, vec2(0, 0), vec2(0, 0), 1.0f, 0.0f);
+  
+  s32 slot = entity_type_slot(type);
+  base->type_list_index = gs->entity_count_by_type[slot];
+  gs->entities_by_type[slot][base->type_list_index] = base->index;
+  gs->entity_count_by_type[slot] += 1;
+  
+  entity_state_bucket_add(base);
+  
   gs->entity_count   += 1;
   gs->next_entity_id += 1;
 
@@ -441,16 +654,133 @@ Entity* new_entity(Entity_Type type = Entity_Type_None) {
 void remove_entity(Entity_Base* base) { base->is_active = false; }
 void remove_entity(Entity*  entity)   { entity->base.is_active = false; }
 
+// Entities steer by setting their velocity while they update, all of them move together
+// afterwards in move_entities.
+Vec2 entity_pos(Entity_Base* base) { return kinematics_pos(&get_game_state()->entity_kinematics, base->index.value); }
+Vec2 entity_pos(Entity* entity)    { return entity_pos(&entity->base); }
+Vec2 entity_vel(Entity_Base* base) { return kinematics_vel(&get_game_state()->entity_kinematics, base->index.value); }
+
+void entity_place(Entity_Base* base, Vec2 pos) {
+  kinematics_set_pos(&get_game_state()->entity_kinematics, base->index.value, pos);
+}
+
+// Frictions are given as the part of the velocity that is left after a second, the
+// kinematics scale by this every tick. The same slowdown on any SIM_TICKS_PER_SECOND.
+f32 friction_per_tick(f32 per_second) {
+  f32 r = root_f32_s32(per_second, SIM_TICKS_PER_SECOND);
+  return r;
+}
+
+void entity_set_vel(Entity_Base* base, Vec2 vel, f32 friction = 1.0f) {
+  kinematics_set_vel(&get_game_state()->entity_kinematics, base->index.value, vel, friction);
+}
+
+// Goes backwards so the entity swapped into a freed slot has already been looked at.
 void actually_remove_entities(void) {
   Game_State* gs = get_game_state();
   
-  Loop(i, gs->entity_count) {
+  for(s32 i = gs->entity_count - 1; i >= 0; i--) {
     Entity* curr = &gs->entities[i];
-    if(!curr->base.is_active) {
-      Entity* last = &gs->entities[gs->entity_count - 1];
-      *curr = *last;
+    if(curr->base.is_active) continue;
+    
+    // swap remove from the type list
+    s32 slot = entity_type_slot(curr->type);
+    s32 last_in_type = gs->entity_count_by_type[slot] - 1;
+    Entity_Index moved_in_type = gs->entities_by_type[slot][last_in_type];
+    gs->entities_by_type[slot][curr->base.type_list_index] = moved_in_type;
+    gs->entities[moved_in_type.value].base.type_list_index = curr->base.type_list_index;
+    gs->entity_count_by_type[slot] -= 1;
+    
+    entity_state_bucket_remove(&curr->base);
+    
+    // swap remove from the entity array
+    s32 last_index = gs->entity_count - 1;
+    if(i != last_index) {
+      *curr = gs->entities[last_index];
+      curr->base.index = {i};
+      kinematics_copy(&gs->entity_kinematics, i, last_index);
+      
+      s32 moved_slot = entity_type_slot(curr->type);
+      gs->entities_by_type[moved_slot][curr->base.type_list_index] = curr->base.index;
+      gs->entities_by_state[moved_slot][curr->base.state][curr->base.state_list_index] = curr->base.index;
+    }
+    kinematics_stop(&gs->entity_kinematics, last_index);
+    gs->entity_count -= 1;
+  }
+}
+
+s32 get_entity_count_of_type(Entity_Type type) {
+  Game_State* gs = get_game_state();
+  s32 r = gs->entity_count_by_type[entity_type_slot(type)];
+  return r;
+}
+
+Entity* get_entity_of_type(Entity_Type type, s32 n) {
+  Game_State* gs = get_game_state();
+  s32 slot = entity_type_slot(type);
+  Assert(n >= 0 && n < gs->entity_count_by_type[slot]);
+  
+  Entity* r = &gs->entities[gs->entities_by_type[slot][n].value];
+  return r;
+}
+
+// Iterates the entities of one type, proportional to how many of them exist.
+#define LoopEntitiesOfType(var_name, type) Loop(var_name, get_entity_count_of_type(type))
+
+
+//
+// Timer events
+//
+// Object lifetimes go through gs->timer_wheel instead of a Timer stepped every tick. The
+// payload says what expired and its slot, the handle is kept in the object so the timer
+// can be cancelled when the object goes away early or its slot gets reused.
+//
+
+enum Timer_Event_Kind {
+  Timer_Event_Particle_Expire,
+  Timer_Event_Explosion_Expire,
+  Timer_Event_Laser_Beam_Expire,
+  Timer_Event_Projectile_Expire, // index is faction*MAX_PROJECTILES + slot
+};
+
+u32 timer_event_payload(Timer_Event_Kind kind, s64 index) {
+  Assert(index >= 0 && index < (1 << 24));
+  u32 r = ((u32)kind << 24) | (u32)index;
+  return r;
+}
+
+Wheel_Handle schedule_timer_event(Timer_Event_Kind kind, s64 index, f32 seconds) {
+  Game_State* gs = get_game_state();
+  
+  u32 expire_tick = gs->sim_tick + ticks_from_seconds(seconds, SIM_DELTA_TIME);
+  Wheel_Handle r = timing_wheel_add(&gs->timer_wheel, expire_tick, timer_event_payload(kind, index));
+  return r;
+}
+
+void remove_particle(Particle* p);
+void remove_explosion(Explosion* e);
+void remove_laser_beam(Laser_Beam* b);
+void remove_projectile_expired(u32 index);
+
+// Brings the wheel up to the current tick and removes whatever expired on the way.
+void process_timer_events(void) {
+  Game_State* gs = get_game_state();
+  Timing_Wheel* wheel = &gs->timer_wheel;
+  
+  while((s32)(gs->sim_tick - wheel->now) > 0) {
+    timing_wheel_advance(wheel);
+    
+    u32 payload = 0;
+    while(timing_wheel_pop_expired(wheel, &payload)) {
+      u32 index = payload & 0xffffff;
       
-      gs->entity_count -= 1;
+      switch(payload >> 24) {
+        case Timer_Event_Particle_Expire:   { remove_particle(&gs->particles[index]);     } break;
+        case Timer_Event_Explosion_Expire:  { remove_explosion(&gs->explosions[index]);   } break;
+        case Timer_Event_Laser_Beam_Expire: { remove_laser_beam(&gs->laser_beams[index]); } break;
+        case Timer_Event_Projectile_Expire: { remove_projectile_expired(index);           } break;
+        default: Assert(!"Unknown timer event");
+      }
     }
   }
 }
@@ -461,8 +791,10 @@ Particle* new_particle() {
 
   Particle* p = &gs->particles[gs->next_particle_index];
   
+  // the slot may still be in use, its expiry must not hit the new particle
+  timing_wheel_cancel(&gs->timer_wheel, p->expire_timer);
   *p = {};
-  p->is_active = true;
+  bit_set_set(gs->active_particle_mask, gs->next_particle_index);
   
   gs->next_particle_index += 1;
   gs->next_particle_index %= MAX_PARTICLES;
@@ -470,131 +802,538 @@ Particle* new_particle() {
   return p;
 }
 
-void remove_particle(Particle* p) { p->is_active = false; }
+void remove_particle(Particle* p) {
+  Game_State* gs = get_game_state();
+  timing_wheel_cancel(&gs->timer_wheel, p->expire_timer);
+  kinematics_stop(&gs->particle_kinematics, p - gs->particles);
+  bit_set_unset(gs->active_particle_mask, p - gs->particles);
+}
 
 
-Projectile* new_projectile() {
+Projectile_Pool* get_projectile_pool(Projectile_Faction faction) {
   Game_State* gs = get_game_state();
+  Assert(faction >= 0 && faction < Projectile_Faction_Count);
+  
+  Projectile_Pool* r = &gs->projectile_pools[faction];
+  return r;
+}
+
+Projectile* new_projectile(Projectile_Faction faction) {
+  Projectile_Pool* pool = get_projectile_pool(faction);
 
-  Projectile* p = &gs->projectiles[gs->next_projectile_index];
+  Projectile* p = &pool->projectiles[pool->next_index];
   
+  // a bullet that left the screen keeps its timer, it must not hit the new one
+  timing_wheel_cancel(&get_game_state()->timer_wheel, p->expire_timer);
   *p = {};
-  p->is_active = true;
+  bit_set_set(pool->active_mask, pool->next_index);
   
-  gs->next_projectile_index += 1;
-  gs->next_projectile_index %= MAX_PROJECTILES;
+  pool->next_index += 1;
+  pool->next_index %= pool->capacity;
   
   return p;
 }
 
-void remove_projectile(Projectile* p) { p->is_active = false; }
+// Doesn't touch the timer wheel so the parallel move can call it, see new_projectile.
+void projectile_deactivate(Projectile_Pool* pool, Projectile* p) {
+  kinematics_stop(&pool->kinematics, p - pool->projectiles);
+  bit_set_unset(pool->active_mask, p - pool->projectiles);
+}
 
-void projectile_set_parent(Projectile* p, Entity* entity) {
-  p->from_type = entity->type;
-  p->from_id = entity->base.id;
+void remove_projectile(Projectile_Pool* pool, Projectile* p) {
+  timing_wheel_cancel(&get_game_state()->timer_wheel, p->expire_timer);
+  projectile_deactivate(pool, p);
 }
 
-void projectile_set_life_time(Projectile* p, f32 life_time) {
-  p->has_life_time = true;
-  p->life_timer = timer_start(life_time);
+// Projectiles fly straight at dir*move_speed, set those before placing one.
+void projectile_place(Projectile_Pool* pool, Projectile* p, Vec2 pos) {
+  kinematics_place(&pool->kinematics, p - pool->projectiles, pos, p->dir*p->move_speed, 1.0f, p->radius);
 }
 
-Chain_Circle* spawn_chain_circle(Vec2 pos, f32 radius) {
-  Game_State* gs = get_game_state();
-  
-  Chain_Circle* c = &gs->chain_circles[gs->next_chain_circle_index];
-  *c = {};
-  c->pos           = pos;
-  c->target_radius = radius;
-  c->is_active     = true;
-  
-  gs->next_chain_circle_index += 1;
-  gs->next_chain_circle_index %= MAX_CHAIN_CIRCLES;
-  
-  return c;
+Vec2 projectile_pos(Projectile_Pool* pool, Projectile* p) {
+  return kinematics_pos(&pool->kinematics, p - pool->projectiles);
 }
 
+#define LoopProjectiles(var_name, pool) LoopBits(var_name, (pool)->active_mask, (pool)->capacity)
 
-void infect_chain_circle(Chain_Circle* c) {
-  if(!c->is_infected) {
-    c->is_infected = true;
-    c->infection = 0.0f;
-    c->infection_timer = timer_start(CHAIN_CIRCLE_INFECTION_TIME);
-  }
+// Tests the whole path the projectile covered in its last move, not only where it ended up,
+// so fast bullets can't step over a target between two updates.
+b32 check_projectile_vs_circle(Projectile_Pool* pool, Projectile* p, Vec2 pos, f32 radius) {
+  s64 index = p - pool->projectiles;
+  Vec2 end  = kinematics_pos(&pool->kinematics, index);
+  b32 r = capsule_vs_circle(end - kinematics_last_move(&pool->kinematics, index), end, p->radius, pos, radius);
+  return r;
 }
 
-void spawn_infected_chain_circle(Vec2 pos, f32 radius) {
-  Chain_Circle* c = spawn_chain_circle(pos, radius);
-  infect_chain_circle(c);
+void projectile_set_parent(Projectile* p, Entity* entity) {
+  p->from_type = entity->type;
+  p->from_id = entity->base.id;
 }
 
-void remove_chain_circle(Chain_Circle* c) { c->is_active = false; } 
-
-
-void spawn_score_dot(Vec2 pos, b32 is_special = false) {
+void projectile_set_life_time(Projectile_Pool* pool, Projectile* p, f32 life_time) {
   Game_State* gs = get_game_state();
-
-  Score_Dot* dot = &gs->score_dots[gs->next_score_dot_index];
-  *dot = {};
+  s64 faction = pool - gs->projectile_pools;
   
-  dot->pos = pos;
-  dot->is_special = is_special;
-  dot->is_active = true;
-    
-  gs->next_score_dot_index += 1;
-  gs->next_score_dot_index %= MAX_SCORE_DOTS;
+  timing_wheel_cancel(&gs->timer_wheel, p->expire_timer);
+  p->expire_timer = schedule_timer_event(Timer_Event_Projectile_Expire, faction*MAX_PROJECTILES + (p - pool->projectiles), life_time);
 }
 
-void remove_score_dot(Score_Dot* dot) { dot->is_active = false;}
+void remove_projectile_expired(u32 index) {
+  Projectile_Pool* pool = get_projectile_pool((Projectile_Faction)(index/MAX_PROJECTILES));
+  
+  // gone already if it left the screen
+  if(bit_set_is_set(pool->active_mask, index%MAX_PROJECTILES)) remove_projectile(pool, &pool->projectiles[index%MAX_PROJECTILES]);
+}
 
-void spawn_explosion(Vec2 pos, f32 scale, f32 time) {
-  Game_State* gs = get_game_state();
+// A volley of projectiles that sit next to each other in the pool.
+struct Projectile_Range {
+  Projectile_Pool* pool;
+  Projectile* first;
+  s32 first_index;
+  s32 count;
+};
 
-  Explosion* e = &gs->explosions[gs->next_explosion_index];
-  e->pos = pos;
-  e->scale = scale;
-  e->rot = 2.0f*Pi32*random_f32();
-  e->timer = timer_start(time);
-  e->is_active = true;
+// Reserves 'count' consecutive slots in one go and copies the prototype into all of them.
+// If the volley doesn't fit before the end of the pool it starts over at index 0, so the
+// range never wraps.
+Projectile_Range spawn_projectiles_batch(Projectile_Faction faction, s32 count, Projectile prototype) {
+  Projectile_Pool* pool = get_projectile_pool(faction);
   
-  gs->next_explosion_index += 1;
-  gs->next_explosion_index %= MAX_EXPLOSIONS;
+  Assert(count > 0 && count <= pool->capacity);
   
-  PlaySound(gs->explosion_sound);
+  if(pool->next_index + count > pool->capacity) pool->next_index = 0;
+  
+  Projectile_Range r = {};
+  r.pool        = pool;
+  r.first_index = pool->next_index;
+  r.first       = &pool->projectiles[r.first_index];
+  r.count       = count;
+  
+  Loop(i, count) r.first[i] = prototype;
+  bit_set_set_range(pool->active_mask, r.first_index, count);
+  
+  pool->next_index += count;
+  pool->next_index %= pool->capacity;
+  
+  return r;
 }
 
-void remove_explosion(Explosion* e) { e->is_active = false; }
-
-
+// Evenly spread directions starting at start_angle, positioned 'offset' away from center.
+// Only one cos/sin pair per volley, the rest of the directions are rotated incrementally.
+void projectile_range_fill_fan(Projectile_Range range, Vec2 center, f32 offset, f32 start_angle, f32 angle_step) {
+  Vec2 dir = vec2(start_angle);
+  f32 step_sin, step_cos;
+  sincos_f32(angle_step, &step_sin, &step_cos);
+  
+  f32 angle = start_angle;
+  Loop(i, range.count) {
+    Projectile* p = &range.first[i];
+    p->dir      = dir;
+    p->rotation = angle;
+    projectile_place(range.pool, p, center + dir*offset);
+    
+    dir = {dir.x*step_cos - dir.y*step_sin, dir.x*step_sin + dir.y*step_cos};
+    angle += angle_step;
+  }
+}
+
+Laser_Beam* new_laser_beam() {
+  Game_State* gs = get_game_state();
+
+  Laser_Beam* b = &gs->laser_beams[gs->next_laser_beam_index];
+  
+  timing_wheel_cancel(&gs->timer_wheel, b->expire_timer);
+  *b = {};
+  bit_set_set(gs->active_laser_beam_mask, gs->next_laser_beam_index);
+  
+  gs->next_laser_beam_index += 1;
+  gs->next_laser_beam_index %= MAX_LASER_BEAMS;
+  
+  return b;
+}
+
+void remove_laser_beam(Laser_Beam* b) {
+  Game_State* gs = get_game_state();
+  timing_wheel_cancel(&gs->timer_wheel, b->expire_timer);
+  bit_set_unset(gs->active_laser_beam_mask, b - gs->laser_beams);
+}
+
+// A beam and every piece split off it expire LASER_BEAM_LIFETIME after the shot.
+void laser_beam_schedule_expiry(Laser_Beam* b) {
+  Game_State* gs = get_game_state();
+  
+  u32 expire_tick = b->spawn_tick + ticks_from_seconds(LASER_BEAM_LIFETIME, SIM_DELTA_TIME);
+  u32 payload = timer_event_payload(Timer_Event_Laser_Beam_Expire, b - gs->laser_beams);
+  b->expire_timer = timing_wheel_add(&gs->timer_wheel, expire_tick, payload);
+}
+
+f32 laser_beam_age(Laser_Beam* b) {
+  Game_State* gs = get_game_state();
+  f32 r = (f32)(gs->sim_tick - b->spawn_tick)*SIM_DELTA_TIME;
+  return r;
+}
+
+Vec2 laser_beam_segment_pos(Laser_Beam* b, s32 segment) {
+  Vec2 r = b->origin + b->dir*(b->segment_step*(f32)segment);
+  return r;
+}
+
+b32 check_laser_beam_vs_circle(Laser_Beam* b, Vec2 pos, f32 radius) {
+  Vec2 start = laser_beam_segment_pos(b, b->first_segment);
+  Vec2 end   = laser_beam_segment_pos(b, b->end_segment - 1);
+  b32 r = capsule_vs_circle(start, end, b->radius, pos, radius);
+  return r;
+}
+
+void laser_beam_vs_circles(Laser_Beam* b, f32* xs, f32* ys, f32* radii, s32 count, u64* hit_mask) {
+  Vec2 start = laser_beam_segment_pos(b, b->first_segment);
+  Vec2 end   = laser_beam_segment_pos(b, b->end_segment - 1);
+  capsule_vs_circles(start, end, b->radius, xs, ys, radii, count, hit_mask);
+}
+
+Chain_Circle* spawn_chain_circle(Vec2 pos, f32 radius) {
+  Game_State* gs = get_game_state();
+  
+  Chain_Circle* c = &gs->chain_circles[gs->next_chain_circle_index];
+  *c = {};
+  c->pos           = pos;
+  c->target_radius = radius;
+  bit_set_set(gs->active_chain_circle_mask, gs->next_chain_circle_index);
+  
+  gs->next_chain_circle_index += 1;
+  gs->next_chain_circle_index %= MAX_CHAIN_CIRCLES;
+  
+  return c;
+}
+
+
+void infect_chain_circle(Chain_Circle* c) {
+  if(!c->is_infected) {
+    c->is_infected = true;
+    c->infection = 0.0f;
+    c->infection_timer = timer_start(CHAIN_CIRCLE_INFECTION_TIME);
+  }
+}
+
+void spawn_infected_chain_circle(Vec2 pos, f32 radius) {
+  Chain_Circle* c = spawn_chain_circle(pos, radius);
+  infect_chain_circle(c);
+}
+
+void remove_chain_circle(Chain_Circle* c) {
+  Game_State* gs = get_game_state();
+  bit_set_unset(gs->active_chain_circle_mask, c - gs->chain_circles);
+}
+
+
+void spawn_score_dot(Vec2 pos, b32 is_special = false) {
+  Game_State* gs = get_game_state();
+
+  Score_Dot* dot = &gs->score_dots[gs->next_score_dot_index];
+  *dot = {};
+  
+  dot->pos = pos;
+  dot->is_special = is_special;
+  bit_set_set(gs->active_score_dot_mask, gs->next_score_dot_index);
+    
+  gs->next_score_dot_index += 1;
+  gs->next_score_dot_index %= MAX_SCORE_DOTS;
+}
+
+void remove_score_dot(Score_Dot* dot) {
+  Game_State* gs = get_game_state();
+  bit_set_unset(gs->active_score_dot_mask, dot - gs->score_dots);
+}
+
+// What a Random_Counter draws for, the per object randomness that mustn't depend on the
+// order objects are updated in.
+enum Random_Purpose {
+  Random_Purpose_Explosion,
+  Random_Purpose_Laser_Jitter,
+};
+
+void spawn_explosion(Vec2 pos, f32 scale, f32 time) {
+  Game_State* gs = get_game_state();
+
+  Explosion* e = &gs->explosions[gs->next_explosion_index];
+  timing_wheel_cancel(&gs->timer_wheel, e->expire_timer);
+  
+  e->pos = pos;
+  e->scale = scale;
+  Random_Counter random = random_counter((u32)gs->next_explosion_index, gs->sim_tick, Random_Purpose_Explosion);
+  e->rot = 2.0f*Pi32*random_f32(&random);
+  e->expire_timer = schedule_timer_event(Timer_Event_Explosion_Expire, gs->next_explosion_index, time);
+  bit_set_set(gs->active_explosion_mask, gs->next_explosion_index);
+  
+  gs->next_explosion_index += 1;
+  gs->next_explosion_index %= MAX_EXPLOSIONS;
+  
+  PlaySound(gs->explosion_sound);
+}
+
+void remove_explosion(Explosion* e) {
+  Game_State* gs = get_game_state();
+  timing_wheel_cancel(&gs->timer_wheel, e->expire_timer);
+  bit_set_unset(gs->active_explosion_mask, e - gs->explosions);
+}
+
+
+//
+// Sim event queue
+//
+// Every event gets a sort key of who pushed it and in which order: the source system, the
+// producer's position within it and a running count. Draining in key order gives the
+// same result as applying the events right where they were pushed in a single threaded
+// update, however the producers were spread over threads.
+//
+
+#define SIM_EVENT_ORDINAL_BITS 32
+#define SIM_EVENT_SEQ_BITS     24
+
+struct Sim_Event_Producer {
+  u64 key_base;
+  u32 seq;
+};
+
+global_var thread_var Sim_Event_Producer sim_event_producer;
+
+// Called before a producer runs, ordinal is its position among the producers of the source.
+void sim_event_producer_begin(Sim_Event_Source source, s64 ordinal) {
+  Assert(ordinal >= 0 && ordinal < (1LL << SIM_EVENT_ORDINAL_BITS));
+  
+  sim_event_producer.key_base = ((u64)source << (SIM_EVENT_ORDINAL_BITS + SIM_EVENT_SEQ_BITS)) |
+                                ((u64)ordinal << SIM_EVENT_SEQ_BITS);
+  sim_event_producer.seq = 0;
+}
+
+void sim_event_queue_init(Sim_Event_Queue* queue, Allocator* allocator, s32 capacity) {
+  *queue = {};
+  queue->capacity  = capacity;
+  queue->events    = allocator_alloc_array(allocator, Sim_Event, capacity);
+  queue->keys      = allocator_alloc_array(allocator, u64,       capacity);
+  queue->order     = allocator_alloc_array(allocator, u32,       capacity);
+  queue->tmp_keys  = allocator_alloc_array(allocator, u64,       capacity);
+  queue->tmp_order = allocator_alloc_array(allocator, u32,       capacity);
+}
+
+void sim_event_queue_clear(Sim_Event_Queue* queue) {
+  atomic_store_s32(&queue->count, 0);
+}
+
+// Events that don't fit are dropped and counted.
+void push_sim_event(Sim_Event event) {
+  Game_State* gs = get_game_state();
+  Sim_Event_Queue* queue = &gs->sim_events;
+  
+  s32 at = atomic_add_s32(&queue->count, 1);
+  if(at >= queue->capacity) {
+    atomic_add_s32(&queue->dropped, 1);
+    return;
+  }
+  
+  Assert(sim_event_producer.seq < (1u << SIM_EVENT_SEQ_BITS));
+  queue->events[at] = event;
+  queue->keys[at]   = sim_event_producer.key_base | sim_event_producer.seq;
+  queue->order[at]  = (u32)at;
+  sim_event_producer.seq += 1;
+}
+
+void queue_sound(Game_Sound sound) {
+  Sim_Event e = {};
+  e.type  = Sim_Event_Sound;
+  e.sound = sound;
+  push_sim_event(e);
+}
+
+void queue_spawn_chain_circle(Vec2 pos, f32 radius, b32 is_infected = false) {
+  Sim_Event e = {};
+  e.type = Sim_Event_Spawn_Chain_Circle;
+  e.pos  = pos;
+  e.chain_circle.radius      = radius;
+  e.chain_circle.is_infected = is_infected;
+  push_sim_event(e);
+}
+
+void queue_spawn_score_dot(Vec2 pos, b32 is_special = false) {
+  Sim_Event e = {};
+  e.type = Sim_Event_Spawn_Score_Dot;
+  e.pos  = pos;
+  e.score_dot.is_special = is_special;
+  push_sim_event(e);
+}
+
+void queue_spawn_explosion(Vec2 pos, f32 scale, f32 time) {
+  Sim_Event e = {};
+  e.type = Sim_Event_Spawn_Explosion;
+  e.pos  = pos;
+  e.explosion.scale = scale;
+  e.explosion.time  = time;
+  push_sim_event(e);
+}
+
+// Entities that die from it explode with the given scale.
+void queue_damage(Entity_Base* target, s32 amount, f32 death_explosion_scale) {
+  Sim_Event e = {};
+  e.type = Sim_Event_Damage;
+  e.damage.target = target->index;
+  e.damage.amount = amount;
+  e.damage.death_explosion_scale = death_explosion_scale;
+  e.damage.bullet_index = -1;
+  push_sim_event(e);
+}
+
+// Damage from a player bullet, one point unless it only pushes. The bullet is used up when
+// the event is applied, if another hit got it first this one doesn't count.
+void queue_bullet_hit(Entity_Base* target, s64 bullet_index, f32 death_explosion_scale, s32 amount = 1) {
+  Sim_Event e = {};
+  e.type = Sim_Event_Damage;
+  e.damage.target = target->index;
+  e.damage.amount = amount;
+  e.damage.death_explosion_scale = death_explosion_scale;
+  e.damage.bullet_index = (s32)bullet_index;
+  push_sim_event(e);
+}
+
+void play_game_sound(Game_Sound sound) {
+  Game_State* gs = get_game_state();
+  
+  switch(sound) {
+    case Game_Sound_Player_Shoot: { PlaySound(gs->player_shoot_sound); } break;
+    case Game_Sound_Explosion:    { PlaySound(gs->explosion_sound);    } break;
+    case Game_Sound_Laser_Shot:   { PlaySound(gs->laser_shot_sound);   } break;
+    case Game_Sound_Score_Pickup: { PlaySound(gs->score_pickup_sound); } break;
+    case Game_Sound_Player_Hit:   { PlaySound(gs->player_hit_sound);   } break;
+  }
+}
+
+// Applies everything queued this tick in key order and empties the queue.
+void drain_sim_events(void) {
+  Game_State* gs = get_game_state();
+  Sim_Event_Queue* queue = &gs->sim_events;
+  
+  s32 count = Min(atomic_load_s32(&queue->count), queue->capacity);
+  radix_sort_u64(queue->keys, queue->order, queue->tmp_keys, queue->tmp_order, count);
+  
+  Loop(i, count) {
+    Sim_Event* e = &queue->events[queue->order[i]];
+    
+    switch(e->type) {
+      case Sim_Event_Sound: { play_game_sound(e->sound); } break;
+      case Sim_Event_Spawn_Chain_Circle: {
+        if(e->chain_circle.is_infected) spawn_infected_chain_circle(e->pos, e->chain_circle.radius);
+        else                            spawn_chain_circle(e->pos, e->chain_circle.radius);
+      } break;
+      case Sim_Event_Spawn_Score_Dot: { spawn_score_dot(e->pos, e->score_dot.is_special);                 } break;
+      case Sim_Event_Spawn_Explosion: { spawn_explosion(e->pos, e->explosion.scale, e->explosion.time); } break;
+      case Sim_Event_Damage: {
+        Entity_Base* target = &gs->entities[e->damage.target.value].base;
+        if(!target->is_active) break;
+        
+        if(e->damage.bullet_index >= 0) {
+          Projectile_Pool* player_bullets = &gs->projectile_pools[Projectile_Faction_Player];
+          if(!bit_set_is_set(player_bullets->active_mask, e->damage.bullet_index)) break;
+          
+          remove_projectile(player_bullets, &player_bullets->projectiles[e->damage.bullet_index]);
+        }
+        if(e->damage.amount == 0) break;
+        
+        target->hit_points -= e->damage.amount;
+        if(target->hit_points <= 0) {
+          spawn_explosion(entity_pos(target), e->damage.death_explosion_scale, 1.0f);
+          remove_entity(target);
+        }
+        else {
+          target->health_bar_display_timer = timer_start(1.25f);
+        }
+      } break;
+      default: Assert(!"Unknown sim event");
+    }
+  }
+  
+  sim_event_queue_clear(queue);
+}
+
+
 #define PARTICLE_TRAIL_VELOCITY_RANGE     {50, 100}
-#define PARTICLE_TRAIL_FRICTION_RANGE     {0.95, 0.99}
+#define PARTICLE_TRAIL_FRICTION_RANGE     {0.046f, 0.547f} // per second
 #define PARTICLE_TRAIL_RADIUS_RANGE       {1, 3}
 #define PARTICLE_TRAIL_LIFE_RANGE         {0.05f, 0.08f}
 #define PARTICLE_TRAIL_ANGLE_LEEWAY_RANGE {-(Pi32/4), (Pi32/4)}
 
 void spawn_particle_trial(Vec2 pos, Vec2 dir, s32 count, Vec4 color) {
+  Game_State* gs = get_game_state();
+  
+  f32 rots[64], speeds[64], frictions[64], radii[64], life_times[64];
+  f32 sins[64], coss[64];
+  Assert(count <= (s32)ArrayCount(rots));
+  
+  f32 dir_angle = vec2_angle(dir);
+  Vec2 friction_range = PARTICLE_TRAIL_FRICTION_RANGE;
+  friction_range = {friction_per_tick(friction_range.min), friction_per_tick(friction_range.max)};
+  
+  // each property for the whole trail in one go
+  Random_Series_Wide* random = random_particle_stream();
+  random_fill_f32(random, rots,       count, PARTICLE_TRAIL_ANGLE_LEEWAY_RANGE);
+  random_fill_f32(random, speeds,     count, PARTICLE_TRAIL_VELOCITY_RANGE);
+  random_fill_f32(random, frictions,  count, friction_range);
+  random_fill_f32(random, radii,      count, PARTICLE_TRAIL_RADIUS_RANGE);
+  random_fill_f32(random, life_times, count, PARTICLE_TRAIL_LIFE_RANGE);
+  Loop(i, count) rots[i] += dir_angle;
+  
+  sincos_n(sins, coss, rots, count);
+  
   Loop(i, count) {
     Particle* p = new_particle();
-    f32 rot = vec2_angle(dir) + vec2_lerp_x_to_y(PARTICLE_TRAIL_ANGLE_LEEWAY_RANGE, random_f32());
+    s64 index = p - gs->particles;
+    
+    p->radius   = radii[i];
+    p->rotation = rots[i];
+    p->color    = color;
     
-    p->pos        = pos;
-    p->vel        = vec2(rot)*vec2_lerp_x_to_y(PARTICLE_TRAIL_VELOCITY_RANGE, random_f32());
-    p->friction   = vec2_lerp_x_to_y(PARTICLE_TRAIL_FRICTION_RANGE, random_f32());
-    p->radius     = vec2_lerp_x_to_y(PARTICLE_TRAIL_RADIUS_RANGE, random_f32());
-    p->life_timer = timer_start(vec2_lerp_x_to_y(PARTICLE_TRAIL_LIFE_RANGE, random_f32()));
-    p->rotation   = rot;
-    p->color      = color;
+    Vec2 vel = vec2(coss[i], sins[i])*speeds[i];
+    kinematics_place(&gs->particle_kinematics, index, pos, vel, frictions[i], p->radius);
+    p->expire_timer = schedule_timer_event(Timer_Event_Particle_Expire, index, life_times[i]);
   }
 }
 
 Player* get_player(void) {
-  Game_State* gs = get_game_state();
   Player* r = NULL;
+  if(get_entity_count_of_type(Entity_Type_Player) > 0) {
+    r = (Player*)get_entity_of_type(Entity_Type_Player, 0);
+  }
+  return r;
+}
+
+// Entities look at each other through the snapshots, so what they see doesn't depend on
+// who was updated first. Entities spawned this tick show up in the next one.
+void take_entity_snapshots(void) {
+  Game_State* gs = get_game_state();
+  
   Loop(i, gs->entity_count) {
-    if(gs->entities[i].type == Entity_Type_Player) {
-      r = (Player*)&gs->entities[i];
-      break;
-    }
+    Entity_Base* e = &gs->entities[i].base;
+    Entity_Snapshot* snapshot = &gs->entity_snapshots[i];
+    
+    snapshot->type      = e->type;
+    snapshot->state     = e->state;
+    snapshot->pos       = entity_pos(e);
+    snapshot->radius    = e->radius;
+    snapshot->is_active = e->is_active;
+  }
+  gs->entity_snapshot_count = gs->entity_count;
+  
+  Projectile_Pool* player_bullets = get_projectile_pool(Projectile_Faction_Player);
+  Loop(i, ArrayCount(gs->player_bullet_snapshot_mask)) {
+    gs->player_bullet_snapshot_mask[i] = player_bullets->active_mask[i];
+  }
+}
+
+Entity_Snapshot* get_player_snapshot(void) {
+  Game_State* gs = get_game_state();
+  
+  Entity_Snapshot* r = NULL;
+  Player* player = get_player();
+  if(player && player->index.value < gs->entity_snapshot_count) {
+    r = &gs->entity_snapshots[player->index.value];
   }
   return r;
 }
@@ -604,9 +1343,8 @@ b32 check_collision_vs_chain_circles(Vec2 pos, f32 radius) {
   b32 hit = false;
   
   Game_State* gs = get_game_state();
-  Loop(i, MAX_CHAIN_CIRCLES) {
+  LoopBits(i, gs->active_chain_circle_mask, MAX_CHAIN_CIRCLES) {
     Chain_Circle* c = &gs->chain_circles[i];
-    if(!c->is_active) continue;
       
     if(check_circle_vs_circle(pos, radius, c->pos, c->radius)) { hit = true; break; }
   }
@@ -671,37 +1409,87 @@ Vec2 player_process_input_lhs(void) {
   return dir;
 }
 
+// Queues a hit for each player bullet that was alive at the start of the tick and touches
+// the entity, but only as many as it takes to kill it and only the first one with
+// one_hit_per_tick. Returns true if they are lethal, unless another entity is hit by the
+// same bullets and gets them first.
+b32 entity_take_bullet_hits(Entity_Base* e, b32 one_hit_per_tick, f32 death_explosion_scale) {
+  Game_State* gs = get_game_state();
+  s32 damage = 0;
+  
+  Projectile_Pool* player_bullets = get_projectile_pool(Projectile_Faction_Player);
+  LoopBits(i, gs->player_bullet_snapshot_mask, player_bullets->capacity) {
+    Projectile* p = &player_bullets->projectiles[i];
+    
+    if(check_projectile_vs_circle(player_bullets, p, entity_pos(e), e->radius)) {
+      queue_bullet_hit(e, i, death_explosion_scale);
+      
+      damage += 1;
+      if(one_hit_per_tick || e->hit_points - damage <= 0) break;
+    }
+  }
+  
+  b32 r = damage > 0 && e->hit_points - damage <= 0;
+  return r;
+}
+
+// The first player bullet alive at the start of the tick that touches the entity, -1 if
+// none. It's used up by a hit that does no damage, for entities that only get pushed.
+s32 entity_take_bullet_push(Entity_Base* e) {
+  Game_State* gs = get_game_state();
+  
+  Projectile_Pool* player_bullets = get_projectile_pool(Projectile_Faction_Player);
+  LoopBits(i, gs->player_bullet_snapshot_mask, player_bullets->capacity) {
+    if(check_projectile_vs_circle(player_bullets, &player_bullets->projectiles[i], entity_pos(e), e->radius)) {
+      queue_bullet_hit(e, i, 0.0f, 0);
+      return (s32)i;
+    }
+  }
+  return -1;
+}
+
 void update_player(Entity* entity) {
   Game_State* gs = get_game_state();
   Player* player = (Player*)entity;
-  f32 delta_time = GetFrameTime();
+  f32 delta_time = SIM_DELTA_TIME;
   
   if(player->hit_points <= 0) return;
   
   player->score_sound_delay_time += delta_time;
-  Loop(i, MAX_SCORE_DOTS) {
-    Score_Dot* dot = &gs->score_dots[i];
-    if(!dot->is_active) continue;
+  
+  // every dot's squared distance in one go, picked up within twice the player's radius
+  Vec2 dot_offsets[MAX_SCORE_DOTS];
+  s32 dot_indices[MAX_SCORE_DOTS];
+  f32 dot_distances_sq[MAX_SCORE_DOTS];
+  s32 dot_count = 0;
+  LoopBits(i, gs->active_score_dot_mask, MAX_SCORE_DOTS) {
+    dot_offsets[dot_count] = gs->score_dots[i].pos - entity_pos(player);
+    dot_indices[dot_count] = (s32)i;
+    dot_count += 1;
+  }
+  vec2_length_sq_n(dot_distances_sq, dot_offsets, dot_count);
+  
+  f32 reach = SCORE_DOT_RADIUS + player->radius*2.0f;
+  Loop(j, dot_count) {
+    Score_Dot* dot = &gs->score_dots[dot_indices[j]];
     
-    f32 bigger_radius = player->radius*2.0f;
-    if(check_circle_vs_circle(dot->pos, SCORE_DOT_RADIUS, player->pos, bigger_radius)) {  
+    if(dot_distances_sq[j] <= reach*reach) {
       s32 value = dot->is_special ? 5 : 1;
       gs->score += value;
       remove_score_dot(dot);
       
       if(player->score_sound_delay_time > 0.075f) {
-        PlaySound(gs->score_pickup_sound);    
+        queue_sound(Game_Sound_Score_Pickup);
         player->score_sound_delay_time = 0.0f;
       }
     }
   }
   
-  timer_step(&player->wobble_timer, delta_time);  
   b32 is_wobbling = timer_is_active(player->wobble_timer);
   if(!is_wobbling) {
     b32 got_hit = false;
-    Loop(i, gs->entity_count) {
-      Entity_Base* e = (Entity_Base*)&gs->entities[i];
+    Loop(i, gs->entity_snapshot_count) {
+      Entity_Snapshot* e = &gs->entity_snapshots[i];
       if(!e->is_active) continue;
       if(e->type == Entity_Type_Player) continue;
       
@@ -710,62 +1498,66 @@ void update_player(Entity* entity) {
       if(e->state == Entity_State_Initial) continue;
       if(e->state == Entity_State_Emerge) continue;
       
-      if(check_circle_vs_circle(player->pos, player->radius, e->pos, e->radius)) {
+      if(check_circle_vs_circle(entity_pos(player), player->radius, e->pos, e->radius)) {
         got_hit = true;
         break;
       }
     }
     
-    Loop(i, MAX_PROJECTILES) {
-      Projectile* p = &gs->projectiles[i];
-      if(!p->is_active) continue;
-      if(p->from_type == Entity_Type_Player) continue;
+    for(s32 faction = Projectile_Faction_Player + 1; faction < Projectile_Faction_Count && !got_hit; faction++) {
+      Projectile_Pool* pool = get_projectile_pool((Projectile_Faction)faction);
+      
+      LoopProjectiles(i, pool) {
+        Projectile* p = &pool->projectiles[i];
+        
+        if(check_projectile_vs_circle(pool, p, entity_pos(player), player->radius)) {
+          got_hit = true;
+          break;
+        }
+      }
+    }
+    
+    LoopBits(i, gs->active_laser_beam_mask, MAX_LASER_BEAMS) {
+      Laser_Beam* b = &gs->laser_beams[i];
       
-      if(check_circle_vs_circle(player->pos, player->radius, p->pos, p->radius)) {
+      if(check_laser_beam_vs_circle(b, entity_pos(player), player->radius)) {
         got_hit = true;
         break;
       }
     }
     
-    Loop(i, MAX_CHAIN_CIRCLES) {
+    LoopBits(i, gs->active_chain_circle_mask, MAX_CHAIN_CIRCLES) {
       Chain_Circle* c = &gs->chain_circles[i];
-      if(!c->is_active) continue;
       if(!c->is_infected) continue;
       
-      if(check_circle_vs_circle(player->pos, player->radius, c->pos, c->radius*c->infection)) {
+      if(check_circle_vs_circle(entity_pos(player), player->radius, c->pos, c->radius*c->infection)) {
         got_hit = true;
       }
     }
     
     if(got_hit) {
-      PlaySound(gs->player_hit_sound);
+      queue_sound(Game_Sound_Player_Hit);
       player->wobble_timer = timer_start(3.0f);
       is_wobbling = true;
       player->hit_points -= 1;
     }
   }
   
-  Vec2 (*process_shoot_input) (void);
-  Vec2 (*process_move_input)  (void);
-  
-  process_shoot_input = player_process_input_rhs;
-  process_move_input  = player_process_input_lhs;
-  
-  Vec2 shoot_dir = process_shoot_input();
-  Vec2 move_dir  = process_move_input();
+  Vec2 shoot_dir = gs->input.shoot_dir;
+  Vec2 move_dir  = gs->input.move_dir;
 
-  shoot_dir = vec2_normalize(shoot_dir);
-  move_dir = vec2_normalize(move_dir);
+  Vec2 dirs[2] = {shoot_dir, move_dir};
+  vec2_normalize_n(dirs, dirs, 2);
+  shoot_dir = dirs[0];
+  move_dir  = dirs[1];
   
   // Shoot
-  timer_step(&player->shoot_cooldown_timer, delta_time);
       
   b32 want_to_shoot = vec2_length(shoot_dir) > 0.0f;
   b32 can_shoot     = !timer_is_active(player->shoot_cooldown_timer);
   if(want_to_shoot && can_shoot) {
 
-    Projectile* p = new_projectile();
-    p->pos = player->pos;
+    Projectile* p = new_projectile(Projectile_Faction_Player);
     p->radius = 6;
     p->color = WHITE_VEC4;
     p->dir = shoot_dir;
@@ -773,11 +1565,12 @@ void update_player(Entity* entity) {
     p->move_speed = 650;
     p->emit_timer = timer_start(0.0f);
     projectile_set_parent(p, (Entity*)player);
+    projectile_place(get_projectile_pool(Projectile_Faction_Player), p, entity_pos(player));
     
     timer_reset(&player->shoot_cooldown_timer);
     player->shoot_indicator_timer = timer_start(0.25f);
     
-    PlaySound(gs->player_shoot_sound);
+    queue_sound(Game_Sound_Player_Shoot);
   }
 
   // Expand a bit when shooting
@@ -788,7 +1581,7 @@ void update_player(Entity* entity) {
   else {
     player->flap = 0.0f;
     f32 x = timer_procent(player->shoot_indicator_timer)*2*Pi32;
-    player->shoot_indicator = (cosf(x + Pi32) + 1.0f)/2.0f; 
+    player->shoot_indicator = (cos_f32(x + Pi32, Trig_Accuracy_Low) + 1.0f)/2.0f; 
   }
   
   // Wobble
@@ -800,12 +1593,12 @@ void update_player(Entity* entity) {
     
     f32 x = 2*Pi32*t;
     player->wobble_scale = 20.0f;
-    player->wobble = ((cosf(x*5.0f + Pi32) + 1)/2);
+    player->wobble = ((cos_f32(x*5.0f + Pi32, Trig_Accuracy_Low) + 1)/2);
   }
   
   // Flaping
   if(!is_wobbling && !is_shoot_indicator_active) {
-    player->flap = cosf(GetTime()*18.0f)*0.075f;
+    player->flap = cos_f32(GetTime()*18.0f, Trig_Accuracy_Low)*0.075f;
   }
   
   // Turning
@@ -817,300 +1610,233 @@ void update_player(Entity* entity) {
   f32 turn_delta = turn_dir*PLAYER_TURN_SPEED*delta_time;
   player->turn_angle += turn_delta;
   
-  // Move
-  Vec2 vel = move_dir*PLAYER_MOVE_SPEED;
-  Vec2 move_delta = vel*delta_time;
-
-  player->pos += move_delta;
-  
-  if(player->pos.x < 0)             player->pos.x = 0.0f;
-  if(player->pos.x > WINDOW_WIDTH)  player->pos.x = WINDOW_WIDTH;
-  if(player->pos.y < 0)             player->pos.y = 0.0;
-  if(player->pos.y > WINDOW_HEIGHT) player->pos.y = WINDOW_HEIGHT;
+  // Move, move_entities keeps the player on the screen
+  entity_set_vel(player, move_dir*PLAYER_MOVE_SPEED);
 }
 
 
-void update_laser_turret(Entity* entity) {
+void laser_turret_script(Laser_Turret* turret) {
   Game_State* gs = get_game_state();
-  f32 delta_time = GetFrameTime();
+  f32 delta_time = SIM_DELTA_TIME;
+  Script* script = &turret->script;
   
-  Player* player = get_player();
-  Laser_Turret* turret = (Laser_Turret*)entity;
-
-  turret->rotation = turret->shoot_angle;
-  timer_step(&turret->health_bar_display_timer, delta_time);
-    
-  // projectile interaction  
-  Loop(i, MAX_PROJECTILES) {
-    Projectile* p = &gs->projectiles[i];
-    if(!p->is_active) continue;
-    if(p->from_type != Entity_Type_Player) continue;
-    
-    Vec2 d = turret->pos - p->pos;
-    if(vec2_length(d) < turret->radius + p->radius) {
-      remove_projectile(p);
-      
-      turret->hit_points -= 1;      
-      if(turret->hit_points <= 0) {
-        spawn_explosion(turret->pos, turret->radius*2.5f, 1.0f);
-        remove_entity(turret);
-        return;
-      }
-      
-      turret->health_bar_display_timer = timer_start(1.25f);
-    }
-  }
+  Entity_Snapshot* player = get_player_snapshot();
   
-  // chain circle interaction
-  if(check_collision_vs_chain_circles(turret->pos, turret->radius)) {
-    PlaySound(gs->explosion_sound);
-    spawn_chain_circle(turret->pos, BIG_CHAIN_CIRCLE);
-    spawn_score_dot(turret->pos, false);
-    remove_entity(turret);
-    return;
-  }
+  u32 blink_ticks     = ticks_from_seconds(0.12f, delta_time);
+  u32 telegraph_ticks = ticks_from_seconds(1.5f, delta_time);
   
-  // FSM  
-  switch(turret->state) {
-    case Entity_State_Initial: {
-      turret->pos = random_screen_pos(120, 120);
-      turret->radius = 0.0f;
+  ScriptBegin(script);
+  
+  entity_place(turret, random_screen_pos(120, 120));
+  turret->radius = 0.0f;
 
-      turret->color = BLUE_VEC4;
-      entity_set_hit_points(turret, LASER_TURRET_HIT_POINTS);
-      
-      turret->shoot_angle = random_f32()*2.0f*Pi32;
-      entity_change_state(turret, Entity_State_Emerge);
-    }break;
-    case Entity_State_Emerge: {
-      if(entity_enter_state(turret)) turret->state_timer = timer_start(2.0f);
-      
+  turret->color = BLUE_VEC4;
+  entity_set_hit_points(turret, LASER_TURRET_HIT_POINTS);
+  
+  turret->shoot_angle = random_f32()*2.0f*Pi32;
+  ScriptChangeState(script, turret, Entity_State_Emerge);
+  
+  turret->state_timer = timer_start(2.0f);
+  for(;;) {
+    {
       f32 t = timer_procent(turret->state_timer);
       t = lerp_f32(0.2f, 1.0f, t);
       ease_out_quad(&t);
       
       turret->radius = LASER_TURRET_RADIUS*t;
-      
-      if(timer_step(&turret->state_timer, delta_time)) {
-        turret->radius = LASER_TURRET_RADIUS;
-        entity_change_state(turret, Entity_State_Targeting);
-      }
-    }break;
-    case Entity_State_Targeting: {
-      if(entity_enter_state(turret)) {
-        turret->state_timer = timer_start(5.0f);
+    }
+    if(timer_step(&turret->state_timer, delta_time)) break;
+    ScriptYield(script);
+  }
+  turret->radius = LASER_TURRET_RADIUS;
+  
+  for(;;) {
+    ScriptChangeState(script, turret, Entity_State_Targeting);
+    
+    turret->state_timer = timer_start(5.0f);
+    for(;;) {
+      // without a player it keeps aiming where it was
+      if(player) {
+        Vec2 v = player->pos - entity_pos(turret);
+        f32 target_angle = vec2_angle(v);
+        f32 lerp_t = 1.0f - friction_per_tick(LASER_TURRET_AIM_LEFT_PER_SECOND);
+        
+        f32 disp = target_angle - turret->shoot_angle;
+        if(Abs(target_angle - turret->shoot_angle) >= Pi32) disp = -(2*Pi32 - disp);
+        
+        turret->shoot_angle += disp*lerp_t;
       }
+      if(timer_step(&turret->state_timer, delta_time)) break;
+      ScriptYield(script);
+    }
+    
+    ScriptChangeState(script, turret, Entity_State_Telegraphing);
+    
+    // blink until the shot, nothing else happens in between
+    turret->blinked_count = 0;
+    while((u32)(turret->blinked_count + 1)*blink_ticks < telegraph_ticks) {
+      ScriptWaitTicks(script, gs->sim_tick, blink_ticks);
       
-      Vec2 v = player->pos - turret->pos;
-      f32 target_angle = vec2_angle(v);
-      f32 lerp_speed = 0.025f;
-      f32 lerp_t = lerp_speed*delta_time;
+      turret->blinked_count += 1;
+      if(turret->blinked_count % 2 == 0) turret->color = BLUE_VEC4;
+      else                               turret->color = WHITE_VEC4;
+    }
+    ScriptWaitTicks(script, gs->sim_tick, telegraph_ticks - turret->blinked_count*blink_ticks);
+    
+    {
+      turret->color = BLUE_VEC4;
       
-      f32 disp = target_angle - turret->shoot_angle;
-      if(Abs(target_angle - turret->shoot_angle) >= Pi32) disp = -(2*Pi32 - disp);
+      Vec2 shoot_dir = vec2(turret->shoot_angle);
+      f32 shoot_max_len = vec2_length({WINDOW_WIDTH, WINDOW_HEIGHT});
       
-      turret->shoot_angle += disp*lerp_speed;
-            
-      if(timer_step(&turret->state_timer, delta_time)) {
-        entity_change_state(turret, Entity_State_Telegraphing);
-      }
-    }break;
-    case Entity_State_Telegraphing: {
-      if(entity_enter_state(turret)) {
-        turret->state_timer = timer_start(1.5f);
-        turret->blink_timer = timer_start(0.12f);
-        turret->blinked_count = 0;
-      }
+      f32 offset_to_gun = turret->radius + LASER_TURRET_GUN_HEIGHT + LASER_BEAM_RADIUS/2;
       
-      if(timer_step(&turret->blink_timer, delta_time)) {
-        timer_reset(&turret->blink_timer);
-        turret->blinked_count += 1;
-        
-        if(turret->blinked_count % 2 == 0) turret->color = BLUE_VEC4;
-        else                               turret->color = WHITE_VEC4;
-      }
+      Laser_Beam* beam = new_laser_beam();
+      beam->origin        = entity_pos(turret) + shoot_dir*offset_to_gun;
+      beam->dir           = shoot_dir;
+      beam->rotation      = turret->rotation;
+      beam->radius        = LASER_BEAM_RADIUS;
+      beam->segment_step  = shoot_max_len/LASER_BEAM_SEGMENT_COUNT;
+      beam->first_segment = 0;
+      beam->end_segment   = LASER_BEAM_SEGMENT_COUNT;
+      beam->spawn_tick    = gs->sim_tick;
+      beam->shooter_id    = (u32)turret->id.value;
+      laser_beam_schedule_expiry(beam);
       
-      if(timer_step(&turret->state_timer, delta_time)) {
-        turret->color = BLUE_VEC4;
-        
-        Vec2 shoot_dir = vec2(turret->shoot_angle);
-        f32 shoot_max_len = vec2_length({WINDOW_WIDTH, WINDOW_HEIGHT});
-        
-        s32 bullet_count = 65;
-        f32 bullet_radius = LASER_TURRET_PROJECTILE_RADIUS;
-        
-        f32 offset_to_gun = turret->radius + LASER_TURRET_GUN_HEIGHT + bullet_radius/2;
-        Vec2 pos = turret->pos + shoot_dir*offset_to_gun;
-        f32 step = shoot_max_len/bullet_count;
-
-        Loop(i, bullet_count) {
-          Projectile* p = new_projectile();
-          p->pos = pos + vec2(random_angle())*random_f32()*3.0f;
-          p->rotation = turret->rotation + random_f32(-1,1)*Pi32*0.2f;
-          p->radius = bullet_radius;
-          
-          p->dir = vec2(p->rotation);
-          p->move_speed = 5.0f;
-          
-          projectile_set_parent(p, (Entity*)turret);
-          projectile_set_life_time(p, LASER_TURRET_PROJECTILE_LIFETIME);
-          
-          pos += shoot_dir*step;
-        }
-        
-        entity_change_state(turret, Entity_State_Targeting);
-        
-        PlaySound(gs->laser_shot_sound);
-      }
-    }break;
+      queue_sound(Game_Sound_Laser_Shot);
+    }
   }
+  
+  ScriptEnd(script);
 }
 
-void update_triple_gun_turret(Entity* entity) {
+void update_laser_turret(Entity* entity) {
   Game_State* gs = get_game_state();
-  f32 delta_time = GetFrameTime();
-
-  Triple_Gun_Turret* turret = (Triple_Gun_Turret*)entity;
-
-  timer_step(&turret->health_bar_display_timer, delta_time);
+  
+  Laser_Turret* turret = (Laser_Turret*)entity;
 
-  // projectile interaction 
-  Loop(i, MAX_PROJECTILES) {
-    Projectile* p = &gs->projectiles[i];
-    if(!p->is_active) continue;
-    if(p->from_type != Entity_Type_Player) continue;
+  turret->rotation = turret->shoot_angle;
     
-    if(check_circle_vs_circle(turret->pos, turret->radius, p->pos, p->radius)) {
-      remove_projectile(p);
-      
-      turret->hit_points -= 1;
-      
-      if(turret->hit_points <= 0) { 
-        spawn_explosion(turret->pos, turret->radius*2.5f, 1.0f);
-        remove_entity(turret);
-        return;
-      }
-      
-      turret->health_bar_display_timer = timer_start(1.25);
-      break;
-    }
-  }
+  // projectile interaction  
+  if(entity_take_bullet_hits(turret, false, turret->radius*2.5f)) return;
   
   // chain circle interaction
-  if(check_collision_vs_chain_circles(turret->pos, turret->radius)) {
-    PlaySound(gs->explosion_sound);
-    spawn_chain_circle(turret->pos, BIG_CHAIN_CIRCLE);
-    spawn_score_dot(turret->pos, false);
+  if(check_collision_vs_chain_circles(entity_pos(turret), turret->radius)) {
+    queue_sound(Game_Sound_Explosion);
+    queue_spawn_chain_circle(entity_pos(turret), BIG_CHAIN_CIRCLE);
+    queue_spawn_score_dot(entity_pos(turret), false);
     remove_entity(turret);
     return;
   }
-    
-  // FSM
-  switch(turret->state) {
-    case Entity_State_Initial: {
-      turret->pos = random_screen_pos(120, 120);
-      turret->radius = 0.0f;
-      turret->rotation = random_angle();
-      turret->color = TRIPLE_GUN_TURRET_COLOR;
-      entity_set_hit_points(turret, LASER_TURRET_HIT_POINTS);
-      
-      entity_change_state(turret, Entity_State_Emerge);
-    }break;
-    case Entity_State_Emerge: {
-      if(entity_enter_state(turret)) turret->state_timer = timer_start(2.0f);
-      
+  
+  if(script_should_resume(&turret->script, gs->sim_tick)) laser_turret_script(turret);
+}
+
+void triple_gun_turret_script(Triple_Gun_Turret* turret) {
+  f32 delta_time = SIM_DELTA_TIME;
+  Script* script = &turret->script;
+  
+  ScriptBegin(script);
+  
+  entity_place(turret, random_screen_pos(120, 120));
+  turret->radius = 0.0f;
+  turret->rotation = random_angle();
+  turret->color = TRIPLE_GUN_TURRET_COLOR;
+  entity_set_hit_points(turret, LASER_TURRET_HIT_POINTS);
+  
+  ScriptChangeState(script, turret, Entity_State_Emerge);
+  
+  turret->state_timer = timer_start(2.0f);
+  for(;;) {
+    {
       f32 t = timer_procent(turret->state_timer);
       t = lerp_f32(0.2f, 1.0f, t);
       ease_out_quad(&t);
       
       turret->radius = TRIPLE_GUN_TURRET_RADIUS*t;
-      
-      if(timer_step(&turret->state_timer, delta_time)) {
-        turret->radius = TRIPLE_GUN_TURRET_RADIUS;
-        entity_change_state(turret, Entity_State_Waiting);
-      }
-    }break;
-    case Entity_State_Waiting: {
-      if(entity_enter_state(turret)) {
-        turret->state_timer = timer_start(3.0f);
-      }
-      
-      if(timer_step(&turret->state_timer, delta_time))
-        entity_change_state(turret, Entity_State_Telegraphing);
-    }break;
-    case Entity_State_Telegraphing: {
-      if(entity_enter_state(turret)) {
-        turret->state_timer = timer_start(2.0f);
-      }
-      
-      f32 x = 2.0f*Pi32*timer_procent(turret->state_timer);
-      f32 t = (cosf(x*10 + Pi32) + 1)/2;
-      turret->color = vec4_lerp(TRIPLE_GUN_TURRET_COLOR, WHITE_VEC4, t);
-      
-      if(timer_step(&turret->state_timer, delta_time)) {
-        entity_change_state(turret, Entity_State_Active);
-      }
-    }break;
-    case Entity_State_Active: {
-      if(entity_enter_state(turret)) {
-        turret->projectiles_left_to_spawn = TRIPLE_GUN_TURRET_BULLET_COUNT;
-        turret->projectile_spawn_timer = timer_start(TRIPLE_GUN_TURRET_FIRE_RATE);
+    }
+    if(timer_step(&turret->state_timer, delta_time)) break;
+    ScriptYield(script);
+  }
+  turret->radius = TRIPLE_GUN_TURRET_RADIUS;
+  
+  for(;;) {
+    ScriptChangeState(script, turret, Entity_State_Waiting);
+    ScriptWait(script, 3.0f);
+    
+    entity_change_state(turret, Entity_State_Telegraphing);
+    
+    turret->state_timer = timer_start(2.0f);
+    for(;;) {
+      {
+        f32 x = 2.0f*Pi32*timer_procent(turret->state_timer);
+        f32 t = (cos_f32(x*10 + Pi32, Trig_Accuracy_Low) + 1)/2;
+        turret->color = vec4_lerp(TRIPLE_GUN_TURRET_COLOR, WHITE_VEC4, t);
       }
+      if(timer_step(&turret->state_timer, delta_time)) break;
+      ScriptYield(script);
+    }
+    
+    ScriptChangeState(script, turret, Entity_State_Active);
+    
+    turret->projectiles_left_to_spawn = TRIPLE_GUN_TURRET_BULLET_COUNT;
+    while(turret->projectiles_left_to_spawn > 0) {
+      ScriptWait(script, TRIPLE_GUN_TURRET_FIRE_RATE);
       
-      b32 should_spawn = false;      
-      if(timer_step(&turret->projectile_spawn_timer, delta_time)) {
-        should_spawn = true;
-        timer_reset(&turret->projectile_spawn_timer);
-      }      
-      
-      if(should_spawn) {
+      {
         f32 angle_step = TRIPLE_GUN_TURRET_GUN_ANGLE_STEP;
         f32 angle = turret->rotation - angle_step;
         
-        Loop(i, 3) {
-          Vec2 dir = vec2(angle);
-          Vec2 pos = turret->pos + dir*(turret->radius + TRIPLE_GUN_TURRET_BULLET_RADIUS);
-          
-          Projectile* p = new_projectile();
-          p->pos = pos;
-          p->dir = dir;
-          p->rotation = angle;
-          p->move_speed = TRIPLE_GUN_TURRET_BULLET_MOVE_SPEED;
-          p->radius = TRIPLE_GUN_TURRET_BULLET_RADIUS;
-          p->color = YELLOW_VEC4;
-          projectile_set_parent(p, (Entity*)turret);
-          
-          angle += angle_step;
-        }
+        Projectile proto = {};
+        proto.move_speed = TRIPLE_GUN_TURRET_BULLET_MOVE_SPEED;
+        proto.radius     = TRIPLE_GUN_TURRET_BULLET_RADIUS;
+        proto.color      = YELLOW_VEC4;
+        projectile_set_parent(&proto, (Entity*)turret);
         
-        turret->projectiles_left_to_spawn -= 1;
+        Projectile_Range range = spawn_projectiles_batch(Projectile_Faction_Chain, 3, proto);
+        f32 offset = turret->radius + TRIPLE_GUN_TURRET_BULLET_RADIUS;
+        projectile_range_fill_fan(range, entity_pos(turret), offset, angle, angle_step);
       }
       
-      if(turret->projectiles_left_to_spawn <= 0) {
-        Player* player = get_player();
-
-        f32 rotation_dir = -1;
-        f32 angle_to_player = vec2_angle(player->pos - turret->pos);
-        if(Abs(angle_to_player - turret->rotation) > Pi32) rotation_dir = 1;
-        
-        turret->rotation = angle_to_player;//rotation_dir*(Pi32/4);
-        entity_change_state(turret, Entity_State_Waiting);
-      }
-    }break;
+      turret->projectiles_left_to_spawn -= 1;
+    }
+    
+    {
+      Entity_Snapshot* player = get_player_snapshot();
+      if(player) turret->rotation = vec2_angle(player->pos - entity_pos(turret));
+    }
   }
+  
+  ScriptEnd(script);
 }
 
+void update_triple_gun_turret(Entity* entity) {
+  Game_State* gs = get_game_state();
+
+  Triple_Gun_Turret* turret = (Triple_Gun_Turret*)entity;
+
+  // projectile interaction 
+  if(entity_take_bullet_hits(turret, true, turret->radius*2.5f)) return;
+  
+  // chain circle interaction
+  if(check_collision_vs_chain_circles(entity_pos(turret), turret->radius)) {
+    queue_sound(Game_Sound_Explosion);
+    queue_spawn_chain_circle(entity_pos(turret), BIG_CHAIN_CIRCLE);
+    queue_spawn_score_dot(entity_pos(turret), false);
+    remove_entity(turret);
+    return;
+  }
+    
+  if(script_should_resume(&turret->script, gs->sim_tick)) triple_gun_turret_script(turret);
+}
 
 void update_goon(Entity* entity) {
-  Game_State* gs = get_game_state();
-  f32 delta_time = GetFrameTime();
+  f32 delta_time = SIM_DELTA_TIME;
   
   Goon* goon = (Goon*)entity;
   
   // Move
-  Vec2 vel = goon->dir*goon->move_speed;
-  Vec2 move_delta = vel*delta_time;
-  goon->pos += move_delta;
+  entity_set_vel(goon, goon->dir*goon->move_speed);
   
   // FSM
   switch(goon->state) {
@@ -1119,7 +1845,7 @@ void update_goon(Entity* entity) {
         goon->state_timer = timer_start(10.0f);
       }
 
-      b32 on_screen = !is_circle_completely_offscreen(goon->pos, goon->radius);
+      b32 on_screen = !is_circle_completely_offscreen(entity_pos(goon), goon->radius);
       
       if(on_screen) {
         entity_change_state(goon, Entity_State_Active);
@@ -1128,153 +1854,118 @@ void update_goon(Entity* entity) {
       }
     }break;
     case Entity_State_Active: {
-      if(is_circle_completely_offscreen(goon->pos, goon->radius)) {
+      if(is_circle_completely_offscreen(entity_pos(goon), goon->radius)) {
         remove_entity(goon);
         return;
       }
     
       // projectile interaction
-      Loop(i, MAX_PROJECTILES) {
-        Projectile* p = &gs->projectiles[i];
-        if(!p->is_active) continue;
-        if(p->from_type != Entity_Type_Player) continue;
-        
-        if(check_circle_vs_circle(goon->pos, goon->radius, p->pos, p->radius)) {
-          goon->hit_points -= 1;
-          goon->health_bar_display_timer = timer_start(1.25f);
-
-          remove_projectile(p);
-          
-          if(goon->hit_points <= 0) {
-            remove_entity(goon);
-            spawn_explosion(goon->pos, SMALL_CHAIN_CIRCLE, 1.0f);
-            return;
-          }
-        }
-      }
+      if(entity_take_bullet_hits(goon, false, SMALL_CHAIN_CIRCLE)) return;
       
       // chain circle interaction      
-      if(check_collision_vs_chain_circles(goon->pos, goon->radius)) {
-        PlaySound(gs->explosion_sound);
-        spawn_chain_circle(goon->pos, SMALL_CHAIN_CIRCLE);
-        spawn_score_dot(goon->pos, false);
+      if(check_collision_vs_chain_circles(entity_pos(goon), goon->radius)) {
+        queue_sound(Game_Sound_Explosion);
+        queue_spawn_chain_circle(entity_pos(goon), SMALL_CHAIN_CIRCLE);
+        queue_spawn_score_dot(entity_pos(goon), false);
         remove_entity(goon);
         return;
       }
       
-      timer_step(&goon->health_bar_display_timer, delta_time);
       
     }break;
   }
 }
 
-void update_chain_activator(Entity* entity) {
-  Game_State* gs = get_game_state();
-  f32 delta_time = GetFrameTime();
+void chain_activator_script(Chain_Activator* activator) {
+  f32 delta_time = SIM_DELTA_TIME;
+  Script* script = &activator->script;
   
-  Chain_Activator* activator = (Chain_Activator*)entity;
+  s32 orbital_count = ArrayCount(activator->orbitals);
   
-  // FSM
-  switch(activator->state) {
-    case Entity_State_Initial: {
-      if(!activator->for_tutorial_purposes) {
-        activator->pos = random_offscreen_pos(CHAIN_ACTIVATOR_START_RADIUS*4);
-        f32 angle_to_center = vec2_angle(get_screen_center() - activator->pos);
-        f32 dir_angle = angle_to_center + random_f32(-1, 1)*(Pi32/6);
-        
-        activator->dir = vec2(dir_angle);
-      }
-      
-      activator->move_speed = CHAIN_ACTIVATOR_MOVE_SPEED;
-      
-      activator->start_radius = CHAIN_ACTIVATOR_START_RADIUS;
-      activator->end_radius   = CHAIN_ACTIVATOR_END_RADIUS;
-      activator->start_color  = CHAIN_ACTIVATOR_START_COLOR;
-      activator->end_color    = CHAIN_ACTIVATOR_END_COLOR;   
-      
-      activator->orbital_radius = CHAIN_ACTIVATOR_ORBITAL_RADIUS;
-      
-      activator->orbital_global_rotation = random_angle();
-      
-      Loop(i, ArrayCount(activator->orbitals)) {
-        activator->orbitals[i].rotation = random_angle();
-        activator->orbitals[i].active = true;
-        activator->orbitals[i].time = 0.0f;
-      }
+  ScriptBegin(script);
+  
+  if(!activator->for_tutorial_purposes) {
+    entity_place(activator, random_offscreen_pos(CHAIN_ACTIVATOR_START_RADIUS*4));
+    f32 angle_to_center = vec2_angle(get_screen_center() - entity_pos(activator));
+    f32 dir_angle = angle_to_center + random_f32(-1, 1)*(Pi32/6);
     
-      activator->color  = activator->start_color;
-      activator->radius = activator->start_radius;
-            
-      entity_change_state(activator, Entity_State_Offscreen);
-    }break;
-    case Entity_State_Offscreen: {
-      if(entity_enter_state(activator)) {
-        activator->state_timer = timer_start(50.0f);
-      }
-      
-      activator->vel = activator->move_speed*activator->dir;
-      Vec2 move_delta = activator->vel*delta_time;
-      activator->pos += move_delta;
+    activator->dir = vec2(dir_angle);
+  }
+  
+  activator->move_speed = CHAIN_ACTIVATOR_MOVE_SPEED;
+  
+  activator->start_radius = CHAIN_ACTIVATOR_START_RADIUS;
+  activator->end_radius   = CHAIN_ACTIVATOR_END_RADIUS;
+  activator->start_color  = CHAIN_ACTIVATOR_START_COLOR;
+  activator->end_color    = CHAIN_ACTIVATOR_END_COLOR;   
+  
+  activator->orbital_radius = CHAIN_ACTIVATOR_ORBITAL_RADIUS;
+  
+  activator->orbital_global_rotation = random_angle(random_stream(Random_Stream_Cosmetic));
+  
+  Loop(i, orbital_count) {
+    activator->orbitals[i].rotation = random_angle(random_stream(Random_Stream_Cosmetic));
+    activator->orbitals[i].active = true;
+    activator->orbitals[i].time = 0.0f;
+  }
+
+  activator->color  = activator->start_color;
+  activator->radius = activator->start_radius;
+        
+  ScriptChangeState(script, activator, Entity_State_Offscreen);
+  
+  activator->state_timer = timer_start(50.0f);
+  while(activator->state == Entity_State_Offscreen) {
+    {
+      entity_set_vel(activator, activator->move_speed*activator->dir);
       
-      b32 on_screen = !is_circle_completely_offscreen(activator->pos, activator->radius);
+      b32 on_screen = !is_circle_completely_offscreen(entity_pos(activator), activator->radius);
       if(on_screen) {
         entity_change_state(activator, Entity_State_Active);
-        break;
       }
-      
-      if(timer_step(&activator->state_timer, delta_time)) {
+      else if(timer_step(&activator->state_timer, delta_time)) {
         remove_entity(activator);
-      }      
-    }break;
-    case Entity_State_Active: {
-      Loop(i, MAX_PROJECTILES) {
-        Projectile* p = &gs->projectiles[i];
-        if(!p->is_active) continue;
-        if(p->from_type != Entity_Type_Player) continue;
-        
-        if(check_circle_vs_circle(activator->pos, activator->radius, p->pos, p->radius)) {
-          remove_projectile(p);
-          entity_change_state(activator, Entity_State_Telegraphing);
-          break;
-        }
+        return;
       }
-      
-      if(check_collision_vs_chain_circles(activator->pos, activator->radius)) {
+    }
+    ScriptYield(script);
+  }
+  
+  // waits for a hit, the state is changed by the hit itself
+  while(activator->state == Entity_State_Active) {
+    {
+      if(entity_take_bullet_push(activator) >= 0) {
         entity_change_state(activator, Entity_State_Telegraphing);
       }
       
-      activator->vel = activator->move_speed*activator->dir;
-      Vec2 move_delta = activator->vel*delta_time;
-      activator->pos += move_delta;
-    }break;
-    case Entity_State_Telegraphing: {
-      Loop(i, MAX_PROJECTILES) {
-        Projectile* p = &gs->projectiles[i];
-        if(!p->is_active) continue;
-        if(p->from_type != Entity_Type_Player) continue;
-        
-        if(check_circle_vs_circle(activator->pos, activator->radius, p->pos, p->radius)) {
-          activator->vel = p->dir*350.0f;
-          remove_projectile(p);
-          break;
-        }
+      if(check_collision_vs_chain_circles(entity_pos(activator), activator->radius)) {
+        entity_change_state(activator, Entity_State_Telegraphing);
       }
       
-      f32 friction = 0.97f;
-      activator->vel *= friction;
-      Vec2 move_delta = activator->vel*delta_time;
-      activator->pos += move_delta;
-      
-      s32 orbital_count = ArrayCount(activator->orbitals);
-
-      if(entity_enter_state(activator)) {
-        f32 telegraph_time = 2.25f;
-        Loop(i, orbital_count) {
-          f32 t = (f32)i/(f32)orbital_count;
-          activator->orbitals[i].time = telegraph_time*t;
-        }
-        
-        activator->state_timer = timer_start(telegraph_time);
+      entity_set_vel(activator, activator->move_speed*activator->dir);
+    }
+    ScriptYield(script);
+  }
+  
+  {
+    // slides on from how it was moving, or from a bullet's push, and slows down
+    entity_set_vel(activator, entity_vel(activator), friction_per_tick(CHAIN_ACTIVATOR_FRICTION));
+    
+    f32 telegraph_time = 2.25f;
+    Loop(i, orbital_count) {
+      f32 t = (f32)i/(f32)orbital_count;
+      activator->orbitals[i].time = telegraph_time*t;
+    }
+    
+    activator->state_timer = timer_start(telegraph_time);
+  }
+  
+  for(;;) {
+    {
+      s32 bullet = entity_take_bullet_push(activator);
+      if(bullet >= 0) {
+        Projectile* p = &get_projectile_pool(Projectile_Faction_Player)->projectiles[bullet];
+        entity_set_vel(activator, p->dir*350.0f, friction_per_tick(CHAIN_ACTIVATOR_FRICTION));
       }
       
       activator->rotation -= 4.0f*delta_time;
@@ -1288,15 +1979,25 @@ void update_chain_activator(Entity* entity) {
       
       activator->radius = lerp_f32(activator->start_radius, activator->end_radius, lerp_t);
       activator->color  = vec4_lerp(activator->start_color, activator->end_color, lerp_t);
+    }
+    if(timer_step(&activator->state_timer, delta_time)) break;
+    ScriptYield(script);
+  }
+  
+  queue_sound(Game_Sound_Explosion);
+  queue_spawn_chain_circle(entity_pos(activator), MEDIUM_CHAIN_CIRCLE);
+  remove_entity(activator);
+  
+  ScriptEnd(script);
+}
 
-      if(timer_step(&activator->state_timer, delta_time)) {
-        PlaySound(gs->explosion_sound);
-
-        spawn_chain_circle(activator->pos, MEDIUM_CHAIN_CIRCLE);        
-        remove_entity(activator);
-      }
-    }break;
-  }  
+void update_chain_activator(Entity* entity) {
+  Game_State* gs = get_game_state();
+  f32 delta_time = SIM_DELTA_TIME;
+  
+  Chain_Activator* activator = (Chain_Activator*)entity;
+  
+  if(script_should_resume(&activator->script, gs->sim_tick)) chain_activator_script(activator);
   
   // rotation
   activator->rotation -= delta_time;
@@ -1307,207 +2008,295 @@ void update_chain_activator(Entity* entity) {
   }
 }
 
-void update_infector(Entity* entity) {
-  Game_State* gs = get_game_state();
-  f32 delta_time = GetFrameTime();
+void infector_script(Infector* infector) {
+  f32 delta_time = SIM_DELTA_TIME;
+  Script* script = &infector->script;
   
-  Infector* infector = (Infector*)entity;
+  ScriptBegin(script);
   
+  entity_place(infector, random_offscreen_pos(INFECTOR_RADIUS*4));
   
-  timer_step(&infector->health_bar_display_timer, delta_time);
+  {
+    f32 angle_to_center = vec2_angle(get_screen_center() - entity_pos(infector));
+    f32 dir_angle = angle_to_center + random_f32(-1, 1)*(Pi32/6);
+    infector->dir = vec2(dir_angle);
+  }
   
-  // projectile interaction 
-  Loop(i, MAX_PROJECTILES) {
-    Projectile* p = &gs->projectiles[i];
-    if(!p->is_active) continue;
-    if(p->from_type != Entity_Type_Player) continue;
-    
-    if(check_circle_vs_circle(infector->pos, infector->radius, p->pos, p->radius)) {
-      remove_projectile(p);
+  infector->radius = INFECTOR_RADIUS;
+  infector->move_speed = INFECTOR_MOVE_SPEED;
+  entity_set_hit_points(infector, INFECTOR_HIT_POITNS);
+  
+  ScriptChangeState(script, infector, Entity_State_Offscreen);
+  
+  infector->state_timer = timer_start(10.0f);
+  while(infector->state == Entity_State_Offscreen) {
+    {
+      entity_set_vel(infector, infector->dir*infector->move_speed);
       
-      infector->hit_points -= 1;
+      b32 on_screen = !is_circle_completely_offscreen(entity_pos(infector), infector->radius);
+      if(on_screen) entity_change_state(infector, Entity_State_Waiting);
       
-      if(infector->hit_points <= 0) { 
-        spawn_explosion(infector->pos, infector->radius*2.5f, 1.0f);
+      if(timer_step(&infector->state_timer, delta_time)) {
         remove_entity(infector);
         return;
       }
+    }
+    ScriptYield(script);
+  }
+  
+  for(;;) {
+    infector->state_timer = timer_start(6.0f);
+    for(;;) {
+      {
+        entity_set_vel(infector, infector->dir*infector->move_speed);
+      }
+      if(timer_step(&infector->state_timer, delta_time)) break;
+      ScriptYield(script);
+    }
+    
+    ScriptChangeState(script, infector, Entity_State_Telegraphing);
+    entity_set_vel(infector, vec2(0, 0));
+    
+    infector->state_timer = timer_start(2.0f);
+    for(;;) {
+      {
+        f32 x = 2*Pi32*timer_procent(infector->state_timer);
+        f32 t = (cos_f32(x*8.0f + Pi32, Trig_Accuracy_Low) + 1)/2.0f;
+        infector->wobble = t;
+      }
+      if(timer_step(&infector->state_timer, delta_time)) break;
+      ScriptYield(script);
+    }
+    
+    {
+      s32 bullet_count = 6;
+      f32 angle_step = (2*Pi32)/(f32)bullet_count;
       
-      infector->health_bar_display_timer = timer_start(1.25);
-      break;
+      Projectile proto = {};
+      proto.radius     = 8.0f;
+      proto.move_speed = 200.0f;
+      proto.color      = RED_VEC4;
+      projectile_set_parent(&proto, (Entity*)infector);
+      
+      Projectile_Range range = spawn_projectiles_batch(Projectile_Faction_Infector, bullet_count, proto);
+      projectile_range_fill_fan(range, entity_pos(infector), infector->radius*0.5f, 0.0f, angle_step);
     }
+    
+    ScriptChangeState(script, infector, Entity_State_Waiting);
   }
   
+  ScriptEnd(script);
+}
+
+void update_infector(Entity* entity) {
+  Game_State* gs = get_game_state();
+  
+  Infector* infector = (Infector*)entity;
+  
+  // projectile interaction 
+  if(entity_take_bullet_hits(infector, true, infector->radius*2.5f)) return;
+  
   // chain circle interaction
-  if(check_collision_vs_chain_circles(infector->pos, infector->radius)) {
-    PlaySound(gs->explosion_sound);
-    spawn_infected_chain_circle(infector->pos, 80.0f);
-    spawn_score_dot(infector->pos, false);
+  if(check_collision_vs_chain_circles(entity_pos(infector), infector->radius)) {
+    queue_sound(Game_Sound_Explosion);
+    queue_spawn_chain_circle(entity_pos(infector), 80.0f, true);
+    queue_spawn_score_dot(entity_pos(infector), false);
     remove_entity(infector);
     return;
   }
-   
-   
-  // FSM
-  switch(infector->state) {
-    case Entity_State_Initial: {
-      infector->pos = random_offscreen_pos(INFECTOR_RADIUS*4);
-      
-      f32 angle_to_center = vec2_angle(get_screen_center() - infector->pos);
-      f32 dir_angle = angle_to_center + random_f32(-1, 1)*(Pi32/6);
-      infector->dir = vec2(dir_angle);
-      
-      infector->radius = INFECTOR_RADIUS;
-      infector->move_speed = INFECTOR_MOVE_SPEED;
-      entity_set_hit_points(infector, INFECTOR_HIT_POITNS);
-      
-      entity_change_state(infector, Entity_State_Offscreen);
-    }break;
-    case Entity_State_Offscreen: {
-      if(entity_enter_state(infector)) infector->state_timer = timer_start(10.0f);
-      
-      // Move
-      Vec2 move_delta = infector->dir*infector->move_speed*delta_time;
-      infector->pos += move_delta;
-      
-      b32 on_screen = !is_circle_completely_offscreen(infector->pos, infector->radius);
-      if(on_screen) entity_change_state(infector, Entity_State_Waiting);
-      
-      if(timer_step(&infector->state_timer, delta_time)) remove_entity(infector);
-    }break;
-    case Entity_State_Waiting: {
-      if(entity_enter_state(infector)) {
-        infector->state_timer = timer_start(6.0f);
-      }
+  
+  if(script_should_resume(&infector->script, gs->sim_tick)) infector_script(infector);
+}
 
-      // Move
-      Vec2 move_delta = infector->dir*infector->move_speed*delta_time;
-      infector->pos += move_delta;
-      
-      if(timer_step(&infector->state_timer, delta_time)) {
-        entity_change_state(infector, Entity_State_Telegraphing);
-      }
-    }break;
-    case Entity_State_Telegraphing: {
-      if(entity_enter_state(infector)) {
-        infector->state_timer = timer_start(2.0f);
-      }
-      
-      f32 x = 2*Pi32*timer_procent(infector->state_timer);
-      f32 t = (cosf(x*8.0f + Pi32) + 1)/2.0f;
-      infector->wobble = t;
-      
-      if(timer_step(&infector->state_timer, delta_time)) {
-        f32 bullet_count = 6;
-        f32 angle_step = (2*Pi32)/bullet_count;
-        f32 angle = 0.0f;
-        Loop(i, bullet_count) {
-          Projectile* p = new_projectile();
-          p->pos = infector->pos + vec2(angle)*infector->radius*0.5f;
-          p->radius = 8.0f;
-          p->move_speed = 200.0f;
-          p->dir = vec2(angle);
-          p->rotation = angle;
-          p->color = RED_VEC4;
-          projectile_set_parent(p, (Entity*)infector);
-          
-          angle += angle_step;
-        }
-        
-        entity_change_state(infector, Entity_State_Waiting);
-      }
-    }break;
-  }
+void update_particle_range(void* data, s32 first, s32 end) {
+  Game_State* gs = get_game_state();
+  f32 delta_time = SIM_DELTA_TIME;
+  
+  kinematics_step(&gs->particle_kinematics, gs->active_particle_mask, first, end, delta_time, vec2(WINDOW_WIDTH, WINDOW_HEIGHT), NULL);
 }
 
 void update_particles(void) {
+  Game_State* gs = get_game_state();
+  parallel_for_bits(update_particle_range, NULL, gs->active_particle_mask, MAX_PARTICLES, PARALLEL_FOR_GRAIN);
+}
+
+void draw_particles(void) {
   Game_State* gs = get_game_state();
   f32 delta_time = GetFrameTime();
   
-  Loop(i, MAX_PARTICLES) {
+  LoopBits(i, gs->active_particle_mask, MAX_PARTICLES) {
     Particle* p = &gs->particles[i];
-    if(!p->is_active) continue;
-    
-    p->vel *= p->friction;
-    p->pos += p->vel*delta_time;
     
-    if(timer_step(&p->life_timer, delta_time)) remove_particle(p);
+    Vec2 pos = kinematics_pos(&gs->particle_kinematics, i);
+    Vec2 dim = vec2(2,2)*p->radius;
+    draw_quad(pos - dim*0.5f, dim, p->rotation, p->color);
   }
 }
 
-void draw_particles(void) {
+// Movement only touches the projectile itself, so this part runs in parallel. Life times
+// end through the timer wheel.
+void move_projectile_range(void* data, s32 first, s32 end) {
+  Projectile_Pool* pool = (Projectile_Pool*)data;
+  f32 delta_time = SIM_DELTA_TIME;
+  
+  kinematics_step(&pool->kinematics, pool->active_mask, first, end, delta_time, vec2(WINDOW_WIDTH, WINDOW_HEIGHT), pool->offscreen_mask);
+  
+  LoopBitsRange(i, pool->active_mask, first, end) {
+    if(bit_set_is_set(pool->offscreen_mask, i)) projectile_deactivate(pool, &pool->projectiles[i]);
+  }
+}
+
+// Enemy bullets against chain circles. The pairs come sorted by bullet and then circle, so
+// the hits go in the same order as a loop over the pools would do them and every bullet
+// goes to the first circle it touches.
+void apply_projectile_chain_circle_hits(void) {
   Game_State* gs = get_game_state();
-  f32 delta_time = GetFrameTime();
   
-  Loop(i, MAX_PARTICLES) {
-    Particle* p = &gs->particles[i];
-    if(!p->is_active) continue;
+  contact_pass_begin(Contact_Test_Swept_A, Contact_Report_First_B_Per_A);
+  for(s32 faction = Projectile_Faction_Player + 1; faction < Projectile_Faction_Count; faction++) {
+    Projectile_Pool* pool = get_projectile_pool((Projectile_Faction)faction);
     
-    Vec2 dim = vec2(2,2)*p->radius;
-    draw_quad(p->pos - dim*0.5f, dim, p->rotation, p->color);
+    LoopProjectiles(i, pool) {
+      Vec2 pos = kinematics_pos(&pool->kinematics, i);
+      contact_add_a((u32)(faction*MAX_PROJECTILES + i), pos - kinematics_last_move(&pool->kinematics, i), pos, pool->projectiles[i].radius);
+    }
+  }
+  LoopBits(i, gs->active_chain_circle_mask, MAX_CHAIN_CIRCLES) {
+    Chain_Circle* c = &gs->chain_circles[i];
+    contact_add_b((u32)i, c->pos, c->pos, c->radius);
+  }
+  
+  Contact_Pairs pairs = contact_pass_run();
+  Loop(k, pairs.count) {
+    u32 id = contact_a(pairs.keys[k]);
+    if(k > 0 && contact_a(pairs.keys[k - 1]) == id) continue;
+    
+    Projectile_Faction faction = (Projectile_Faction)(id/MAX_PROJECTILES);
+    Projectile_Pool* pool = get_projectile_pool(faction);
+    Projectile* p = &pool->projectiles[id%MAX_PROJECTILES];
+    sim_event_producer_begin(Sim_Event_Source_Projectile, id);
+    
+    if(faction == Projectile_Faction_Chain) {
+      Vec2 pos = projectile_pos(pool, p);
+      queue_spawn_chain_circle(pos, 25.0f);
+      queue_spawn_score_dot(pos, true);
+    }
+    else {
+      infect_chain_circle(&gs->chain_circles[contact_b(pairs.keys[k])]);
+    }
+    remove_projectile(pool, p);
   }
 }
 
+// Player bullets only interact with chain circles in update_chain_circles.
 void update_projectiles(void) {
-  Game_State* gs = get_game_state();
-  f32 delta_time = GetFrameTime();
+  f32 delta_time = SIM_DELTA_TIME;
   
-  Loop(i, MAX_PROJECTILES) {
-    Projectile* p = &gs->projectiles[i];
-    if(!p->is_active) continue;
+  apply_projectile_chain_circle_hits();
   
-                           
-    b32 got_hit = false;
-    Chain_Circle* hit_circle = NULL;
-    Loop(i, MAX_CHAIN_CIRCLES) {
-      Chain_Circle* c = &gs->chain_circles[i];
-      if(!c->is_active) continue;
-      
-      if(check_circle_vs_circle(p->pos, p->radius, c->pos, c->radius)) {
-        got_hit = true;
-        hit_circle = c;    
-        break;
-      }
+  Projectile_Pool* player_bullets = get_projectile_pool(Projectile_Faction_Player);
+  LoopProjectiles(i, player_bullets) {
+    Projectile* p = &player_bullets->projectiles[i];
+    
+    if(timer_step(&p->emit_timer, delta_time)) {
+      spawn_particle_trial(projectile_pos(player_bullets, p), -p->dir, 8, p->color);
+      timer_reset(&p->emit_timer);
     }
+  }
   
-    if(got_hit) {
-      b32 is_chain_bullet = (p->from_type == Entity_Type_Laser_Turret ||
-                             p->from_type == Entity_Type_Triple_Gun_Turret);  
-                           
-      if(is_chain_bullet) {
-        spawn_chain_circle(p->pos, 25.0f);
-        spawn_score_dot(p->pos, true);
-        remove_projectile(p);
-        continue;
+  Loop(faction, Projectile_Faction_Count) {
+    Projectile_Pool* pool = get_projectile_pool((Projectile_Faction)faction);
+    parallel_for_bits(move_projectile_range, pool, pool->active_mask, pool->capacity, PARALLEL_FOR_GRAIN);
+  }
+}
+
+
+void update_laser_beams(void) {
+  Game_State* gs = get_game_state();
+  
+  // Beams split off during this update shouldn't be updated again this frame.
+  u64 beam_mask[BIT_SET_WORD_COUNT(MAX_LASER_BEAMS)];
+  Loop(i, ArrayCount(beam_mask)) beam_mask[i] = gs->active_laser_beam_mask[i];
+  
+  if(bit_set_count(beam_mask, MAX_LASER_BEAMS) == 0) return;
+  
+  // The chain circles as arrays, every beam tests all of them in one capsule_vs_circles.
+  // Circles only spawn through the event queue, so these stay right for the whole update.
+  f32 circle_xs[MAX_CHAIN_CIRCLES];
+  f32 circle_ys[MAX_CHAIN_CIRCLES];
+  f32 circle_radii[MAX_CHAIN_CIRCLES];
+  s32 circle_indices[MAX_CHAIN_CIRCLES];
+  s32 circle_count = 0;
+  
+  LoopBits(j, gs->active_chain_circle_mask, MAX_CHAIN_CIRCLES) {
+    Chain_Circle* c = &gs->chain_circles[j];
+    if(c->radius <= 0.0f) continue;
+    
+    circle_xs[circle_count]      = c->pos.x;
+    circle_ys[circle_count]      = c->pos.y;
+    circle_radii[circle_count]   = c->radius;
+    circle_indices[circle_count] = (s32)j;
+    circle_count += 1;
+  }
+  
+  LoopBits(i, beam_mask, MAX_LASER_BEAMS) {
+    if(!bit_set_is_set(gs->active_laser_beam_mask, i)) continue;
+    Laser_Beam* b = &gs->laser_beams[i];
+    sim_event_producer_begin(Sim_Event_Source_Laser_Beam, i);
+    
+    u64 hit_mask[BIT_SET_WORD_COUNT(MAX_CHAIN_CIRCLES)];
+    laser_beam_vs_circles(b, circle_xs, circle_ys, circle_radii, circle_count, hit_mask);
+    
+    // Every segment a chain circle touches turns into a small chain circle. The new circles
+    // then eat their neighbours once they grow, so the reaction runs along the beam.
+    LoopBits(k, hit_mask, circle_count) {
+      Chain_Circle* c = &gs->chain_circles[circle_indices[k]];
+      
+      // Range of segments along the beam axis that overlap the circle.
+      Vec2 d = c->pos - b->origin;
+      f32 along = vec2_dot(d, b->dir);
+      f32 perp  = d.x*b->dir.y - d.y*b->dir.x;
+      f32 reach = c->radius + b->radius;
+      f32 half_chord = sqrtf(Max(reach*reach - perp*perp, 0.0f));
+      
+      s32 hit_first = Max(b->first_segment,   (s32)ceilf((along - half_chord)/b->segment_step));
+      s32 hit_last  = Min(b->end_segment - 1, (s32)floorf((along + half_chord)/b->segment_step));
+      if(hit_first > hit_last) continue;
+      
+      for(s32 segment = hit_first; segment <= hit_last; segment += 1) {
+        Vec2 pos = laser_beam_segment_pos(b, segment);
+        queue_spawn_chain_circle(pos, 25.0f);
+        queue_spawn_score_dot(pos, true);
       }
-      else if(p->from_type == Entity_Type_Infector) {
-        infect_chain_circle(hit_circle);
-        remove_projectile(p);
-        continue;
+      
+      // Whatever is left after the burnt part continues as its own beam.
+      Laser_Beam left  = *b;
+      Laser_Beam right = *b;
+      left.end_segment    = hit_first;
+      right.first_segment = hit_last + 1;
+      
+      b32 has_left  = left.first_segment  < left.end_segment;
+      b32 has_right = right.first_segment < right.end_segment;
+      
+      if(has_left && has_right) {
+        *b = left;
+        Laser_Beam* rest = new_laser_beam();
+        *rest = right;
+        laser_beam_schedule_expiry(rest);
       }
-    }
-        
-    if(p->from_type == Entity_Type_Player) {
-      if(timer_step(&p->emit_timer, delta_time)) {
-        spawn_particle_trial(p->pos, -p->dir, 8, p->color);
-        timer_reset(&p->emit_timer);
+      else if(has_left)  *b = left;
+      else if(has_right) *b = right;
+      else {
+        remove_laser_beam(b);
+        break;
       }
+      
+      // The circles after this one go against what's left of the beam.
+      laser_beam_vs_circles(b, circle_xs, circle_ys, circle_radii, circle_count, hit_mask);
     }
-    
-    Vec2 vel = p->dir*p->move_speed;
-    Vec2 move_delta = vel*delta_time;
-    p->pos += move_delta;
-    
-    if(p->has_life_time && timer_step(&p->life_timer, delta_time)) {
-      remove_projectile(p);
-      continue;
-    }
-    
-    if(is_circle_completely_offscreen(p->pos, p->radius)) remove_projectile(p);
   }
 }
 
-
 void spawn_goon_formation(char* formation, s32 formation_width, s32 formation_height) {
 
   // Find leader position
@@ -1578,7 +2367,7 @@ void spawn_goon_formation(char* formation, s32 formation_width, s32 formation_he
   
   Goon* leader = (Goon*)new_entity(Entity_Type_Goon);
   
-  leader->pos        = leader_pos;
+  entity_place(leader, leader_pos);
   leader->dir        = vec2(dir_angle);
   leader->rotation   = dir_angle;
   leader->radius     = GOON_LEADER_RADIUS;
@@ -1586,13 +2375,12 @@ void spawn_goon_formation(char* formation, s32 formation_width, s32 formation_he
   leader->move_speed = GOON_MOVE_SPEED;
   entity_set_hit_points(leader, hit_points);
 
+  vec2_rotate_points(goon_local_positions, goon_local_positions, goon_count, dir_angle);
+  
   Loop(i, goon_count) {
-    //f32 perp_dir_angle = dir_angle;
-    Vec2 local_pos = vec2_rotate(goon_local_positions[i], dir_angle);
-    
     Goon* g = (Goon*)new_entity(Entity_Type_Goon);
     
-    g->pos        = leader->pos + local_pos;
+    entity_place(g, leader_pos + goon_local_positions[i]);
     g->dir        = leader->dir;
     g->rotation   = dir_angle;
     g->radius     = GOON_RADIUS;
@@ -1615,7 +2403,7 @@ void spawn_goon_column() {
 
 void update_explosion_polygon() {
   Game_State* gs = get_game_state();
-  f32 delta_time = GetFrameTime();
+  f32 delta_time = SIM_DELTA_TIME;
 
   s32 ep_count = ArrayCount(gs->explosion_polygons);
   
@@ -1645,29 +2433,16 @@ void draw_explosion_polygon(Vec2 pos, f32 scale, f32 rot) {
   draw_polygon(poly, pos, scale*0.5f, rot, inner_color);
 }
 
-void update_explosions() {
-  Game_State* gs = get_game_state();
-  f32 delta_time = GetFrameTime();
-  
-  Loop(i, MAX_EXPLOSIONS) {
-    Explosion* e = &gs->explosions[i];
-    if(!e->is_active) continue;
-    
-    if(timer_step(&e->timer, delta_time)) e->is_active = false;
-  }
-}
-
-void update_chain_circles() {
+// Growing and the infection progress only touch the circle itself.
+void grow_chain_circle_range(void* data, s32 first, s32 end) {
   Game_State* gs = get_game_state();
-  f32 delta_time = GetFrameTime();
+  f32 delta_time = SIM_DELTA_TIME;
   
-  // update chain circles
-  Loop(i, MAX_CHAIN_CIRCLES) {
+  LoopBitsRange(i, gs->active_chain_circle_mask, first, end) {
     Chain_Circle* c = &gs->chain_circles[i];
-    if(!c->is_active) continue;
 
-    b32 emerged = c->emerge_time > CHAIN_CIRCLE_EMERGE_TIME;
-    if(!emerged) {
+    c->has_emerged = c->emerge_time > CHAIN_CIRCLE_EMERGE_TIME;
+    if(!c->has_emerged) {
       f32 t = c->emerge_time/CHAIN_CIRCLE_EMERGE_TIME;
       c->radius = c->target_radius*t*t;
 
@@ -1679,36 +2454,17 @@ void update_chain_circles() {
     f32 t = lerp_speed*delta_time;
     c->radius = lerp_f32(c->radius, c->target_radius, t);
     
-    Loop(i, MAX_PROJECTILES) {
-      Projectile* p = &gs->projectiles[i];
-      if(!p->is_active) continue;
-      if(p->from_type != Entity_Type_Player) continue;
-      
-      if(check_circle_vs_circle(c->pos, c->radius, p->pos, p->radius)) {
-        c->life_prolong_time = CHAIN_CIRCLE_LIFE_PROLONG_TIME;
-        c->target_radius += 3.0f;
-        remove_projectile(p);
-        break;
-      }
-    }
-    
-    if(c->is_infected) {
-      timer_step(&c->infection_timer, delta_time);
-      c->infection = timer_procent(c->infection_timer);
-      
-      if(c->infection == 1.0f) {
-        Loop(j, MAX_CHAIN_CIRCLES) {
-          Chain_Circle* cc = &gs->chain_circles[j];
-          if(j == i) continue;
-          if(!cc->is_active) continue;
-          if(cc->is_infected) continue;
-          
-          if(check_circle_vs_circle(c->pos, c->radius*c->infection, cc->pos, cc->radius)) {
-            infect_chain_circle(cc);
-          }
-        }
-      }
-    }
+    if(c->is_infected) c->infection = timer_procent(c->infection_timer);
+  }
+}
+
+void age_chain_circle_range(void* data, s32 first, s32 end) {
+  Game_State* gs = get_game_state();
+  f32 delta_time = SIM_DELTA_TIME;
+  
+  LoopBitsRange(i, gs->active_chain_circle_mask, first, end) {
+    Chain_Circle* c = &gs->chain_circles[i];
+    if(!c->has_emerged) continue;
     
     f32 life_advance = delta_time;
     if(c->life_prolong_time > 0.0f) {
@@ -1721,13 +2477,94 @@ void update_chain_circles() {
   }
 }
 
-void update_score_dots() {
+// Bullets and the infection spreading reach into other objects and stay on this thread,
+// in between the two parallel passes.
+void update_chain_circles() {
   Game_State* gs = get_game_state();
-  f32 delta_time = GetFrameTime();
   
-  Loop(i, MAX_SCORE_DOTS) {
+  parallel_for_bits(grow_chain_circle_range, NULL, gs->active_chain_circle_mask, MAX_CHAIN_CIRCLES, PARALLEL_FOR_GRAIN);
+  
+  // Player bullets feed the circles they hit. A bullet goes to the first circle on its path
+  // this tick, by time of impact, that no bullet before it has fed yet. A fast bullet that
+  // crosses a few circles in one tick feeds the one it reaches first.
+  Projectile_Pool* player_bullets = get_projectile_pool(Projectile_Faction_Player);
+  
+  contact_pass_begin(Contact_Test_Swept_A, Contact_Report_All);
+  LoopProjectiles(i, player_bullets) {
+    Vec2 pos = kinematics_pos(&player_bullets->kinematics, i);
+    contact_add_a((u32)i, pos - kinematics_last_move(&player_bullets->kinematics, i), pos, player_bullets->projectiles[i].radius);
+  }
+  LoopBits(i, gs->active_chain_circle_mask, MAX_CHAIN_CIRCLES) {
+    Chain_Circle* c = &gs->chain_circles[i];
+    if(c->has_emerged) contact_add_b((u32)i, c->pos, c->pos, c->radius);
+  }
+  
+  u64 fed_mask[BIT_SET_WORD_COUNT(MAX_CHAIN_CIRCLES)];
+  bit_set_clear(fed_mask, MAX_CHAIN_CIRCLES);
+  
+  Contact_Pairs pairs = contact_pass_run();
+  for(s32 k = 0; k < pairs.count;) {
+    u32 bullet = contact_a(pairs.keys[k]);
+    
+    // the circles this bullet touches that are still hungry
+    u32 circles[MAX_CHAIN_CIRCLES];
+    f32 xs[MAX_CHAIN_CIRCLES], ys[MAX_CHAIN_CIRCLES], radii[MAX_CHAIN_CIRCLES];
+    s32 count = 0;
+    for(; k < pairs.count && contact_a(pairs.keys[k]) == bullet; k++) {
+      u32 circle = contact_b(pairs.keys[k]);
+      if(bit_set_is_set(fed_mask, circle)) continue;
+      
+      Chain_Circle* c = &gs->chain_circles[circle];
+      circles[count] = circle;
+      xs[count] = c->pos.x;
+      ys[count] = c->pos.y;
+      radii[count] = c->radius;
+      count += 1;
+    }
+    if(!count) continue;
+    
+    u64 hit_mask[BIT_SET_WORD_COUNT(MAX_CHAIN_CIRCLES)];
+    f32 tois[MAX_CHAIN_CIRCLES];
+    Vec2 end = kinematics_pos(&player_bullets->kinematics, bullet);
+    Vec2 start = end - kinematics_last_move(&player_bullets->kinematics, bullet);
+    swept_circle_vs_circles(start, end, player_bullets->projectiles[bullet].radius, xs, ys, radii, count, hit_mask, tois);
+    
+    // ties go to the lower circle id, the candidates are sorted by it
+    s32 first = -1;
+    LoopBits(i, hit_mask, count) {
+      if(first < 0 || tois[i] < tois[first]) first = (s32)i;
+    }
+    if(first < 0) continue;
+    
+    Chain_Circle* c = &gs->chain_circles[circles[first]];
+    c->life_prolong_time = CHAIN_CIRCLE_LIFE_PROLONG_TIME;
+    c->target_radius += 3.0f;
+    remove_projectile(player_bullets, &player_bullets->projectiles[bullet]);
+    bit_set_set(fed_mask, circles[first]);
+  }
+  
+  // Fully infected circles infect every clean circle they touch. Infecting twice does
+  // nothing, so the order doesn't matter here and one infector per clean circle is enough.
+  contact_pass_begin(Contact_Test_Circles, Contact_Report_Any_A_Per_B);
+  LoopBits(i, gs->active_chain_circle_mask, MAX_CHAIN_CIRCLES) {
+    Chain_Circle* c = &gs->chain_circles[i];
+    
+    if(!c->is_infected)                               contact_add_b((u32)i, c->pos, c->pos, c->radius);
+    else if(c->has_emerged && c->infection == 1.0f)   contact_add_a((u32)i, c->pos, c->pos, c->radius*c->infection);
+  }
+  
+  pairs = contact_pass_run();
+  Loop(k, pairs.count) infect_chain_circle(&gs->chain_circles[contact_b(pairs.keys[k])]);
+  
+  parallel_for_bits(age_chain_circle_range, NULL, gs->active_chain_circle_mask, MAX_CHAIN_CIRCLES, PARALLEL_FOR_GRAIN);
+}
+
+void update_score_dot_range(void* data, s32 first, s32 end) {
+  Game_State* gs = get_game_state();
+  f32 delta_time = SIM_DELTA_TIME;
+  
+  LoopBitsRange(i, gs->active_score_dot_mask, first, end) {
     Score_Dot* dot = &gs->score_dots[i];
-    if(!dot->is_active) continue;
      
     f32 pulse_target_time = 1.0f/SCORE_DOT_PULSE_FREQ;
     dot->pulse_time += delta_time;
@@ -1745,43 +2582,100 @@ void update_score_dots() {
   }
 }
 
+void update_score_dots() {
+  Game_State* gs = get_game_state();
+  parallel_for_bits(update_score_dot_range, NULL, gs->active_score_dot_mask, MAX_SCORE_DOTS, PARALLEL_FOR_GRAIN);
+}
+
+
+// A run of entities that share type and state.
+struct Entity_Bucket_Run {
+  Entity_Type type;
+  s32 first;
+  s32 count;
+};
 
+// Entities are updated bucket by bucket, so each inner loop sees one type and one state
+// and the state switch inside update_* goes the same way for the whole run.
 void update_entities(void) {
   Game_State* gs = get_game_state();
   
-  // update entities
-  Loop(i, gs->entity_count) {
-    Entity* entity = &gs->entities[i];
-    switch(entity->type) {
-      case Entity_Type_Player:            { update_player(entity);            } break;
-      case Entity_Type_Laser_Turret:      { update_laser_turret(entity);      } break;
-      case Entity_Type_Triple_Gun_Turret: { update_triple_gun_turret(entity); } break;
-      case Entity_Type_Goon:              { update_goon(entity);              } break;
-      case Entity_Type_Chain_Activator:   { update_chain_activator(entity);   } break;
-      case Entity_Type_Infector:          { update_infector(entity);          } break;
+  take_entity_snapshots();
+  
+  // Snapshot the buckets up front, an entity that changes state this tick must not be
+  // picked up again by the bucket it moved into.
+  Entity_Index order[MAX_ENTITIES];
+  Entity_Bucket_Run runs[ENTITY_TYPE_SLOT_COUNT*Entity_State_Count];
+  s32 order_count = 0;
+  s32 run_count = 0;
+  
+  Loop(slot, ENTITY_TYPE_SLOT_COUNT) {
+    Loop(state, Entity_State_Count) {
+      s32 count = gs->entity_count_by_state[slot][state];
+      if(count == 0) continue;
+      
+      Entity_Bucket_Run* run = &runs[run_count++];
+      run->type  = (Entity_Type)(1 << slot);
+      run->first = order_count;
+      run->count = count;
+      
+      Loop(i, count) order[order_count++] = gs->entities_by_state[slot][state][i];
+    }
+  }
+  
+  Loop(r, run_count) {
+    Entity_Bucket_Run run = runs[r];
+    Entity_Index* at = &order[run.first];
+    
+    switch(run.type) {
+#define X(type, struct_name, update_proc, draw_proc) \
+      case type: {                                                                        \
+        Loop(i, run.count) {                                                              \
+          sim_event_producer_begin(Sim_Event_Source_Entity, run.first + i);               \
+          update_proc(&gs->entities[at[i].value]);                                        \
+        }                                                                                 \
+      } break;
+      
+      ENTITY_TYPE_TABLE(X)
+#undef X
+      
+      default: Assert(!"Entity type missing from ENTITY_TYPE_TABLE");
     }
   }
 }
 
-void count_active_game_objects(void) {
+// One step for every entity with the velocity it set while updating. The player stays on
+// the screen.
+void move_entities(void) {
   Game_State* gs = get_game_state();
-    
-  gs->active_projectile_count   = 0;
-  gs->active_chain_circle_count = 0;
-  gs->active_score_dot_count    = 0;
-  gs->active_explosion_count    = 0;
   
-  Loop(i, MAX_PROJECTILES)   
-    gs->active_projectile_count += gs->projectiles[i].is_active;
+  u64 live_mask[BIT_SET_WORD_COUNT(MAX_ENTITIES)] = {};
+  Loop(i, gs->entity_count) bit_set_set(live_mask, i);
   
-  Loop(i, MAX_CHAIN_CIRCLES) 
-    gs->active_chain_circle_count += gs->chain_circles[i].is_active;
+  s32 end = (gs->entity_count + 63)/64*64;
+  kinematics_step(&gs->entity_kinematics, live_mask, 0, end, SIM_DELTA_TIME, vec2(WINDOW_WIDTH, WINDOW_HEIGHT), NULL);
   
-  Loop(i, MAX_SCORE_DOTS) 
-    gs->active_score_dot_count += gs->score_dots[i].is_active;
+  LoopEntitiesOfType(i, Entity_Type_Player) {
+    Player* player = &get_entity_of_type(Entity_Type_Player, i)->player;
+    
+    Vec2 pos = entity_pos(player);
+    pos.x = Clamp(pos.x, 0.0f, (f32)WINDOW_WIDTH);
+    pos.y = Clamp(pos.y, 0.0f, (f32)WINDOW_HEIGHT);
+    entity_place(player, pos);
+  }
+}
+
+void count_active_game_objects(void) {
+  Game_State* gs = get_game_state();
     
-  Loop(i, MAX_EXPLOSIONS)
-     gs->active_explosion_count += gs->explosions[i].is_active;
+  gs->active_projectile_count = 0;
+  Loop(faction, Projectile_Faction_Count) {
+    Projectile_Pool* pool = &gs->projectile_pools[faction];
+    gs->active_projectile_count += bit_set_count(pool->active_mask, pool->capacity);
+  }
+  gs->active_chain_circle_count = bit_set_count(gs->active_chain_circle_mask, MAX_CHAIN_CIRCLES);
+  gs->active_score_dot_count    = bit_set_count(gs->active_score_dot_mask,    MAX_SCORE_DOTS);
+  gs->active_explosion_count    = bit_set_count(gs->active_explosion_mask,    MAX_EXPLOSIONS);
 }
 
 void pause_audio() {
@@ -1830,7 +2724,7 @@ void update_audio() {
 
 void update_level() {
   Game_State* gs = get_game_state();
-  f32 delta_time = GetFrameTime();
+  f32 delta_time = SIM_DELTA_TIME;
   
   gs->level_time_passed += delta_time;
   f32 level_completion = gs->level_time_passed/gs->level_duration;
@@ -2025,11 +2919,38 @@ void set_level_to_initial_state() {
   
   Loop(i, gs->entity_count) gs->entities[i].base.is_active = false;
   gs->entity_count = 0;
+  Loop(i, ENTITY_TYPE_SLOT_COUNT) {
+    gs->entity_count_by_type[i] = 0;
+    Loop(state, Entity_State_Count) gs->entity_count_by_state[i][state] = 0;
+  }
   
-  Loop(i, MAX_PROJECTILES)   gs->projectiles[i].is_active   = false;
-  Loop(i, MAX_CHAIN_CIRCLES) gs->chain_circles[i].is_active = false;
-  Loop(i, MAX_EXPLOSIONS)    gs->explosions[i].is_active    = false;
-  Loop(i, MAX_SCORE_DOTS)    gs->score_dots[i].is_active    = false;
+  Loop(faction, Projectile_Faction_Count) {
+    Projectile_Pool* pool = &gs->projectile_pools[faction];
+    bit_set_clear(pool->active_mask, pool->capacity);
+  }
+  bit_set_clear(gs->active_laser_beam_mask,   MAX_LASER_BEAMS);
+  bit_set_clear(gs->active_chain_circle_mask, MAX_CHAIN_CIRCLES);
+  bit_set_clear(gs->active_explosion_mask,    MAX_EXPLOSIONS);
+  bit_set_clear(gs->active_score_dot_mask,    MAX_SCORE_DOTS);
+  bit_set_clear(gs->active_particle_mask,     MAX_PARTICLES);
+  
+  Loop(faction, Projectile_Faction_Count) gs->projectile_pools[faction].next_index = 0;
+  gs->next_laser_beam_index   = 0;
+  gs->next_chain_circle_index = 0;
+  gs->next_explosion_index    = 0;
+  gs->next_score_dot_index    = 0;
+  gs->next_particle_index     = 0;
+  
+  // A replayed level starts on tick 0 and its own seed, see game_replay.cpp.
+  if(replay_is_active()) {
+    random_begin(replay_begin_level(random_u32(), gs->level_played_times));
+    gs->sim_tick = 0;
+    timer_clock_set_tick(gs->sim_tick);
+    timer_reset(&gs->explosion_timer);
+    gs->show_game_controls_timer = {};
+  }
+  timing_wheel_clear(&gs->timer_wheel, gs->sim_tick);
+  snapshot_ring_clear(&gs->snapshots);
   
   f32 level_silence_time = 15.0f;
   gs->level_duration = GetMusicTimeLength(gs->songs[0]) + GetMusicTimeLength(gs->songs[1]) + level_silence_time;
@@ -2045,9 +2966,10 @@ void set_level_to_initial_state() {
   gs->got_high_score = false;
   
   gs->are_spawn_timers_init = false;  
+  gs->sim_time_accumulator = 0.0f;
   
   Player* player = (Player*)new_entity(Entity_Type_Player);
-  player->pos = get_screen_center();
+  entity_place(player, get_screen_center());
   player->radius = PLAYER_RADIUS;
   player->shoot_cooldown_timer = timer_start(PLAYER_SHOOT_COOLDOWN);
   entity_set_hit_points(player, PLAYER_HIT_POINTS);
@@ -2060,7 +2982,7 @@ void set_level_to_initial_state() {
       Chain_Activator* activator = (Chain_Activator*)new_entity(Entity_Type_Chain_Activator);
       activator->for_tutorial_purposes = true;
       activator->text_line = chain_activator_line0;
-      activator->pos = {WINDOW_WIDTH/2, -CHAIN_ACTIVATOR_START_RADIUS*5};
+      entity_place(activator, {WINDOW_WIDTH/2, -CHAIN_ACTIVATOR_START_RADIUS*5});
       activator->dir = {0, 1};
     };
     
@@ -2068,7 +2990,7 @@ void set_level_to_initial_state() {
       Chain_Activator* activator = (Chain_Activator*)new_entity(Entity_Type_Chain_Activator);
       activator->for_tutorial_purposes = true;
       activator->text_line = chain_activator_line0;
-      activator->pos = {-CHAIN_ACTIVATOR_START_RADIUS*12, WINDOW_HEIGHT/2};
+      entity_place(activator, {-CHAIN_ACTIVATOR_START_RADIUS*12, WINDOW_HEIGHT/2});
       activator->dir = {1, 0};
     };
     
@@ -2077,7 +2999,7 @@ void set_level_to_initial_state() {
       Chain_Activator* activator = (Chain_Activator*)new_entity(Entity_Type_Chain_Activator);
       activator->for_tutorial_purposes = true;
       activator->text_line = chain_activator_line1;
-      activator->pos = {WINDOW_WIDTH + CHAIN_ACTIVATOR_START_RADIUS*22, WINDOW_HEIGHT/2};
+      entity_place(activator, {WINDOW_WIDTH + CHAIN_ACTIVATOR_START_RADIUS*22, WINDOW_HEIGHT/2});
       activator->dir = {-1, 0};
     };
     
@@ -2085,7 +3007,7 @@ void set_level_to_initial_state() {
       Chain_Activator* activator = (Chain_Activator*)new_entity(Entity_Type_Chain_Activator);
       activator->for_tutorial_purposes = true;
       activator->text_line = chain_activator_line1;
-      activator->pos = {WINDOW_WIDTH/2, WINDOW_HEIGHT + CHAIN_ACTIVATOR_START_RADIUS*22};
+      entity_place(activator, {WINDOW_WIDTH/2, WINDOW_HEIGHT + CHAIN_ACTIVATOR_START_RADIUS*22});
       activator->dir = {0, -1};
     };
     
@@ -2094,7 +3016,7 @@ void set_level_to_initial_state() {
       Chain_Activator* activator = (Chain_Activator*)new_entity(Entity_Type_Chain_Activator);
       activator->for_tutorial_purposes = true;
       activator->text_line = chain_activator_line2;
-      activator->pos = {WINDOW_WIDTH/2, -CHAIN_ACTIVATOR_START_RADIUS*35};
+      entity_place(activator, {WINDOW_WIDTH/2, -CHAIN_ACTIVATOR_START_RADIUS*35});
       activator->dir = {0, 1};
     };
     
@@ -2102,7 +3024,7 @@ void set_level_to_initial_state() {
       Chain_Activator* activator = (Chain_Activator*)new_entity(Entity_Type_Chain_Activator);
       activator->for_tutorial_purposes = true;
       activator->text_line = chain_activator_line2;
-      activator->pos = {-CHAIN_ACTIVATOR_START_RADIUS*40, WINDOW_HEIGHT/2};
+      entity_place(activator, {-CHAIN_ACTIVATOR_START_RADIUS*40, WINDOW_HEIGHT/2});
       activator->dir = {1, 0};
     };
     
@@ -2110,7 +3032,7 @@ void set_level_to_initial_state() {
       Chain_Activator* activator = (Chain_Activator*)new_entity(Entity_Type_Chain_Activator);
       activator->for_tutorial_purposes = true;
       activator->text_line = chain_activator_line2;
-      activator->pos = {WINDOW_WIDTH + CHAIN_ACTIVATOR_START_RADIUS*40, WINDOW_HEIGHT/2};
+      entity_place(activator, {WINDOW_WIDTH + CHAIN_ACTIVATOR_START_RADIUS*40, WINDOW_HEIGHT/2});
       activator->dir = {-1, 0};
     };
     
@@ -2118,7 +3040,7 @@ void set_level_to_initial_state() {
       Chain_Activator* activator = (Chain_Activator*)new_entity(Entity_Type_Chain_Activator);
       activator->for_tutorial_purposes = true;
       activator->text_line = chain_activator_line2;
-      activator->pos = {WINDOW_WIDTH/2, WINDOW_HEIGHT + CHAIN_ACTIVATOR_START_RADIUS*35};
+      entity_place(activator, {WINDOW_WIDTH/2, WINDOW_HEIGHT + CHAIN_ACTIVATOR_START_RADIUS*35});
       activator->dir = {0, -1};
     };
   }
@@ -2134,21 +3056,387 @@ void update_game(void) {
   
   update_explosion_polygon();
   
+  process_timer_events();
+  
+  sim_event_producer_begin(Sim_Event_Source_None, 0);
   update_entities();  
-  actually_remove_entities();
+  move_entities();
+  
+  // entity interactions land before the other systems look at bullets and circles
+  drain_sim_events();
   
   update_score_dots();
   update_particles();
   update_projectiles();
-  update_explosions();
+  update_laser_beams();
   update_chain_circles();
   
+  // entities killed by queued damage are removed along with the rest
+  drain_sim_events();
+  actually_remove_entities();
+  
   count_active_game_objects();
   
   f64 end_time = GetTime();
   gs->update_time = end_time - start_time;
 }
 
+Sim_Input sample_sim_input(void) {
+  Sim_Input r = {};
+  r.move_dir  = player_process_input_lhs();
+  r.shoot_dir = player_process_input_rhs();
+  return r;
+}
+
+//
+// State sections
+//
+// What replays hash and diff, see game_replay.cpp: everything the next ticks depend on,
+// nothing that is only drawn.
+//
+
+enum State_Section_Type {
+  State_Section_Level,
+  State_Section_Random,
+  State_Section_Entities,
+  State_Section_Projectiles,
+  State_Section_Chain_Circles,
+  State_Section_Score_Dots,
+  State_Section_Laser_Beams,
+  State_Section_Timer_Wheel,
+  
+  State_Section_Count
+};
+
+#if GAME_DETERMINISTIC
+#define State_Field_Kinematics State_Field_S32
+#else
+#define State_Field_Kinematics State_Field_F32
+#endif
+
+State_Field level_state_fields[] = {
+  {"sim_tick", State_Field_U32}, {"score", State_Field_S32}, {"level_time_passed", State_Field_F32},
+  {"entity_count", State_Field_S32}, {"are_spawn_timers_init", State_Field_S32},
+  {"spawn_timer.goon.end_tick", State_Field_U32}, {"spawn_timer.laser_turret.end_tick", State_Field_U32},
+  {"spawn_timer.triple_turret.end_tick", State_Field_U32}, {"spawn_timer.activator.end_tick", State_Field_U32},
+  {"spawn_timer.infector.end_tick", State_Field_U32}, {"timer_wheel.now", State_Field_U32},
+  {"level_played_times", State_Field_S32},
+  {"projectile_pools[player].next_index", State_Field_S32}, {"projectile_pools[chain].next_index", State_Field_S32},
+  {"projectile_pools[infector].next_index", State_Field_S32},
+  {"next_laser_beam_index", State_Field_S32}, {"next_chain_circle_index", State_Field_S32},
+  {"next_explosion_index", State_Field_S32}, {"next_score_dot_index", State_Field_S32},
+};
+
+State_Field random_state_fields[] = {
+  {"gameplay.s[0]", State_Field_U32}, {"gameplay.s[1]", State_Field_U32},
+  {"gameplay.s[2]", State_Field_U32}, {"gameplay.s[3]", State_Field_U32},
+  {"key.lo", State_Field_U32}, {"key.hi", State_Field_U32},
+};
+
+State_Field entity_state_fields[] = {
+  {"index", State_Field_S32}, {"type", State_Field_U32}, {"state", State_Field_S32},
+  {"x", State_Field_Kinematics}, {"y", State_Field_Kinematics}, {"dir.x", State_Field_F32}, {"dir.y", State_Field_F32},
+  {"vx", State_Field_Kinematics}, {"vy", State_Field_Kinematics}, {"rotation", State_Field_F32}, {"radius", State_Field_F32},
+  {"hit_points", State_Field_S32}, {"has_entered_state", State_Field_S32}, {"state_timer.end_tick", State_Field_U32},
+  {"script.resume_point", State_Field_S32}, {"script.wake_tick", State_Field_U32}, {"is_active", State_Field_S32},
+  
+  // the fields of the types, zero on entities of the other types
+  {"player.shoot_cooldown_timer.start_tick", State_Field_U32}, {"player.shoot_cooldown_timer.end_tick", State_Field_U32},
+  {"player.shoot_indicator_timer.end_tick", State_Field_U32},
+  {"player.wobble_timer.start_tick", State_Field_U32}, {"player.wobble_timer.end_tick", State_Field_U32},
+  {"player.wobble", State_Field_F32}, {"player.turn_angle", State_Field_F32}, {"player.target_turn_angle", State_Field_F32},
+  {"laser_turret.shoot_angle", State_Field_F32}, {"laser_turret.blinked_count", State_Field_S32},
+  {"triple_gun_turret.projectiles_left_to_spawn", State_Field_S32},
+  {"chain_activator.start_radius", State_Field_F32}, {"chain_activator.end_radius", State_Field_F32},
+  {"chain_activator.orbital_global_rotation", State_Field_F32},
+  {"chain_activator.orbitals[0].time", State_Field_F32}, {"chain_activator.orbitals[1].time", State_Field_F32},
+  {"chain_activator.orbitals[2].time", State_Field_F32}, {"chain_activator.orbitals[3].time", State_Field_F32},
+  {"chain_activator.orbitals[4].time", State_Field_F32},
+  {"chain_activator.orbitals[0].active", State_Field_F32}, {"chain_activator.orbitals[1].active", State_Field_F32},
+  {"chain_activator.orbitals[2].active", State_Field_F32}, {"chain_activator.orbitals[3].active", State_Field_F32},
+  {"chain_activator.orbitals[4].active", State_Field_F32},
+  {"infector.wobble", State_Field_F32},
+};
+
+State_Field projectile_state_fields[] = {
+  {"faction", State_Field_S32}, {"slot", State_Field_S32},
+  {"x", State_Field_Kinematics}, {"y", State_Field_Kinematics}, {"vx", State_Field_Kinematics}, {"vy", State_Field_Kinematics},
+  {"dir.x", State_Field_F32}, {"dir.y", State_Field_F32}, {"move_speed", State_Field_F32}, {"radius", State_Field_F32},
+  {"emit_timer.start_tick", State_Field_U32}, {"emit_timer.end_tick", State_Field_U32}, {"from_type", State_Field_U32},
+};
+
+State_Field chain_circle_state_fields[] = {
+  {"slot", State_Field_S32}, {"pos.x", State_Field_F32}, {"pos.y", State_Field_F32},
+  {"radius", State_Field_F32}, {"target_radius", State_Field_F32}, {"emerge_time", State_Field_F32},
+  {"has_emerged", State_Field_S32}, {"life_time", State_Field_F32}, {"life_prolong_time", State_Field_F32},
+  {"is_infected", State_Field_S32}, {"infection_timer.start_tick", State_Field_U32}, {"infection_timer.end_tick", State_Field_U32},
+  {"infection", State_Field_F32},
+};
+
+State_Field score_dot_state_fields[] = {
+  {"slot", State_Field_S32}, {"pos.x", State_Field_F32}, {"pos.y", State_Field_F32},
+  {"is_special", State_Field_S32}, {"life_time", State_Field_F32},
+};
+
+State_Field laser_beam_state_fields[] = {
+  {"slot", State_Field_S32}, {"origin.x", State_Field_F32}, {"origin.y", State_Field_F32},
+  {"dir.x", State_Field_F32}, {"dir.y", State_Field_F32},
+  {"first_segment", State_Field_S32}, {"end_segment", State_Field_S32},
+};
+
+// The pending timers in the order they fire, particles left out as they're only drawn.
+State_Field timer_wheel_state_fields[] = {
+  {"list", State_Field_S32}, {"expire_tick", State_Field_U32}, {"payload", State_Field_U32},
+};
+
+global_var State_Section global_state_sections[State_Section_Count];
+
+void state_sections_init(Allocator* allocator) {
+  State_Section* s = global_state_sections;
+  s32 projectile_capacity = MAX_PLAYER_PROJECTILES + MAX_CHAIN_PROJECTILES + MAX_INFECTOR_PROJECTILES;
+  
+  state_section_init(&s[State_Section_Level],         allocator, "level",         level_state_fields,        ArrayCount(level_state_fields),        1);
+  state_section_init(&s[State_Section_Random],        allocator, "random",        random_state_fields,       ArrayCount(random_state_fields),       1);
+  state_section_init(&s[State_Section_Entities],      allocator, "entities",      entity_state_fields,       ArrayCount(entity_state_fields),       MAX_ENTITIES);
+  state_section_init(&s[State_Section_Projectiles],   allocator, "projectiles",   projectile_state_fields,   ArrayCount(projectile_state_fields),   projectile_capacity);
+  state_section_init(&s[State_Section_Chain_Circles], allocator, "chain_circles", chain_circle_state_fields, ArrayCount(chain_circle_state_fields), MAX_CHAIN_CIRCLES);
+  state_section_init(&s[State_Section_Score_Dots],    allocator, "score_dots",    score_dot_state_fields,    ArrayCount(score_dot_state_fields),    MAX_SCORE_DOTS);
+  state_section_init(&s[State_Section_Laser_Beams],   allocator, "laser_beams",   laser_beam_state_fields,   ArrayCount(laser_beam_state_fields),   MAX_LASER_BEAMS);
+  state_section_init(&s[State_Section_Timer_Wheel],   allocator, "timer_wheel",   timer_wheel_state_fields,  ArrayCount(timer_wheel_state_fields),  MAX_TIMER_WHEEL_NODES);
+}
+
+// The per type part of an entity's record, see entity_state_fields.
+void write_entity_type_state(State_Section* section, Entity* entity) {
+  Player            player            = {};
+  Laser_Turret      laser_turret      = {};
+  Triple_Gun_Turret triple_gun_turret = {};
+  Chain_Activator   chain_activator   = {};
+  Infector          infector          = {};
+  
+  switch(entity->base.type) {
+    case Entity_Type_Player:            { player            = entity->player;            } break;
+    case Entity_Type_Laser_Turret:      { laser_turret      = entity->laser_turret;      } break;
+    case Entity_Type_Triple_Gun_Turret: { triple_gun_turret = entity->triple_gun_turret; } break;
+    case Entity_Type_Chain_Activator:   { chain_activator   = entity->chain_activator;   } break;
+    case Entity_Type_Infector:          { infector          = *(Infector*)entity;        } break;
+    default: break;
+  }
+  
+  state_put(section, player.shoot_cooldown_timer.start_tick);
+  state_put(section, player.shoot_cooldown_timer.end_tick);
+  state_put(section, player.shoot_indicator_timer.end_tick);
+  state_put(section, player.wobble_timer.start_tick);
+  state_put(section, player.wobble_timer.end_tick);
+  state_put(section, player.wobble);
+  state_put(section, player.turn_angle);
+  state_put(section, player.target_turn_angle);
+  state_put(section, laser_turret.shoot_angle);
+  state_put(section, laser_turret.blinked_count);
+  state_put(section, triple_gun_turret.projectiles_left_to_spawn);
+  state_put(section, chain_activator.start_radius);
+  state_put(section, chain_activator.end_radius);
+  state_put(section, chain_activator.orbital_global_rotation);
+  Loop(i, ArrayCount(chain_activator.orbitals)) state_put(section, chain_activator.orbitals[i].time);
+  Loop(i, ArrayCount(chain_activator.orbitals)) state_put(section, chain_activator.orbitals[i].active);
+  state_put(section, infector.wobble);
+}
+
+void write_timer_list_state(State_Section* section, Timing_Wheel* wheel, s32 list, s32 first) {
+  for(s32 at = first; at != TIMING_WHEEL_NIL; at = wheel->nodes[at].next) {
+    Wheel_Node* node = &wheel->nodes[at];
+    if((node->payload >> 24) == Timer_Event_Particle_Expire) continue;
+    
+    state_put(section, list);
+    state_put(section, node->expire_tick);
+    state_put(section, node->payload);
+  }
+}
+
+// Writes the fields in the order of the tables above.
+void write_sim_state(State_Section* sections) {
+  Game_State* gs = get_game_state();
+  Loop(i, State_Section_Count) sections[i].word_count = 0;
+  
+  State_Section* level = &sections[State_Section_Level];
+  state_put(level, gs->sim_tick);
+  state_put(level, gs->score);
+  state_put(level, gs->level_time_passed);
+  state_put(level, gs->entity_count);
+  state_put(level, gs->are_spawn_timers_init);
+  state_put(level, gs->spawn_timer.goon.end_tick);
+  state_put(level, gs->spawn_timer.laser_turret.end_tick);
+  state_put(level, gs->spawn_timer.triple_turret.end_tick);
+  state_put(level, gs->spawn_timer.activator.end_tick);
+  state_put(level, gs->spawn_timer.infector.end_tick);
+  state_put(level, gs->timer_wheel.now);
+  state_put(level, gs->level_played_times);
+  Loop(faction, Projectile_Faction_Count) state_put(level, gs->projectile_pools[faction].next_index);
+  state_put(level, gs->next_laser_beam_index);
+  state_put(level, gs->next_chain_circle_index);
+  state_put(level, gs->next_explosion_index);
+  state_put(level, gs->next_score_dot_index);
+  
+  State_Section* random = &sections[State_Section_Random];
+  Random_Series* gameplay = random_stream(Random_Stream_Gameplay);
+  Loop(i, 4) state_put(random, gameplay->s[i]);
+  state_put(random, (u32)global_random_key);
+  state_put(random, (u32)(global_random_key >> 32));
+  
+  State_Section* entities = &sections[State_Section_Entities];
+  Kinematics* entity_k = &gs->entity_kinematics;
+  Loop(i, gs->entity_count) {
+    Entity_Base* e = &gs->entities[i].base;
+    state_put(entities, e->index.value);
+    state_put(entities, (u32)e->type);
+    state_put(entities, (s32)e->state);
+    state_put(entities, entity_k->x[i]);  state_put(entities, entity_k->y[i]);
+    state_put(entities, e->dir.x);        state_put(entities, e->dir.y);
+    state_put(entities, entity_k->vx[i]); state_put(entities, entity_k->vy[i]);
+    state_put(entities, e->rotation);
+    state_put(entities, e->radius);
+    state_put(entities, e->hit_points);
+    state_put(entities, e->has_entered_state);
+    state_put(entities, e->state_timer.end_tick);
+    state_put(entities, e->script.resume_point);
+    state_put(entities, e->script.wake_tick);
+    state_put(entities, e->is_active);
+    write_entity_type_state(entities, &gs->entities[i]);
+  }
+  
+  State_Section* projectiles = &sections[State_Section_Projectiles];
+  Loop(faction, Projectile_Faction_Count) {
+    Projectile_Pool* pool = &gs->projectile_pools[faction];
+    Kinematics* k = &pool->kinematics;
+    LoopProjectiles(i, pool) {
+      Projectile* p = &pool->projectiles[i];
+      state_put(projectiles, (s32)faction);
+      state_put(projectiles, (s32)i);
+      state_put(projectiles, k->x[i]);  state_put(projectiles, k->y[i]);
+      state_put(projectiles, k->vx[i]); state_put(projectiles, k->vy[i]);
+      state_put(projectiles, p->dir.x); state_put(projectiles, p->dir.y);
+      state_put(projectiles, p->move_speed);
+      state_put(projectiles, p->radius);
+      state_put(projectiles, p->emit_timer.start_tick);
+      state_put(projectiles, p->emit_timer.end_tick);
+      state_put(projectiles, (u32)p->from_type);
+    }
+  }
+  
+  State_Section* chain_circles = &sections[State_Section_Chain_Circles];
+  LoopBits(i, gs->active_chain_circle_mask, MAX_CHAIN_CIRCLES) {
+    Chain_Circle* c = &gs->chain_circles[i];
+    state_put(chain_circles, (s32)i);
+    state_put(chain_circles, c->pos.x); state_put(chain_circles, c->pos.y);
+    state_put(chain_circles, c->radius);
+    state_put(chain_circles, c->target_radius);
+    state_put(chain_circles, c->emerge_time);
+    state_put(chain_circles, c->has_emerged);
+    state_put(chain_circles, c->life_time);
+    state_put(chain_circles, c->life_prolong_time);
+    state_put(chain_circles, c->is_infected);
+    state_put(chain_circles, c->infection_timer.start_tick);
+    state_put(chain_circles, c->infection_timer.end_tick);
+    state_put(chain_circles, c->infection);
+  }
+  
+  State_Section* score_dots = &sections[State_Section_Score_Dots];
+  LoopBits(i, gs->active_score_dot_mask, MAX_SCORE_DOTS) {
+    Score_Dot* d = &gs->score_dots[i];
+    state_put(score_dots, (s32)i);
+    state_put(score_dots, d->pos.x); state_put(score_dots, d->pos.y);
+    state_put(score_dots, d->is_special);
+    state_put(score_dots, d->life_time);
+  }
+  
+  State_Section* laser_beams = &sections[State_Section_Laser_Beams];
+  LoopBits(i, gs->active_laser_beam_mask, MAX_LASER_BEAMS) {
+    Laser_Beam* b = &gs->laser_beams[i];
+    state_put(laser_beams, (s32)i);
+    state_put(laser_beams, b->origin.x); state_put(laser_beams, b->origin.y);
+    state_put(laser_beams, b->dir.x);    state_put(laser_beams, b->dir.y);
+    state_put(laser_beams, b->first_segment);
+    state_put(laser_beams, b->end_segment);
+  }
+  
+  State_Section* timer_wheel = &sections[State_Section_Timer_Wheel];
+  Timing_Wheel* wheel = &gs->timer_wheel;
+  Loop(list, ArrayCount(wheel->slots)) write_timer_list_state(timer_wheel, wheel, (s32)list, wheel->slots[list]);
+  write_timer_list_state(timer_wheel, wheel, Wheel_List_Expired, wheel->first_expired);
+  
+  Loop(i, State_Section_Count) Assert(sections[i].word_count % sections[i].field_count == 0);
+}
+
+//
+// Snapshots
+//
+// The simulation state is one range: the end of Game_State from sim_tick down, then the
+// pools allocated after it in the sim block (see init_game). Saving and restoring it are
+// a memcpy each, see game_snapshot.cpp. The random streams and the timer clock belong to
+// their modules, they go into the range before a save and come back out after a restore.
+//
+
+void save_sim_snapshot(void) {
+  Game_State* gs = get_game_state();
+  gs->random = random_save();
+  snapshot_save(&gs->snapshots, gs->sim_tick);
+}
+
+// 'back' counts saves before the newest one, see snapshot_restore.
+b32 restore_sim_snapshot(s32 back) {
+  Game_State* gs = get_game_state();
+  
+  b32 r = snapshot_restore(&gs->snapshots, back);
+  if(r) {
+    random_restore(&gs->random);
+    timer_clock_set_tick(gs->sim_tick);
+  }
+  return r;
+}
+
+// Runs as many fixed steps of SIM_DELTA_TIME as the frame time covers.
+void simulate_game(b32 should_update_level) {
+  Game_State* gs = get_game_state();
+  
+  // Frame times that are only vsync jitter away from one tick count as exactly one tick,
+  // otherwise equal sim and frame rates would alternate between 0 and 2 steps a frame.
+  f32 frame_time = GetFrameTime();
+  if(Abs(frame_time - SIM_DELTA_TIME) < 0.0005f) frame_time = SIM_DELTA_TIME;
+  
+  gs->sim_time_accumulator += frame_time;
+  
+  s32 step_count = 0;
+  while(gs->sim_time_accumulator >= SIM_DELTA_TIME) {
+    // After a long hitch we rather slow down than try to catch up all at once.
+    if(step_count == MAX_SIM_STEPS_PER_FRAME) {
+      gs->sim_time_accumulator = 0.0f;
+      break;
+    }
+    
+    b32 update_level_this_tick = should_update_level;
+    gs->input = sample_sim_input();
+    replay_input(&gs->input, &update_level_this_tick);
+    
+    if(update_level_this_tick) update_level();
+    update_game();
+    
+    gs->sim_tick += 1;
+    timer_clock_set_tick(gs->sim_tick);
+    gs->sim_time_accumulator -= SIM_DELTA_TIME;
+    step_count += 1;
+    
+    if(gs->sim_tick % SIM_SNAPSHOT_INTERVAL == 0) save_sim_snapshot();
+    
+    if(replay_is_active()) {
+      State_Section* sections = NULL;
+      if(replay_wants_state(gs->sim_tick)) {
+        write_sim_state(global_state_sections);
+        sections = global_state_sections;
+      }
+      replay_end_tick(gs->sim_tick, gs->input, update_level_this_tick, sections);
+    }
+  }
+}
+
 //
 // @draw
 //
@@ -2189,6 +3477,19 @@ void draw_debug_info(void)  {
   pos.y += font_size;
   
   
+  // anything here means MAX_SIM_EVENTS is too small, the dropped events never happened
+  s32 dropped = atomic_load_s32(&gs->sim_events.dropped);
+  score_text = (char*)TextFormat("sim_events_dropped: %d\n", dropped);
+  draw_text(gs->small_font, score_text, pos, dropped ? RED_VEC4 : WHITE_VEC4);
+  pos.y += font_size;
+  
+  
+  Snapshot_Ring* snapshots = &gs->snapshots;
+  score_text = (char*)TextFormat("snapshot: %d KB, save %.1f us, restore %.1f us, %d kept\n", (s32)(snapshots->block_size/1024), snapshots->save_seconds*1000000.0, snapshots->restore_seconds*1000000.0, snapshots->count);
+  draw_text(gs->small_font, score_text, pos, WHITE_VEC4);
+  pos.y += font_size;
+  
+  
   f64 update_ms  = gs->update_time*1000.0f;
   s32 update_fps = (s32)(1.0f/gs->update_time);
   score_text = (char*)TextFormat("update_ms:  %.4f[%d fps]\n", update_ms, update_fps);
@@ -2213,7 +3514,7 @@ void draw_debug_info(void)  {
 void draw_health_bar(Entity* the_entity) {
   Entity_Base* entity = (Entity_Base*)the_entity;
   
-  Vec2 top_left = entity->pos - vec2(1,1)*entity->radius;
+  Vec2 top_left = entity_pos(entity) - vec2(1,1)*entity->radius;
   
   f32 hp_bar_h   = 10;
   f32 hp_bar_pad = 4;
@@ -2236,7 +3537,7 @@ void draw_laser_turret(Entity* entity) {
   // Laser
   if(turret->state == Entity_State_Telegraphing) {  
     Vec2 v = vec2(turret->shoot_angle);
-    draw_line(turret->pos, turret->pos + v*2000.0f, 2.0f, {1,1,1,0.5f});
+    draw_line(entity_pos(turret), entity_pos(turret) + v*2000.0f, 2.0f, {1,1,1,0.5f});
   }
   
   // Gun  
@@ -2245,13 +3546,13 @@ void draw_laser_turret(Entity* entity) {
   gun_dim *= radius_t;
   
   f32 offset_to_gun = turret->radius + gun_dim.width/2;
-  Vec2 gun_pos = turret->pos + vec2(turret->rotation)*offset_to_gun;
+  Vec2 gun_pos = entity_pos(turret) + vec2(turret->rotation)*offset_to_gun;
   draw_quad(gun_pos - gun_dim*0.5f, gun_dim, turret->rotation, BLACK_VEC4);
 
   // Turret
-  draw_quad(turret->pos - dim*0.5f, dim, turret->rotation, BLACK_VEC4);
+  draw_quad(entity_pos(turret) - dim*0.5f, dim, turret->rotation, BLACK_VEC4);
   f32 f = 0.85f;
-  draw_quad(turret->pos - dim*0.5f*f, dim*f, turret->rotation, turret->color);
+  draw_quad(entity_pos(turret) - dim*0.5f*f, dim*f, turret->rotation, turret->color);
   
   b32 show_health = timer_is_active(turret->health_bar_display_timer);
   if(show_health) draw_health_bar((Entity*)turret);
@@ -2271,11 +3572,11 @@ void draw_triple_gun_turret(Entity* entity) {
   f32 angle = -angle_step;
   Loop(i, 3) {
     Vec2 dir = vec2(turret->rotation + angle);
-    Vec2 pos = turret->pos + dir*(turret->radius + gun_dim.height/2.5f);
+    Vec2 pos = entity_pos(turret) + dir*(turret->radius + gun_dim.height/2.5f);
     draw_quad(pos - gun_dim*0.5f, gun_dim, turret->rotation + angle, BLACK_VEC4);
     angle += angle_step;
   }
-  draw_quad(gs->chain_activator_texture, turret->pos - dim*0.5f, dim, turret->rotation + Pi32/2, turret->color);
+  draw_quad(gs->chain_activator_texture, entity_pos(turret) - dim*0.5f, dim, turret->rotation + Pi32/2, turret->color);
   
   b32 show_health = timer_is_active(turret->health_bar_display_timer);
   if(show_health) draw_health_bar((Entity*)turret);
@@ -2292,46 +3593,30 @@ void draw_butterfly(Vec2 pos, f32 scale, f32 rot, f32 y_offset, Vec4 color) {
   Vec2 top_offsets[5]    = {{0, 0}, offset, offset, offset, {0,0}};
   Vec2 bottom_offsets[5] = {{0, 0}, {0,0}, offset, offset, offset};
   
-  for(s32 i = 1; i < 5 - 1; i += 1) {
-
-    Vec2 a = top_wing[0] + top_offsets[0];
-    Vec2 b = top_wing[i] + top_offsets[i];
-    Vec2 c = top_wing[i+1] + top_offsets[i+1];
+  // each wing and its mirror on x, transformed in one go
+  Vec2 v[20];
+  Loop(i, 5) {
+    Vec2 top    = top_wing[i] + top_offsets[i];
+    Vec2 bottom = bottom_wing[i] + bottom_offsets[i];
     
-    Vec2 v1 = pos + vec2_rotate(a, rot)*scale;
-    Vec2 v2 = pos + vec2_rotate(b, rot)*scale;
-    Vec2 v3 = pos + vec2_rotate(c, rot)*scale;
-
-    draw_triangle(v3, v2, v1, vec4_fade_alpha(color, 0.5f));     
-    draw_triangle_outline(v3, v2, v1, color);
-
-    // flipped on x
-    v1 = pos + vec2_rotate({-a.x, a.y}, rot)*scale;
-    v2 = pos + vec2_rotate({-b.x, b.y}, rot)*scale;
-    v3 = pos + vec2_rotate({-c.x, c.y}, rot)*scale;
-    draw_triangle(v1, v2, v3, vec4_fade_alpha(color, 0.5f));     
-    draw_triangle_outline(v3, v2, v1, color);
+    v[i]      = top;
+    v[5 + i]  = {-top.x, top.y};
+    v[10 + i] = bottom;
+    v[15 + i] = {-bottom.x, bottom.y};
   }
+  vec2_transform_points(v, v, ArrayCount(v), rot, scale, pos);
   
-  
-  for(s32 i = 1; i < 5 - 1; i += 1) {
-    Vec2 a = bottom_wing[0] + bottom_offsets[0];
-    Vec2 b = bottom_wing[i] + bottom_offsets[i];
-    Vec2 c = bottom_wing[i+1] + bottom_offsets[i+1];
+  for(s32 wing = 0; wing < 20; wing += 10) {
+    Vec2* w = v + wing;
+    Vec2* flipped = v + wing + 5;
     
-    Vec2 v1 = pos + vec2_rotate(a, rot)*scale;
-    Vec2 v2 = pos + vec2_rotate(b, rot)*scale;
-    Vec2 v3 = pos + vec2_rotate(c, rot)*scale;
-
-    draw_triangle(v3, v2, v1, vec4_fade_alpha(color, 0.5f));     
-    draw_triangle_outline(v3, v2, v1, color);
-
-    // flipped on x
-    v1 = pos + vec2_rotate({-a.x, a.y}, rot)*scale;
-    v2 = pos + vec2_rotate({-b.x, b.y}, rot)*scale;
-    v3 = pos + vec2_rotate({-c.x, c.y}, rot)*scale;
-    draw_triangle(v1, v2, v3, vec4_fade_alpha(color, 0.5f));     
-    draw_triangle_outline(v3, v2, v1, color);
+    for(s32 i = 1; i < 5 - 1; i += 1) {
+      draw_triangle(w[i+1], w[i], w[0], vec4_fade_alpha(color, 0.5f));     
+      draw_triangle_outline(w[i+1], w[i], w[0], color);
+      
+      draw_triangle(flipped[0], flipped[i], flipped[i+1], vec4_fade_alpha(color, 0.5f));     
+      draw_triangle_outline(flipped[i+1], flipped[i], flipped[0], color);
+    }
   }
 }
 
@@ -2356,19 +3641,63 @@ void draw_infector_shape(Vec2 pos, f32 radius, Vec4 color = RED_VEC4, Vec4 outli
 void draw_infector(Entity* entity) {
   Infector* infector = (Infector*)entity;
   f32 scale = infector->radius + infector->wobble*8.0f;
-  draw_infector_shape(infector->pos, scale);
-  draw_infector_shape(infector->pos, scale*0.65f, vec4(0xffff8519));
+  draw_infector_shape(entity_pos(infector), scale);
+  draw_infector_shape(entity_pos(infector), scale*0.65f, vec4(0xffff8519));
   
   b32 show_health = timer_is_active(infector->health_bar_display_timer);
   if(show_health) draw_health_bar((Entity*)infector);
 }
 
+void draw_goon(Entity* entity) {
+  Goon* goon = (Goon*)entity;
+  
+  Vec2 dim = vec2(1, 1)*goon->radius*2;
+  f32 thickness = 3.0f;
+  
+  f32 scale = 1.0f - thickness/goon->radius;
+  draw_quad(entity_pos(goon) - dim*0.5f, dim, goon->rotation, GOON_OUTLINE_COLOR);        
+  draw_quad(entity_pos(goon) - dim*0.5f*scale, dim*scale, goon->rotation, goon->color);
+  
+  b32 show_health = timer_is_active(goon->health_bar_display_timer);
+  if(show_health) draw_health_bar(entity);
+}
+
+void draw_chain_activator(Entity* entity) {
+  Game_State* gs = get_game_state();
+  Chain_Activator* activator = (Chain_Activator*)entity;
+  
+  Vec2 dim = vec2(2, 2)*activator->radius;
+  Vec2 pos = entity_pos(activator) - dim*0.5f;
+  draw_quad(gs->chain_activator_texture, pos, dim, activator->rotation, activator->color);
+  
+  Vec2 orbital_dim = vec2(2,2)*activator->orbital_radius;
+  s32 orbital_count = ArrayCount(activator->orbitals);
+  f32 angle = activator->orbital_global_rotation;
+  f32 angle_step = (2.0f*Pi32)/(f32)orbital_count;
+  Loop(i, orbital_count) {
+    if(!activator->orbitals[i].active) continue;
+    Vec2 local_pos  = vec2(angle);
+    Vec2 global_pos = entity_pos(activator) + local_pos*(activator->radius + activator->orbital_radius);
+    f32 rot = activator->orbitals[i].rotation;
+    
+    draw_quad(gs->chain_activator_texture, global_pos - orbital_dim*0.5f, orbital_dim, rot, activator->color);
+    angle += angle_step;
+  }        
+  
+  if(activator->for_tutorial_purposes) {
+    char* text = activator->text_line;
+    Vector2 tdim = MeasureTextEx(gs->small_font, text, gs->small_font.baseSize, 0);
+    Vec2 tpos = {entity_pos(activator).x - tdim.x/2, pos.y - dim.height/2 - gs->small_font.baseSize};
+    draw_text(gs->small_font, text, tpos, WHITE_VEC4);
+  }
+}
+
 void draw_player(Entity* entity) {
   Player* player = (Player*)entity;
   
   if(player->hit_points <= 0) return;
   
-  Vec2 pos = player->pos;
+  Vec2 pos = entity_pos(player);
   Vec2 dim = vec2(2,2)*player->radius; 
   
   f32 shoot_indicator_scale = player->shoot_indicator*10.0f;
@@ -2380,98 +3709,60 @@ void draw_player(Entity* entity) {
   draw_butterfly(pos, scale, player->turn_angle, player->flap, color);
 }
 
+// Each type gets its own loop over its index list, there is no per entity type switch.
 void draw_entities(void) {
-  Game_State* gs = get_game_state();
+#define X(type, struct_name, update_proc, draw_proc) \
+  LoopEntitiesOfType(i, type) draw_proc(get_entity_of_type(type, (s32)i));
+  
+  ENTITY_TYPE_TABLE(X)
+#undef X
+}
 
-  Loop(i, gs->entity_count) {
-    Entity* the_entity = &gs->entities[i];
-    Entity_Base* entity = (Entity_Base*)the_entity;
-  
-    switch(entity->type) {
-      case Entity_Type_Player: {
-        draw_player(the_entity);
-      }break;
-      case Entity_Type_Goon: {
-        Vec2 dim = vec2(1, 1)*entity->radius*2;
-        f32 thickness = 3.0f;
-        
-        f32 scale = 1.0f - thickness/entity->radius;
-        draw_quad(entity->pos - dim*0.5f, dim, entity->rotation, GOON_OUTLINE_COLOR);        
-        draw_quad(entity->pos - dim*0.5f*scale, dim*scale, entity->rotation, entity->color);
-        
-        b32 show_health = timer_is_active(entity->health_bar_display_timer);
-        if(show_health) draw_health_bar(the_entity);
-      }break;
-      case Entity_Type_Laser_Turret:      { draw_laser_turret(the_entity);      }break;
-      case Entity_Type_Triple_Gun_Turret: { draw_triple_gun_turret(the_entity); }break;
-      case Entity_Type_Infector:          { draw_infector(the_entity);          }break;
-      case Entity_Type_Chain_Activator: {
-        Chain_Activator* activator = (Chain_Activator*)entity;
-        
-        Vec2 dim = vec2(2, 2)*activator->radius;
-        Vec2 pos = activator->pos - dim*0.5f;
-        draw_quad(gs->chain_activator_texture, pos, dim, activator->rotation, activator->color);
-        
-        Vec2 orbital_dim = vec2(2,2)*activator->orbital_radius;
-        s32 orbital_count = ArrayCount(activator->orbitals);
-        f32 angle = activator->orbital_global_rotation;
-        f32 angle_step = (2.0f*Pi32)/(f32)orbital_count;
-        Loop(i, orbital_count) {
-          if(!activator->orbitals[i].active) continue;
-          Vec2 local_pos  = vec2(angle);
-          Vec2 global_pos = activator->pos + local_pos*(activator->radius + activator->orbital_radius);
-          f32 rot = activator->orbitals[i].rotation;
-          
-          draw_quad(gs->chain_activator_texture, global_pos - orbital_dim*0.5f, orbital_dim, rot, activator->color);
-          angle += angle_step;
-        }        
-        
-        if(activator->for_tutorial_purposes) {
-          char* text = activator->text_line;
-          Vector2 tdim = MeasureTextEx(gs->small_font, text, gs->small_font.baseSize, 0);
-          Vec2 tpos = {activator->pos.x - tdim.x/2, pos.y - dim.height/2 - gs->small_font.baseSize};
-          draw_text(gs->small_font, text, tpos, WHITE_VEC4);
-        }
-      }break;
+void draw_projectiles(void) {
+  Loop(faction, Projectile_Faction_Count) {
+    Projectile_Pool* pool = get_projectile_pool((Projectile_Faction)faction);
+    b32 is_infector_bullet = (faction == Projectile_Faction_Infector);
+    
+    LoopProjectiles(i, pool) {
+      Projectile* p = &pool->projectiles[i];
+      Vec2 pos = kinematics_pos(&pool->kinematics, i);
+      Vec2 dim = vec2(1, 1)*p->radius*2;
+      
+      if(is_infector_bullet) draw_infector_shape(pos, p->radius);
+      draw_quad(pos - dim*0.5f, dim, p->rotation, p->color);
     }
   }
 }
 
-void draw_projectiles(void) {
+void draw_laser_beams(void) {
   Game_State* gs = get_game_state();
   
-  Loop(i, MAX_PROJECTILES) {
-    Projectile* p = &gs->projectiles[i];
-    if(!p->is_active) continue;
-    Vec2 dim = vec2(1, 1)*p->radius*2;
+  LoopBits(i, gs->active_laser_beam_mask, MAX_LASER_BEAMS) {
+    Laser_Beam* b = &gs->laser_beams[i];
+    Vec2 dim = vec2(1, 1)*b->radius*2;
+    Vec4 color = {1,1,1,1};
     
-    switch(p->from_type) {
-      case Entity_Type_Player: {
-        draw_quad(p->pos - dim*0.5f, dim, p->rotation, p->color);
-      } break;
-      case Entity_Type_Triple_Gun_Turret: {
-        draw_quad(p->pos - dim*0.5f, dim, p->rotation, p->color);
-      }break;
-      case Entity_Type_Infector: {
-        draw_infector_shape(p->pos, p->radius);
-        draw_quad(p->pos - dim*0.5f, dim, p->rotation, p->color);
-      }break;
-      case Entity_Type_Laser_Turret: {
-        Vec4 color = {1,1,1,1};
-        
-        if(p->life_timer.passed_time > LASER_TURRET_PROJECTILE_FADE_AFTER) {
-          f32 fade_time = LASER_TURRET_PROJECTILE_LIFETIME - LASER_TURRET_PROJECTILE_FADE_AFTER;
-          
-          f32 t = 1.0f - (p->life_timer.passed_time - LASER_TURRET_PROJECTILE_FADE_AFTER)/fade_time;
-          ease_out_quad(&t);
-        
-          dim.height *= t;
-          if(dim.height < 20) dim.height = 20;         
-          color.a = t;   
-        }
-        
-        draw_quad(gs->laser_bullet_texture, p->pos - dim*0.5f, dim, p->rotation, color);
-      }break;
+    f32 age = laser_beam_age(b);
+    if(age > LASER_BEAM_FADE_AFTER) {
+      f32 fade_time = LASER_BEAM_LIFETIME - LASER_BEAM_FADE_AFTER;
+      
+      f32 t = 1.0f - (age - LASER_BEAM_FADE_AFTER)/fade_time;
+      ease_out_quad(&t);
+    
+      dim.height *= t;
+      if(dim.height < 20) dim.height = 20;         
+      color.a = t;   
+    }
+    
+    for(s32 segment = b->first_segment; segment < b->end_segment; segment += 1) {
+      // Keyed by the segment so the jitter stays put when the beam gets split.
+      Random_Counter random = random_counter(b->shooter_id, b->spawn_tick, Random_Purpose_Laser_Jitter, (u32)segment);
+      
+      f32 jitter_angle = 2.0f*Pi32*random_f32(&random);
+      Vec2 pos = laser_beam_segment_pos(b, segment) + vec2(jitter_angle)*random_f32(&random)*3.0f;
+      f32 rot  = b->rotation + (2.0f*random_f32(&random) - 1.0f)*Pi32*0.2f;
+      
+      draw_quad(gs->laser_bullet_texture, pos - dim*0.5f, dim, rot, color);
     }
   }
 }
@@ -2480,9 +3771,8 @@ void draw_projectiles(void) {
 void draw_chain_circles(void) {
   Game_State* gs = get_game_state();
 
-  Loop(i, MAX_CHAIN_CIRCLES){
+  LoopBits(i, gs->active_chain_circle_mask, MAX_CHAIN_CIRCLES) {
     Chain_Circle* c = &gs->chain_circles[i];
-    if(!c->is_active) continue;
     
     Vec2 dim = vec2(1,1)*2*c->radius;
     Vec2 pos = c->pos - dim*0.5f;
@@ -2513,9 +3803,8 @@ void draw_score_dots(void) {
   
   f32 outline_thickness = 2.0f;
   
-  Loop(i, MAX_SCORE_DOTS) {
+  LoopBits(i, gs->active_score_dot_mask, MAX_SCORE_DOTS) {
     Score_Dot* dot = &gs->score_dots[i];
-    if(!dot->is_active) continue;
   
     
     Vec4 outter_color = WHITE_VEC4;
@@ -2532,7 +3821,7 @@ void draw_score_dots(void) {
       
       f32 x = GetTime();
       f32 freq = SCORE_DOT_BLINK_FREQ;
-      f32 t = (cosf(x*freq - cos_offset) + 1)/2.0f;
+      f32 t = (cos_f32(x*freq - cos_offset, Trig_Accuracy_Low) + 1)/2.0f;
       inner_color.a = lerp_f32(inner_alpha, 1.0f, t);
     }
     
@@ -2560,9 +3849,8 @@ void draw_score_dots(void) {
 void draw_explosions() {
   Game_State* gs = get_game_state();
   
-  Loop(i, MAX_EXPLOSIONS) {
+  LoopBits(i, gs->active_explosion_mask, MAX_EXPLOSIONS) {
     Explosion* e = &gs->explosions[i];
-    if(!e->is_active) continue;
     
     draw_explosion_polygon(e->pos, e->scale, e->rot);    
   }
@@ -2618,6 +3906,7 @@ void draw_game(void) {
   draw_score_dots();
   draw_particles();
   draw_projectiles();
+  draw_laser_beams();
   
   draw_chain_circles();
   draw_explosions();
@@ -2704,6 +3993,13 @@ s32 get_horizontal_navigation_dir() {
 
 void do_game_screen(void) {
   Game_State* gs = get_game_state();
+  
+  // Debug rewind, a snapshot further back every press. A replay would go out of step with
+  // its file.
+  if(gs->show_debug_info && IsKeyPressed(KEY_R) && !replay_is_active()) {
+    restore_sim_snapshot(1);
+  }
+  
   Player* player = get_player();
 
   b32 is_level_finished = gs->level_time_passed > gs->level_duration;
@@ -2719,10 +4015,8 @@ void do_game_screen(void) {
   }
     
   update_audio();
-  update_level();
-  update_game();
+  simulate_game(true);
 
-  timer_step(&gs->show_game_controls_timer, GetFrameTime());
   b32 show_game_controls = timer_is_active(gs->show_game_controls_timer);
     
   BeginDrawing();
@@ -2816,7 +4110,7 @@ void do_menu_screen(void) {
     Vec4 color = WHITE_VEC4;
     if(is_selected) {
       f32 x = GetTime()*12.0f;
-      f32 t = (cosf(x) + 1)/2.0f;
+      f32 t = (cos_f32(x, Trig_Accuracy_Low) + 1)/2.0f;
       color = vec4_lerp(WHITE_VEC4, YELLOW_VEC4, t);
     }
     
@@ -2852,7 +4146,7 @@ void do_menu_screen(void) {
   Vec2 hs_pos = {hs_pad, WINDOW_HEIGHT - gs->small_font.baseSize - hs_pad};
   draw_text(gs->small_font, hs_text, hs_pos, WHITE_VEC4);
   
-  f32 flap = cosf(GetTime()*8.0f)*0.065f;
+  f32 flap = cos_f32(GetTime()*8.0f, Trig_Accuracy_Low)*0.065f;
   draw_butterfly(get_screen_center(), 200.0f, 0.0f, flap, WHITE_VEC4);
   EndDrawing();
 }
@@ -2895,7 +4189,7 @@ void do_credits_screen(void) {
   }
   
   f32 x = GetTime()*12.0f;
-  f32 t = (cosf(x) + 1)/2.0f;
+  f32 t = (cos_f32(x, Trig_Accuracy_Low) + 1)/2.0f;
   Vec4 color = vec4_lerp(WHITE_VEC4, YELLOW_VEC4, t);
   draw_text_centered(gs->medium_font, "Back", WINDOW_HEIGHT - 100.0f, color);
   EndDrawing();
@@ -2939,7 +4233,7 @@ void do_pause_screen(void) {
     Vec4 color = WHITE_VEC4;
     if(is_selected) {
       f32 x = GetTime()*12.0f;
-      f32 t = (cosf(x) + 1)/2.0f;
+      f32 t = (cos_f32(x, Trig_Accuracy_Low) + 1)/2.0f;
       color = vec4_lerp(WHITE_VEC4, YELLOW_VEC4, t);
     }
     
@@ -2989,7 +4283,7 @@ void do_death_screen(b32 should_update_game = true, char* bottom_text = "Death")
     }
   }
 
-  if(should_update_game) update_game();
+  if(should_update_game) simulate_game(false);
   
   BeginDrawing();
   draw_game();
@@ -3020,7 +4314,7 @@ void do_death_screen(b32 should_update_game = true, char* bottom_text = "Death")
     Vec4 color = WHITE_VEC4;
     if(is_selected) {
       f32 x = GetTime()*12.0f;
-      f32 t = (cosf(x) + 1)/2.0f;
+      f32 t = (cos_f32(x, Trig_Accuracy_Low) + 1)/2.0f;
       color = vec4_lerp(WHITE_VEC4, YELLOW_VEC4, t);
     }
     
@@ -3049,6 +4343,17 @@ void init_game(void) {
     random_begin(seed);
   };
   
+  fixed_tables_init();
+  
+  // SIMD kernels
+  {
+    Simd_Level level = cpu_simd_level(FORCE_SCALAR_KERNELS);
+    math_bind_kernels(level);
+    random_bind_kernels(level);
+    kinematics_bind_kernels(level);
+    TraceLog(LOG_INFO, "GAME: Using %s kernels (cpu sse2: %s)", simd_level_names[level], cpu_has_sse2() ? "yes" : "no");
+  }
+  
   // Asset catalog
   asset_catalog_init();
   asset_catalog_add("imgs");
@@ -3065,6 +4370,16 @@ void init_game(void) {
   u8* allocator_base = (u8*)MemAlloc(allocator_size);
   *allocator = allocator_create(allocator_base, allocator_size);
   
+  // Timers run on the simulation clock
+  timer_clock_init(SIM_DELTA_TIME, 0);
+  
+  job_system_init(JOB_WORKER_COUNT, JOB_PARALLEL_THRESHOLD);
+  
+  // Sim block, Game_State first and the simulation pools after it.
+  u8* sim_block_base = allocator_alloc(allocator, SIM_BLOCK_SIZE);
+  Allocator sim_allocator = allocator_create(sim_block_base, SIM_BLOCK_SIZE);
+  global_game_state = allocator_alloc_struct(&sim_allocator, Game_State);
+  
   // Game state init
   Game_State* game_state = get_game_state();
   *game_state = {};
@@ -3074,12 +4389,38 @@ void init_game(void) {
   game_state->level_played_times = 0;
   
   // game object allocation
-  game_state->entities      = allocator_alloc_array(allocator, Entity,       MAX_ENTITIES);
-  game_state->projectiles   = allocator_alloc_array(allocator, Projectile,   MAX_PROJECTILES);
-  game_state->chain_circles = allocator_alloc_array(allocator, Chain_Circle, MAX_CHAIN_CIRCLES);
-  game_state->explosions    = allocator_alloc_array(allocator, Explosion,    MAX_EXPLOSIONS);
-  game_state->score_dots    = allocator_alloc_array(allocator, Score_Dot,    MAX_SCORE_DOTS);
-  game_state->particles     = allocator_alloc_array(allocator, Particle,     MAX_PARTICLES);
+  game_state->entities      = allocator_alloc_array(&sim_allocator, Entity,       MAX_ENTITIES);
+  kinematics_init(&game_state->entity_kinematics, &sim_allocator, MAX_ENTITIES);
+  
+  s32 projectile_pool_capacity[Projectile_Faction_Count] = {
+    MAX_PLAYER_PROJECTILES, MAX_CHAIN_PROJECTILES, MAX_INFECTOR_PROJECTILES,
+  };
+  Loop(faction, Projectile_Faction_Count) {
+    Projectile_Pool* pool = &game_state->projectile_pools[faction];
+    pool->capacity    = projectile_pool_capacity[faction];
+    pool->projectiles = allocator_alloc_array(&sim_allocator, Projectile, pool->capacity);
+    kinematics_init(&pool->kinematics, &sim_allocator, pool->capacity);
+    Assert(pool->capacity <= MAX_PROJECTILES);
+  }
+  
+  game_state->chain_circles = allocator_alloc_array(&sim_allocator, Chain_Circle, MAX_CHAIN_CIRCLES);
+  game_state->laser_beams   = allocator_alloc_array(&sim_allocator, Laser_Beam,   MAX_LASER_BEAMS);
+  game_state->explosions    = allocator_alloc_array(&sim_allocator, Explosion,    MAX_EXPLOSIONS);
+  game_state->score_dots    = allocator_alloc_array(&sim_allocator, Score_Dot,    MAX_SCORE_DOTS);
+  game_state->particles     = allocator_alloc_array(&sim_allocator, Particle,     MAX_PARTICLES);
+  kinematics_init(&game_state->particle_kinematics, &sim_allocator, MAX_PARTICLES);
+  
+  Wheel_Node* timer_nodes = allocator_alloc_array(&sim_allocator, Wheel_Node, MAX_TIMER_WHEEL_NODES);
+  timing_wheel_init(&game_state->timer_wheel, timer_nodes, MAX_TIMER_WHEEL_NODES, 0);
+  Assert(timer_nodes); // the last one, if it fit SIM_BLOCK_SIZE is big enough
+  
+  u8* sim_state_begin = (u8*)&game_state->sim_tick;
+  u8* sim_state_end   = allocator_allocations_end(&sim_allocator);
+  snapshot_ring_init(&game_state->snapshots, allocator, sim_state_begin, sim_state_end - sim_state_begin, SIM_SNAPSHOT_COUNT);
+  
+  sim_event_queue_init(&game_state->sim_events, allocator, MAX_SIM_EVENTS);
+  
+  contact_system_init(allocator, MAX_CONTACT_BODIES, MAX_CONTACT_PAIRS, 0.0f, WINDOW_WIDTH, CONTACT_STRIP_COUNT);
   
   // assets
   game_state->chain_circle_texture    = texture_asset_load("chain_circle.png");
@@ -3133,6 +4474,15 @@ void init_game(void) {
   
   // inital level state
   //set_level_to_initial_state();
+  
+  // A replay being checked starts right in its level.
+  state_sections_init(allocator);
+  replay_init(REPLAY_STATE_INTERVAL, State_Section_Count);
+  if(replay_is_checking()) {
+    game_state->level_played_times = replay_level_played_times();
+    set_level_to_initial_state();
+    change_game_screen(Game_Screen_Game);
+  }
 }
 
 void do_game_loop(void) {
@@ -0,0 +1,68 @@
+//
+// Atomics
+//
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define thread_var __declspec(thread)
+#else
+#define thread_var __thread
+#endif
+
+// Returns the value from before the add.
+s32 atomic_add_s32(volatile s32* value, s32 addend) {
+#if defined(_MSC_VER)
+  s32 r = (s32)_InterlockedExchangeAdd((volatile long*)value, (long)addend);
+#else
+  s32 r = __atomic_fetch_add(value, addend, __ATOMIC_ACQ_REL);
+#endif
+  return r;
+}
+
+s32 atomic_load_s32(volatile s32* value) {
+#if defined(_MSC_VER)
+  s32 r = *value;
+  _ReadWriteBarrier();
+#else
+  s32 r = __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+  return r;
+}
+
+void atomic_store_s32(volatile s32* value, s32 new_value) {
+#if defined(_MSC_VER)
+  _ReadWriteBarrier();
+  *value = new_value;
+#else
+  __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+#endif
+}
+
+// Sets value to desired if it still holds expected, returns whether it did.
+b32 atomic_compare_exchange_u64(volatile u64* value, u64 expected, u64 desired) {
+#if defined(_MSC_VER)
+  b32 r = (u64)_InterlockedCompareExchange64((volatile __int64*)value, (__int64)desired, (__int64)expected) == expected;
+#else
+  b32 r = __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+  return r;
+}
+
+u64 atomic_load_u64(volatile u64* value) {
+#if defined(_MSC_VER)
+  u64 r = *value;
+  _ReadWriteBarrier();
+#else
+  u64 r = __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+  return r;
+}
+
+void atomic_store_u64(volatile u64* value, u64 new_value) {
+#if defined(_MSC_VER)
+  _ReadWriteBarrier();
+  *value = new_value;
+#else
+  __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+#endif
+}
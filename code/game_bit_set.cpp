@@ -0,0 +1,88 @@
+//
+// Bit set
+//
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define BIT_SET_WORD_COUNT(bit_count) (((bit_count) + 63)/64)
+
+s32 count_set_bits_u64(u64 value) {
+#if defined(_MSC_VER)
+  s32 r = (s32)__popcnt64(value);
+#else
+  s32 r = __builtin_popcountll(value);
+#endif
+  return r;
+}
+
+// Note: value must not be 0.
+s32 find_first_set_bit_u64(u64 value) {
+#if defined(_MSC_VER)
+  unsigned long index = 0;
+  _BitScanForward64(&index, value);
+  s32 r = (s32)index;
+#else
+  s32 r = __builtin_ctzll(value);
+#endif
+  return r;
+}
+
+void bit_set_set(u64* words, s64 index)   { words[index/64] |=  (1ULL << (index%64)); }
+void bit_set_unset(u64* words, s64 index) { words[index/64] &= ~(1ULL << (index%64)); }
+
+b32 bit_set_is_set(u64* words, s64 index) {
+  b32 r = (words[index/64] >> (index%64)) & 1;
+  return r;
+}
+
+// Sets bits [first, first + count).
+void bit_set_set_range(u64* words, s64 first, s64 count) {
+  s64 at  = first;
+  s64 end = first + count;
+  while(at < end) {
+    s64 bit     = at%64;
+    s64 in_word = Min(64 - bit, end - at);
+    u64 mask    = (in_word == 64) ? ~0ULL : (((1ULL << in_word) - 1) << bit);
+    words[at/64] |= mask;
+    at += in_word;
+  }
+}
+
+void bit_set_clear(u64* words, s64 bit_count) {
+  zero_memory((u8*)words, BIT_SET_WORD_COUNT(bit_count)*sizeof(u64));
+}
+
+s32 bit_set_count(u64* words, s64 bit_count) {
+  s32 r = 0;
+  Loop(i, BIT_SET_WORD_COUNT(bit_count)) r += count_set_bits_u64(words[i]);
+  return r;
+}
+
+// Returns the index of the first set bit at or after 'from', or bit_count if there is none.
+// Empty words are skipped 64 bits at a time.
+s64 bit_set_next(u64* words, s64 bit_count, s64 from) {
+  if(from >= bit_count) return bit_count;
+
+  s64 word_count = BIT_SET_WORD_COUNT(bit_count);
+  s64 word_index = from/64;
+  u64 bits = words[word_index] & (~0ULL << (from%64));
+
+  while(!bits) {
+    word_index += 1;
+    if(word_index >= word_count) return bit_count;
+    bits = words[word_index];
+  }
+
+  s64 r = word_index*64 + find_first_set_bit_u64(bits);
+  return r;
+}
+
+// Iterates the indices of all set bits, it's fine to unset the current bit inside the loop.
+#define LoopBits(var_name, words, bit_count) \
+  for(s64 var_name = bit_set_next(words, bit_count, 0); var_name < (bit_count); var_name = bit_set_next(words, bit_count, var_name + 1))
+
+// The same for the set bits in [first, end), bit_count of the set has to be at least end.
+#define LoopBitsRange(var_name, words, first, end) \
+  for(s64 var_name = bit_set_next(words, end, first); var_name < (end); var_name = bit_set_next(words, end, var_name + 1))
@@ -0,0 +1,294 @@
+//
+// Contacts
+//
+// Finds the overlapping pairs between two sets of bodies, A and B. The x range is cut into
+// strips and each body is binned into the strips it spans. Strips are tested on the job
+// system, each worker gathers its pairs in a small chunk on the stack and copies full
+// chunks into one shared array. That array is sorted by (A id, B id), so the result is the
+// same for any number of workers.
+//
+// A pair that spans several strips is only reported by the strip holding the left edge of
+// the overlap.
+//
+// Most passes only want some of the pairs, see Contact_Report. Cutting them while testing
+// keeps the worst case small enough that the shared array always has room for it.
+//
+
+// Which side, if any, is a capsule swept from start to end. Everything else is a circle.
+enum Contact_Test {
+  Contact_Test_Circles,
+  Contact_Test_Swept_A,
+  Contact_Test_Swept_B,
+};
+
+// Which of the overlapping pairs a pass gets. Per strip, so a body spanning several strips
+// can still come up in more than one pair.
+enum Contact_Report {
+  Contact_Report_All,
+  Contact_Report_First_B_Per_A, // only the B with the lowest id per A
+  Contact_Report_Any_A_Per_B,   // one A per B, whichever is found first
+};
+
+struct Contact_Body {
+  u32 id;
+  Vec2 start, end; // the path swept this tick, the same point for a plain circle
+  f32 radius;
+
+  f32 min_x, max_x, min_y, max_y;
+};
+
+#define CONTACT_CHUNK_SIZE 256
+
+// A worker's pairs before they go into the shared array.
+struct Contact_Chunk {
+  u64 keys[CONTACT_CHUNK_SIZE];
+  s32 count;
+};
+
+struct Contact_System {
+  Contact_Body* a;
+  Contact_Body* b;
+  s32 a_count, b_count;
+  s32 body_capacity;
+  Contact_Test test;
+  Contact_Report report;
+
+  f32 min_x, max_x;
+  s32 strip_count;
+  s32* strip_first_a; // strip_count + 1 offsets into strip_a
+  s32* strip_first_b;
+  s32* strip_a;       // body indices by strip
+  s32* strip_b;
+
+  u64* keys;
+  u32* order;
+  u64* tmp_keys;
+  u32* tmp_order;
+  s32 pair_capacity;
+
+  volatile s32 pair_count; // slots handed out, can go past pair_capacity
+  volatile s32 dropped;    // pairs that didn't fit in the last pass
+};
+
+// Sorted by A then B.
+struct Contact_Pairs {
+  u64* keys;
+  s32 count;
+};
+
+global_var Contact_System global_contact_system;
+
+u32 contact_a(u64 key) { return (u32)(key >> 32); }
+u32 contact_b(u64 key) { return (u32)key; }
+
+void contact_system_init(Allocator* allocator, s32 body_capacity, s32 pair_capacity, f32 min_x, f32 max_x, s32 strip_count) {
+  Contact_System* cs = &global_contact_system;
+  *cs = {};
+
+  cs->body_capacity = body_capacity;
+  cs->a = allocator_alloc_array(allocator, Contact_Body, body_capacity);
+  cs->b = allocator_alloc_array(allocator, Contact_Body, body_capacity);
+
+  cs->min_x = min_x;
+  cs->max_x = max_x;
+  cs->strip_count = strip_count;
+  cs->strip_first_a = allocator_alloc_array(allocator, s32, strip_count + 1);
+  cs->strip_first_b = allocator_alloc_array(allocator, s32, strip_count + 1);
+  cs->strip_a = allocator_alloc_array(allocator, s32, body_capacity*strip_count);
+  cs->strip_b = allocator_alloc_array(allocator, s32, body_capacity*strip_count);
+
+  cs->pair_capacity = pair_capacity;
+  cs->keys      = allocator_alloc_array(allocator, u64, pair_capacity);
+  cs->order     = allocator_alloc_array(allocator, u32, pair_capacity);
+  cs->tmp_keys  = allocator_alloc_array(allocator, u64, pair_capacity);
+  cs->tmp_order = allocator_alloc_array(allocator, u32, pair_capacity);
+}
+
+void contact_pass_begin(Contact_Test test, Contact_Report report) {
+  Contact_System* cs = &global_contact_system;
+  cs->a_count = 0;
+  cs->b_count = 0;
+  cs->test = test;
+  cs->report = report;
+}
+
+void contact_body_set(Contact_Body* body, u32 id, Vec2 start, Vec2 end, f32 radius) {
+  body->id     = id;
+  body->start  = start;
+  body->end    = end;
+  body->radius = radius;
+  body->min_x  = Min(start.x, end.x) - radius;
+  body->max_x  = Max(start.x, end.x) + radius;
+  body->min_y  = Min(start.y, end.y) - radius;
+  body->max_y  = Max(start.y, end.y) + radius;
+}
+
+void contact_add_a(u32 id, Vec2 start, Vec2 end, f32 radius) {
+  Contact_System* cs = &global_contact_system;
+  Assert(cs->a_count < cs->body_capacity);
+  contact_body_set(&cs->a[cs->a_count++], id, start, end, radius);
+}
+
+void contact_add_b(u32 id, Vec2 start, Vec2 end, f32 radius) {
+  Contact_System* cs = &global_contact_system;
+  Assert(cs->b_count < cs->body_capacity);
+  contact_body_set(&cs->b[cs->b_count++], id, start, end, radius);
+}
+
+s32 contact_strip_of(f32 x) {
+  Contact_System* cs = &global_contact_system;
+  f32 t = (x - cs->min_x)/(cs->max_x - cs->min_x);
+  s32 r = Clamp((s32)floorf(t*(f32)cs->strip_count), 0, cs->strip_count - 1);
+  return r;
+}
+
+// Counting sort of the bodies into the strips they overlap.
+void contact_bin_bodies(Contact_Body* bodies, s32 body_count, s32* strip_first, s32* strip_bodies) {
+  Contact_System* cs = &global_contact_system;
+
+  Loop(i, cs->strip_count + 1) strip_first[i] = 0;
+  Loop(i, body_count) {
+    s32 s0 = contact_strip_of(bodies[i].min_x);
+    s32 s1 = contact_strip_of(bodies[i].max_x);
+    for(s32 s = s0; s <= s1; s++) strip_first[s + 1] += 1;
+  }
+  Loop(s, cs->strip_count) strip_first[s + 1] += strip_first[s];
+
+  s32 at[256];
+  Assert(cs->strip_count <= (s32)ArrayCount(at));
+  Loop(s, cs->strip_count) at[s] = strip_first[s];
+
+  Loop(i, body_count) {
+    s32 s0 = contact_strip_of(bodies[i].min_x);
+    s32 s1 = contact_strip_of(bodies[i].max_x);
+    for(s32 s = s0; s <= s1; s++) strip_bodies[at[s]++] = (s32)i;
+  }
+}
+
+// Whether a and b overlap and strip s is the one to report them.
+b32 contact_hit(Contact_Body* a, Contact_Body* b, s32 s) {
+  Contact_System* cs = &global_contact_system;
+
+  if(a->max_x < b->min_x || b->max_x < a->min_x) return false;
+  if(a->max_y < b->min_y || b->max_y < a->min_y) return false;
+  if(contact_strip_of(Max(a->min_x, b->min_x)) != s) return false;
+
+  b32 r = false;
+  switch(cs->test) {
+    case Contact_Test_Circles: { r = vec2_length(a->start - b->start) <= a->radius + b->radius;          } break;
+    case Contact_Test_Swept_A: { r = capsule_vs_circle(a->start, a->end, a->radius, b->start, b->radius); } break;
+    case Contact_Test_Swept_B: { r = capsule_vs_circle(b->start, b->end, b->radius, a->start, a->radius); } break;
+  }
+  return r;
+}
+
+// Pairs past pair_capacity are dropped and counted.
+void contact_flush(Contact_Chunk* chunk) {
+  Contact_System* cs = &global_contact_system;
+
+  s32 first = atomic_add_s32(&cs->pair_count, chunk->count);
+  s32 fit_count = Clamp(cs->pair_capacity - first, 0, chunk->count);
+  Loop(i, fit_count) cs->keys[first + i] = chunk->keys[i];
+
+  if(fit_count < chunk->count) atomic_add_s32(&cs->dropped, chunk->count - fit_count);
+  chunk->count = 0;
+}
+
+void contact_emit(Contact_Chunk* chunk, Contact_Body* a, Contact_Body* b) {
+  if(chunk->count == CONTACT_CHUNK_SIZE) contact_flush(chunk);
+  chunk->keys[chunk->count++] = ((u64)a->id << 32) | (u64)b->id;
+}
+
+void contact_test_strips(void* data, s32 first, s32 end) {
+  Contact_System* cs = &global_contact_system;
+
+  Contact_Chunk chunk;
+  chunk.count = 0;
+
+  for(s32 s = first; s < end; s++) {
+    s32* strip_a = cs->strip_a + cs->strip_first_a[s];
+    s32* strip_b = cs->strip_b + cs->strip_first_b[s];
+    s32 a_count = cs->strip_first_a[s + 1] - cs->strip_first_a[s];
+    s32 b_count = cs->strip_first_b[s + 1] - cs->strip_first_b[s];
+
+    switch(cs->report) {
+      case Contact_Report_All: {
+        Loop(ia, a_count) {
+          Contact_Body* a = &cs->a[strip_a[ia]];
+          Loop(ib, b_count) {
+            Contact_Body* b = &cs->b[strip_b[ib]];
+            if(contact_hit(a, b, s)) contact_emit(&chunk, a, b);
+          }
+        }
+      } break;
+
+      case Contact_Report_First_B_Per_A: {
+        Loop(ia, a_count) {
+          Contact_Body* a = &cs->a[strip_a[ia]];
+          Contact_Body* first_b = NULL;
+          Loop(ib, b_count) {
+            Contact_Body* b = &cs->b[strip_b[ib]];
+            if(first_b && b->id >= first_b->id) continue;
+            if(contact_hit(a, b, s)) first_b = b;
+          }
+          if(first_b) contact_emit(&chunk, a, first_b);
+        }
+      } break;
+
+      case Contact_Report_Any_A_Per_B: {
+        Loop(ib, b_count) {
+          Contact_Body* b = &cs->b[strip_b[ib]];
+          Loop(ia, a_count) {
+            Contact_Body* a = &cs->a[strip_a[ia]];
+            if(contact_hit(a, b, s)) {
+              contact_emit(&chunk, a, b);
+              break;
+            }
+          }
+        }
+      } break;
+    }
+  }
+
+  if(chunk.count) contact_flush(&chunk);
+}
+
+// The most pairs the current pass can report, one per A or B and strip when cut.
+s32 contact_pair_bound(void) {
+  Contact_System* cs = &global_contact_system;
+
+  s32 r = 0;
+  switch(cs->report) {
+    case Contact_Report_All:           { r = cs->a_count*cs->b_count;              } break;
+    case Contact_Report_First_B_Per_A: { r = cs->strip_first_a[cs->strip_count];   } break;
+    case Contact_Report_Any_A_Per_B:   { r = cs->strip_first_b[cs->strip_count];   } break;
+  }
+  return r;
+}
+
+// The overlapping (A, B) pairs of the current pass, the ones its Contact_Report asks for.
+Contact_Pairs contact_pass_run(void) {
+  Contact_System* cs = &global_contact_system;
+
+  contact_bin_bodies(cs->a, cs->a_count, cs->strip_first_a, cs->strip_a);
+  contact_bin_bodies(cs->b, cs->b_count, cs->strip_first_b, cs->strip_b);
+  Assert(contact_pair_bound() <= cs->pair_capacity);
+
+  cs->pair_count = 0;
+  cs->dropped = 0;
+
+  if(cs->a_count + cs->b_count >= job_parallel_threshold()) job_run_parallel(contact_test_strips, NULL, cs->strip_count, 1);
+  else                                                      contact_test_strips(NULL, 0, cs->strip_count);
+
+  if(cs->dropped) {
+    TraceLog(LOG_WARNING, "CONTACTS: %d pairs didn't fit in %d", cs->dropped, cs->pair_capacity);
+    Assert(!"contact pairs dropped");
+  }
+
+  s32 count = Min(cs->pair_count, cs->pair_capacity);
+  Loop(i, count) cs->order[i] = (u32)i;
+  radix_sort_u64(cs->keys, cs->order, cs->tmp_keys, cs->tmp_order, count);
+
+  Contact_Pairs r = {cs->keys, count};
+  return r;
+}
@@ -0,0 +1,142 @@
+//
+// CPU features
+//
+// The SIMD kernels are picked once at startup. GAME_SSE2 only says the SSE2 versions can
+// be compiled, cpuid says whether the machine we're on can run them. Every kernel keeps
+// its scalar version as the reference, forcing the scalar path (FORCE_SCALAR_KERNELS or
+// the GAME_FORCE_SCALAR environment variable) runs the game on those. GAME_FORCE_SSE2
+// stops at SSE2 on a machine with AVX2.
+//
+// GAME_SSE2 comes from the compiler's target, which means the compiler is free to use SSE2
+// anywhere else too, so its cpuid check is a formality. AVX2 is not assumed: the AVX2
+// kernels are compiled one function at a time with AVX2_FUNCTION while the rest of the
+// game stays on the baseline, and only run when cpuid and the OS say the machine can.
+// They don't use FMA, so they give the same bits as the scalar and SSE2 versions.
+//
+
+#if defined(_M_X64) || defined(_M_IX86)
+#define GAME_X86 1
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#define GAME_X86 1
+#include <cpuid.h>
+#else
+#define GAME_X86 0
+#endif
+
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GAME_SSE2 1
+#include <emmintrin.h>
+#else
+#define GAME_SSE2 0
+#endif
+
+// MSVC takes AVX2 intrinsics in any function, GCC and clang need the target on each one.
+#if GAME_SSE2 && GAME_X86 && !defined(GAME_NO_AVX2)
+#define GAME_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#else
+#define GAME_AVX2 0
+#endif
+
+// Fixed point kinematics and table trig, so replays and lockstep give the same ticks
+// across compilers and instruction sets, see game_fixed.cpp. The rest of the simulation
+// stays in float, which is only the same everywhere as long as a*b + c isn't contracted
+// into an fma. The build scripts make sure of that with -fp:precise for cl and
+// -ffp-contract=off for emcc, pass the same to gcc and clang. The pragmas below are only
+// a fallback for builds that don't, GCC ignores the STDC one and its optimize pragma isn't
+// meant for release builds.
+#ifndef GAME_DETERMINISTIC
+#define GAME_DETERMINISTIC 0
+#endif
+
+#if GAME_DETERMINISTIC
+#if defined(_MSC_VER)
+#pragma fp_contract(off)
+#elif defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+#endif
+
+enum Simd_Level {
+  Simd_Level_Scalar,
+  Simd_Level_SSE2,
+  Simd_Level_AVX2,
+
+  Simd_Level_Count
+};
+
+char* simd_level_names[Simd_Level_Count] = {
+  "scalar",
+  "sse2",
+  "avx2",
+};
+
+b32 cpu_has_sse2(void) {
+#if GAME_X86 && defined(_MSC_VER)
+  int regs[4] = {};
+  __cpuid(regs, 1);
+  return (regs[3] >> 26) & 1;
+#elif GAME_X86
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+  return (edx >> 26) & 1;
+#else
+  return false;
+#endif
+}
+
+// The cpu has AVX2 and the OS saves the ymm registers on a context switch.
+b32 cpu_has_avx2(void) {
+#if GAME_X86 && defined(_MSC_VER)
+  int regs[4] = {};
+  __cpuid(regs, 0);
+  if(regs[0] < 7) return false;
+  
+  __cpuid(regs, 1);
+  b32 has_avx = ((regs[2] >> 27) & 1) && ((regs[2] >> 28) & 1); // OSXSAVE and AVX
+  if(!has_avx || (_xgetbv(0) & 6) != 6) return false;
+  
+  __cpuidex(regs, 7, 0);
+  return (regs[1] >> 5) & 1;
+#elif GAME_X86
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+  b32 has_avx = ((ecx >> 27) & 1) && ((ecx >> 28) & 1); // OSXSAVE and AVX
+  if(!has_avx) return false;
+  
+  // xgetbv by hand, the intrinsic wants the xsave target
+  unsigned int xcr0 = 0, xcr0_high = 0;
+  __asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(xcr0_high) : "c"(0));
+  if((xcr0 & 6) != 6) return false;
+  
+  if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+  return (ebx >> 5) & 1;
+#else
+  return false;
+#endif
+}
+
+// The best level that is both compiled in and supported by this cpu.
+Simd_Level cpu_simd_level(b32 force_scalar) {
+  if(force_scalar) return Simd_Level_Scalar;
+
+  char* env = getenv("GAME_FORCE_SCALAR");
+  if(env && env[0] && env[0] != '0') return Simd_Level_Scalar;
+
+  env = getenv("GAME_FORCE_SSE2");
+  b32 force_sse2 = env && env[0] && env[0] != '0';
+  
+  if(GAME_AVX2 && !force_sse2 && cpu_has_sse2() && cpu_has_avx2()) return Simd_Level_AVX2;
+  if(GAME_SSE2 && cpu_has_sse2()) return Simd_Level_SSE2;
+  return Simd_Level_Scalar;
+}
@@ -0,0 +1,134 @@
+//
+// Fixed point
+//
+// 16.16 numbers and table trig for GAME_DETERMINISTIC builds. Integer math comes out the
+// same with any compiler, instruction set and libm, so a simulation that keeps its state
+// in these gives the same ticks on every build.
+//
+// The tables are filled once at startup from the float polynomials in game_math, so they
+// are only the same on builds that round every float op to single precision and don't
+// contract into fmas: SSE2 rather than x87, and -ffp-contract=off or -fp:precise the way
+// the build scripts compile.
+//
+
+typedef s32 Fixed;
+
+#define FIXED_SHIFT 16
+#define FIXED_ONE   (1 << FIXED_SHIFT)
+#define FIXED_PI      205887  // pi*2^16
+#define FIXED_HALF_PI 102944
+
+#define FIXED_INV_TWO_PI_32 683565276LL  // 2^32/(2*pi), radians in 16.16 to turns in 16.32
+
+// |value| < 32768.
+Fixed fixed_from_f32(f32 value) {
+  Fixed r = (Fixed)floorf(value*(f32)FIXED_ONE + 0.5f);
+  return r;
+}
+
+f32 f32_from_fixed(Fixed value) {
+  f32 r = (f32)value*(1.0f/(f32)FIXED_ONE);
+  return r;
+}
+
+Fixed fixed_mul(Fixed a, Fixed b) {
+  Fixed r = (Fixed)(((s64)a*(s64)b) >> FIXED_SHIFT);
+  return r;
+}
+
+Fixed fixed_div(Fixed a, Fixed b) {
+  Assert(b != 0);
+  Fixed r = (Fixed)(((s64)a << FIXED_SHIFT)/b);
+  return r;
+}
+
+//
+// Tables
+//
+
+#define FIXED_SIN_TABLE_BITS 10                         // entries per turn
+#define FIXED_SIN_TABLE_SIZE (1 << FIXED_SIN_TABLE_BITS)
+#define FIXED_ATAN_TABLE_BITS 8                         // entries over [0, 1]
+#define FIXED_ATAN_TABLE_SIZE (1 << FIXED_ATAN_TABLE_BITS)
+
+// One extra entry at the end so the lerp never wraps.
+global_var Fixed global_fixed_sin_table[FIXED_SIN_TABLE_SIZE + 1];
+global_var Fixed global_fixed_atan_table[FIXED_ATAN_TABLE_SIZE + 1];
+
+// cephes atanf on [0, 1].
+f32 fixed_atan_poly(f32 x) {
+  f32 y0 = 0.0f;
+  if(x > 0.414213562f) {
+    y0 = 0.785398163f;
+    x  = (x - 1.0f)/(x + 1.0f);
+  }
+  f32 z = x*x;
+  f32 r = y0 + x + x*z*(-3.33329491539e-1f + z*(1.99777106478e-1f + z*(-1.38776856032e-1f + z*8.05374449538e-2f)));
+  return r;
+}
+
+void fixed_tables_init(void) {
+  Loop(i, FIXED_SIN_TABLE_SIZE + 1) {
+    f32 s, c;
+    trig_sincos_poly((f32)i*(2.0f*3.14159265f/(f32)FIXED_SIN_TABLE_SIZE), &s, &c, Trig_Accuracy_High);
+    global_fixed_sin_table[i] = fixed_from_f32(s);
+  }
+  Loop(i, FIXED_ATAN_TABLE_SIZE + 1) {
+    global_fixed_atan_table[i] = fixed_from_f32(fixed_atan_poly((f32)i/(f32)FIXED_ATAN_TABLE_SIZE));
+  }
+}
+
+// phase is a fraction of a turn in 32 bits, so it wraps around on its own.
+Fixed fixed_sin_phase(u32 phase) {
+  s32 frac_bits = 32 - FIXED_SIN_TABLE_BITS;
+  u32 i    = phase >> frac_bits;
+  s64 frac = (s64)(phase & ((1u << frac_bits) - 1));
+
+  Fixed a = global_fixed_sin_table[i];
+  Fixed b = global_fixed_sin_table[i + 1];
+  Fixed r = a + (Fixed)(((s64)(b - a)*frac) >> frac_bits);
+  return r;
+}
+
+void fixed_sincos(Fixed angle, Fixed* sin_out, Fixed* cos_out) {
+  u32 phase = (u32)(((s64)angle*FIXED_INV_TWO_PI_32) >> FIXED_SHIFT);
+  *sin_out = fixed_sin_phase(phase);
+  *cos_out = fixed_sin_phase(phase + (1u << 30));
+}
+
+// atan of the ratio in [0, 1] from the table, then mirrored into the right octant.
+Fixed fixed_atan2(Fixed y, Fixed x) {
+  if(x == 0 && y == 0) return 0;
+
+  s64 ax = x < 0 ? -(s64)x : (s64)x;
+  s64 ay = y < 0 ? -(s64)y : (s64)y;
+
+  b32 steep = ay > ax;
+  s64 t = steep ? (ax << FIXED_SHIFT)/ay : (ay << FIXED_SHIFT)/ax;
+
+  s32 frac_bits = FIXED_SHIFT - FIXED_ATAN_TABLE_BITS;
+  s32 i    = (s32)(t >> frac_bits);
+  s32 frac = (s32)(t & ((1 << frac_bits) - 1));
+  if(i == FIXED_ATAN_TABLE_SIZE) { i -= 1; frac = 1 << frac_bits; }
+
+  Fixed a = global_fixed_atan_table[i];
+  Fixed b = global_fixed_atan_table[i + 1];
+  Fixed r = a + (((b - a)*frac) >> frac_bits);
+
+  if(steep)  r = FIXED_HALF_PI - r;
+  if(x < 0)  r = FIXED_PI - r;
+  if(y < 0)  r = -r;
+  return r;
+}
+
+void fixed_sincos_f32(f32 angle, f32* sin_out, f32* cos_out) {
+  Fixed s, c;
+  fixed_sincos(fixed_from_f32(angle), &s, &c);
+  *sin_out = f32_from_fixed(s);
+  *cos_out = f32_from_fixed(c);
+}
+
+f32 fixed_atan2_f32(f32 y, f32 x) {
+  f32 r = f32_from_fixed(fixed_atan2(fixed_from_f32(y), fixed_from_f32(x)));
+  return r;
+}
@@ -0,0 +1,86 @@
+//
+// Hash
+//
+// xxHash64 (Collet). The four accumulators take one u64 of every 32 byte stripe each and
+// don't depend on each other, so the cpu already runs them side by side. There's no SSE2
+// version, SSE2 can't multiply 64 or even 32 bit lanes and an emulated multiply came out
+// slower than this. Assumes a little endian machine like everything else here.
+//
+
+#include <string.h>
+
+#define HASH_PRIME64_1 0x9e3779b185ebca87ULL
+#define HASH_PRIME64_2 0xc2b2ae3d27d4eb4fULL
+#define HASH_PRIME64_3 0x165667b19e3779f9ULL
+#define HASH_PRIME64_4 0x85ebca77c2b2ae63ULL
+#define HASH_PRIME64_5 0x27d4eb2f165667c5ULL
+
+u64 hash_rotl64(u64 x, s32 k) { return (x << k) | (x >> (64 - k)); }
+
+u64 hash_read64(u8* p) { u64 r; memcpy(&r, p, sizeof(r)); return r; }
+u32 hash_read32(u8* p) { u32 r; memcpy(&r, p, sizeof(r)); return r; }
+
+u64 hash_round(u64 acc, u64 input) {
+  acc += input*HASH_PRIME64_2;
+  acc  = hash_rotl64(acc, 31);
+  acc *= HASH_PRIME64_1;
+  return acc;
+}
+
+u64 hash_merge_round(u64 h, u64 acc) {
+  h ^= hash_round(0, acc);
+  h  = h*HASH_PRIME64_1 + HASH_PRIME64_4;
+  return h;
+}
+
+u64 hash64(void* data, s64 size, u64 seed = 0) {
+  u8* p   = (u8*)data;
+  u8* end = p + size;
+  u64 h;
+
+  if(size >= 32) {
+    u64 v1 = seed + HASH_PRIME64_1 + HASH_PRIME64_2;
+    u64 v2 = seed + HASH_PRIME64_2;
+    u64 v3 = seed;
+    u64 v4 = seed - HASH_PRIME64_1;
+
+    for(; p + 32 <= end; p += 32) {
+      v1 = hash_round(v1, hash_read64(p +  0));
+      v2 = hash_round(v2, hash_read64(p +  8));
+      v3 = hash_round(v3, hash_read64(p + 16));
+      v4 = hash_round(v4, hash_read64(p + 24));
+    }
+
+    h = hash_rotl64(v1, 1) + hash_rotl64(v2, 7) + hash_rotl64(v3, 12) + hash_rotl64(v4, 18);
+    h = hash_merge_round(h, v1);
+    h = hash_merge_round(h, v2);
+    h = hash_merge_round(h, v3);
+    h = hash_merge_round(h, v4);
+  }
+  else {
+    h = seed + HASH_PRIME64_5;
+  }
+
+  h += (u64)size;
+
+  for(; p + 8 <= end; p += 8) {
+    h ^= hash_round(0, hash_read64(p));
+    h  = hash_rotl64(h, 27)*HASH_PRIME64_1 + HASH_PRIME64_4;
+  }
+  if(p + 4 <= end) {
+    h ^= (u64)hash_read32(p)*HASH_PRIME64_1;
+    h  = hash_rotl64(h, 23)*HASH_PRIME64_2 + HASH_PRIME64_3;
+    p += 4;
+  }
+  for(; p < end; p += 1) {
+    h ^= (*p)*HASH_PRIME64_5;
+    h  = hash_rotl64(h, 11)*HASH_PRIME64_1;
+  }
+
+  h ^= h >> 33;
+  h *= HASH_PRIME64_2;
+  h ^= h >> 29;
+  h *= HASH_PRIME64_3;
+  h ^= h >> 32;
+  return h;
+}
@@ -0,0 +1,328 @@
+//
+// Jobs
+//
+// A fixed pool of worker threads for data parallel passes over the simulation. The thread
+// that calls parallel_for is worker 0 and works along until the pass is done.
+//
+// parallel_for cuts [0, count) into chunks of 'grain' elements and deals them out evenly,
+// every worker has its own deque of chunk indices. A worker takes chunks from the front of
+// its own deque and once that's empty steals from the back of the others. A deque is a
+// [first, end) pair packed into one u64, so taking from either end is one compare exchange.
+//
+// The web build has no threads, there everything runs on the calling thread.
+//
+
+#define MAX_JOB_WORKERS 16
+
+#if defined(PLATFORM_WEB)
+#define JOB_SYSTEM_HAS_THREADS 0
+#else
+#define JOB_SYSTEM_HAS_THREADS 1
+#endif
+
+#if JOB_SYSTEM_HAS_THREADS && defined(_WIN32)
+
+// Declared here instead of including windows.h, which clashes with raylib.h.
+extern "C" {
+  __declspec(dllimport) void* __stdcall CreateSemaphoreA(void* attributes, long initial_count, long max_count, const char* name);
+  __declspec(dllimport) int   __stdcall ReleaseSemaphore(void* semaphore, long release_count, long* previous_count);
+  __declspec(dllimport) unsigned long __stdcall WaitForSingleObject(void* handle, unsigned long milliseconds);
+  __declspec(dllimport) void* __stdcall CreateThread(void* attributes, size_t stack_size, unsigned long (__stdcall *start)(void*), void* param, unsigned long flags, unsigned long* thread_id);
+  __declspec(dllimport) int   __stdcall CloseHandle(void* handle);
+  __declspec(dllimport) int   __stdcall SwitchToThread(void);
+  __declspec(dllimport) unsigned long __stdcall GetActiveProcessorCount(unsigned short group);
+}
+
+struct Job_Semaphore {
+  void* handle;
+};
+
+void job_semaphore_init(Job_Semaphore* s) { s->handle = CreateSemaphoreA(NULL, 0, 0x7fffffff, NULL); }
+void job_semaphore_signal(Job_Semaphore* s, s32 count) { ReleaseSemaphore(s->handle, count, NULL); }
+void job_semaphore_wait(Job_Semaphore* s) { WaitForSingleObject(s->handle, 0xffffffff); }
+
+void job_yield(void) { SwitchToThread(); }
+
+s32 job_processor_count(void) {
+  s32 r = (s32)GetActiveProcessorCount(0xffff);
+  return r;
+}
+
+void job_worker_main(s32 index);
+
+unsigned long __stdcall job_thread_proc(void* param) {
+  job_worker_main((s32)(s64)param);
+  return 0;
+}
+
+void job_thread_start(s32 index) {
+  void* thread = CreateThread(NULL, 0, job_thread_proc, (void*)(s64)index, 0, NULL);
+  Assert(thread);
+  CloseHandle(thread);
+}
+
+#elif JOB_SYSTEM_HAS_THREADS
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+// Counting semaphore out of a mutex and a condition variable, unnamed posix semaphores
+// aren't there everywhere.
+struct Job_Semaphore {
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
+  s32 count;
+};
+
+void job_semaphore_init(Job_Semaphore* s) {
+  pthread_mutex_init(&s->mutex, NULL);
+  pthread_cond_init(&s->cond, NULL);
+  s->count = 0;
+}
+
+void job_semaphore_signal(Job_Semaphore* s, s32 count) {
+  pthread_mutex_lock(&s->mutex);
+  s->count += count;
+  pthread_cond_broadcast(&s->cond);
+  pthread_mutex_unlock(&s->mutex);
+}
+
+void job_semaphore_wait(Job_Semaphore* s) {
+  pthread_mutex_lock(&s->mutex);
+  while(s->count == 0) pthread_cond_wait(&s->cond, &s->mutex);
+  s->count -= 1;
+  pthread_mutex_unlock(&s->mutex);
+}
+
+void job_yield(void) { sched_yield(); }
+
+s32 job_processor_count(void) {
+  s32 r = (s32)sysconf(_SC_NPROCESSORS_ONLN);
+  return r;
+}
+
+void job_worker_main(s32 index);
+
+void* job_thread_proc(void* param) {
+  job_worker_main((s32)(s64)param);
+  return NULL;
+}
+
+void job_thread_start(s32 index) {
+  pthread_t thread;
+  s32 error = pthread_create(&thread, NULL, job_thread_proc, (void*)(s64)index);
+  Assert(error == 0);
+  pthread_detach(thread);
+}
+
+#else
+
+struct Job_Semaphore {
+  s32 unused;
+};
+
+void job_semaphore_init(Job_Semaphore* s) {}
+void job_semaphore_signal(Job_Semaphore* s, s32 count) {}
+void job_yield(void) {}
+s32  job_processor_count(void) { return 1; }
+
+#endif
+
+// Called with the elements [first, end) of the pass.
+typedef void Parallel_For_Proc(void* data, s32 first, s32 end);
+
+struct Job_Deque {
+  volatile u64 range; // first chunk in the low half, end in the high half
+  u8 pad[56];         // one deque per cache line
+};
+
+struct Job_System {
+  volatile s32 worker_count; // including the main thread
+  s32 started_count;         // workers there are threads for, see job_system_use_workers
+  s32 parallel_threshold;    // passes over fewer elements stay on the calling thread
+  b32 is_running;
+
+  Job_Deque deques[MAX_JOB_WORKERS];
+
+  // the pass that's running, written before the deques are filled
+  Parallel_For_Proc* proc;
+  void* data;
+  s32 count;
+  s32 grain;
+  volatile s32 chunks_left;
+
+  Job_Semaphore wake;
+};
+
+global_var Job_System global_job_system;
+
+// 0 on the main thread.
+global_var thread_var s32 job_worker_index;
+
+u64 job_deque_pack(u32 first, u32 end) { return (u64)first | ((u64)end << 32); }
+
+// The owner takes from the front.
+b32 job_deque_pop(Job_Deque* deque, s32* chunk) {
+  for(;;) {
+    u64 range = atomic_load_u64(&deque->range);
+    u32 first = (u32)range;
+    u32 end   = (u32)(range >> 32);
+    if(first >= end) return false;
+
+    if(atomic_compare_exchange_u64(&deque->range, range, job_deque_pack(first + 1, end))) {
+      *chunk = (s32)first;
+      return true;
+    }
+  }
+}
+
+// Everybody else from the back.
+b32 job_deque_steal(Job_Deque* deque, s32* chunk) {
+  for(;;) {
+    u64 range = atomic_load_u64(&deque->range);
+    u32 first = (u32)range;
+    u32 end   = (u32)(range >> 32);
+    if(first >= end) return false;
+
+    if(atomic_compare_exchange_u64(&deque->range, range, job_deque_pack(first, end - 1))) {
+      *chunk = (s32)(end - 1);
+      return true;
+    }
+  }
+}
+
+b32 job_take_chunk(s32 worker, s32* chunk) {
+  Job_System* js = &global_job_system;
+
+  if(job_deque_pop(&js->deques[worker], chunk)) return true;
+
+  // A worker that wakes late can still be looking while the count changes.
+  s32 worker_count = atomic_load_s32(&js->worker_count);
+  for(s32 i = 1; i < worker_count; i++) {
+    s32 victim = (worker + i) % worker_count;
+    if(job_deque_steal(&js->deques[victim], chunk)) return true;
+  }
+  return false;
+}
+
+void job_run_chunks(s32 worker) {
+  Job_System* js = &global_job_system;
+
+  s32 chunk = 0;
+  while(job_take_chunk(worker, &chunk)) {
+    s32 first = chunk*js->grain;
+    s32 end   = Min(first + js->grain, js->count);
+    js->proc(js->data, first, end);
+
+    atomic_add_s32(&js->chunks_left, -1);
+  }
+}
+
+#if JOB_SYSTEM_HAS_THREADS
+void job_worker_main(s32 index) {
+  Job_System* js = &global_job_system;
+
+  job_worker_index = index;
+  
+  for(;;) {
+    job_semaphore_wait(&js->wake);
+    job_run_chunks(index);
+  }
+}
+#endif
+
+// worker_count 0 means one per processor.
+void job_system_init(s32 worker_count, s32 parallel_threshold) {
+  Job_System* js = &global_job_system;
+  *js = {};
+
+  if(worker_count <= 0) worker_count = job_processor_count();
+  if(!JOB_SYSTEM_HAS_THREADS) worker_count = 1;
+  worker_count = Clamp(worker_count, 1, MAX_JOB_WORKERS);
+
+  js->worker_count  = worker_count;
+  js->started_count = worker_count;
+  js->parallel_threshold = parallel_threshold;
+  job_semaphore_init(&js->wake);
+
+#if JOB_SYSTEM_HAS_THREADS
+  for(s32 i = 1; i < worker_count; i++) job_thread_start(i);
+#endif
+}
+
+// Passes run on only the first 'count' workers from now on, the threads past that sleep.
+// For measuring how the passes scale, see test_sim.cpp.
+void job_system_use_workers(s32 count) {
+  Job_System* js = &global_job_system;
+  Assert(!js->is_running);
+  atomic_store_s32(&js->worker_count, Clamp(count, 1, js->started_count));
+}
+
+s32 job_worker_count(void)       { return global_job_system.worker_count; }
+s32 job_started_count(void)      { return global_job_system.started_count; }
+s32 job_this_worker(void)        { return job_worker_index; }
+s32 job_parallel_threshold(void) { return global_job_system.parallel_threshold; }
+
+// Runs proc over [0, count) on all workers and returns once every chunk is done. No
+// threshold check, see parallel_for.
+void job_run_parallel(Parallel_For_Proc* proc, void* data, s32 count, s32 grain) {
+  Job_System* js = &global_job_system;
+  Assert(grain > 0);
+
+  // nested passes and single chunks aren't worth waking anyone for
+  if(js->worker_count <= 1 || js->is_running || count <= grain) {
+    if(count > 0) proc(data, 0, count);
+    return;
+  }
+
+  s32 chunk_count = (count + grain - 1)/grain;
+
+  js->proc  = proc;
+  js->data  = data;
+  js->count = count;
+  js->grain = grain;
+  atomic_store_s32(&js->chunks_left, chunk_count);
+
+  s32 first = 0;
+  Loop(worker, js->worker_count) {
+    s32 n = chunk_count/js->worker_count + (worker < chunk_count%js->worker_count ? 1 : 0);
+    atomic_store_u64(&js->deques[worker].range, job_deque_pack(first, first + n));
+    first += n;
+  }
+
+  js->is_running = true;
+  job_semaphore_signal(&js->wake, js->worker_count - 1);
+
+  job_run_chunks(0);
+
+  // the last chunks may still be running on other workers
+  while(atomic_load_s32(&js->chunks_left) > 0) job_yield();
+
+  js->is_running = false;
+}
+
+void parallel_for(Parallel_For_Proc* proc, void* data, s32 count, s32 grain) {
+  Job_System* js = &global_job_system;
+
+  if(count < js->parallel_threshold) {
+    if(count > 0) proc(data, 0, count);
+    return;
+  }
+  job_run_parallel(proc, data, count, grain);
+}
+
+// For passes over the live objects of a bit set pool. The threshold goes by how many are
+// live and chunks are whole u64 words, so removing an object never writes a word another
+// worker is using.
+void parallel_for_bits(Parallel_For_Proc* proc, void* data, u64* words, s32 bit_count, s32 grain) {
+  Job_System* js = &global_job_system;
+
+  if(bit_set_count(words, bit_count) < js->parallel_threshold) {
+    proc(data, 0, bit_count);
+    return;
+  }
+
+  s32 word_grain = Max(1, (grain + 63)/64)*64;
+  job_run_parallel(proc, data, bit_count, word_grain);
+}
@@ -0,0 +1,252 @@
+//
+// Kinematics
+//
+// Position and velocity of everything that moves, as parallel arrays indexed like the pool
+// they belong to. One step scales the velocity by the friction, moves by it and
+// tests against the screen, four objects at a time with SSE2.
+//
+// With GAME_DETERMINISTIC the arrays hold 16.16 fixed point and there's only the fixed
+// step, the accessors convert to and from floats.
+//
+
+#if GAME_DETERMINISTIC
+typedef Fixed Kinematics_Real;
+Kinematics_Real kinematics_real(f32 value)       { return fixed_from_f32(value); }
+f32 f32_from_kinematics(Kinematics_Real value)   { return f32_from_fixed(value); }
+#else
+typedef f32 Kinematics_Real;
+Kinematics_Real kinematics_real(f32 value)       { return value; }
+f32 f32_from_kinematics(Kinematics_Real value)   { return value; }
+#endif
+
+struct Kinematics {
+  Kinematics_Real* x;  Kinematics_Real* y;
+  Kinematics_Real* vx; Kinematics_Real* vy;
+  Kinematics_Real* dx; Kinematics_Real* dy;  // what the last step moved by, for swept hit tests
+  Kinematics_Real* friction;                 // velocity is scaled by it every step, before moving
+  Kinematics_Real* radius;
+  s32 capacity;
+};
+
+void kinematics_init(Kinematics* k, Allocator* allocator, s32 capacity) {
+  Assert(capacity % 64 == 0);
+
+  *k = {};
+  k->capacity = capacity;
+  k->x        = allocator_alloc_array(allocator, Kinematics_Real, capacity);
+  k->y        = allocator_alloc_array(allocator, Kinematics_Real, capacity);
+  k->vx       = allocator_alloc_array(allocator, Kinematics_Real, capacity);
+  k->vy       = allocator_alloc_array(allocator, Kinematics_Real, capacity);
+  k->dx       = allocator_alloc_array(allocator, Kinematics_Real, capacity);
+  k->dy       = allocator_alloc_array(allocator, Kinematics_Real, capacity);
+  k->friction = allocator_alloc_array(allocator, Kinematics_Real, capacity);
+  k->radius   = allocator_alloc_array(allocator, Kinematics_Real, capacity);
+}
+
+// Puts the object at pos, it hasn't moved yet.
+void kinematics_place(Kinematics* k, s64 i, Vec2 pos, Vec2 vel, f32 friction, f32 radius) {
+  k->x[i]  = kinematics_real(pos.x);  k->y[i]  = kinematics_real(pos.y);
+  k->vx[i] = kinematics_real(vel.x);  k->vy[i] = kinematics_real(vel.y);
+  k->dx[i] = 0;                       k->dy[i] = 0;
+  k->friction[i] = kinematics_real(friction);
+  k->radius[i]   = kinematics_real(radius);
+}
+
+// Dead slots are still stepped with the live ones around them, they shouldn't drift off.
+void kinematics_stop(Kinematics* k, s64 i) {
+  k->vx[i] = 0;
+  k->vy[i] = 0;
+}
+
+Vec2 kinematics_pos(Kinematics* k, s64 i)       { return {f32_from_kinematics(k->x[i]),  f32_from_kinematics(k->y[i])}; }
+Vec2 kinematics_vel(Kinematics* k, s64 i)       { return {f32_from_kinematics(k->vx[i]), f32_from_kinematics(k->vy[i])}; }
+Vec2 kinematics_last_move(Kinematics* k, s64 i) { return {f32_from_kinematics(k->dx[i]), f32_from_kinematics(k->dy[i])}; }
+
+// Moves the object to pos without a step, it keeps its velocity.
+void kinematics_set_pos(Kinematics* k, s64 i, Vec2 pos) {
+  k->x[i]  = kinematics_real(pos.x);  k->y[i]  = kinematics_real(pos.y);
+  k->dx[i] = 0;                       k->dy[i] = 0;
+}
+
+// What the next steps move by, for objects that steer themselves.
+void kinematics_set_vel(Kinematics* k, s64 i, Vec2 vel, f32 friction) {
+  k->vx[i] = kinematics_real(vel.x);  k->vy[i] = kinematics_real(vel.y);
+  k->friction[i] = kinematics_real(friction);
+}
+
+// For pools that swap remove.
+void kinematics_copy(Kinematics* k, s64 to, s64 from) {
+  k->x[to]  = k->x[from];   k->y[to]  = k->y[from];
+  k->vx[to] = k->vx[from];  k->vy[to] = k->vy[from];
+  k->dx[to] = k->dx[from];  k->dy[to] = k->dy[from];
+  k->friction[to] = k->friction[from];
+  k->radius[to]   = k->radius[from];
+}
+
+// The step functions move [first, end) and set the bits of the objects that ended up
+// completely off the [0, view_dim] rect in offscreen_mask, if there is one. first and end
+// are multiples of 64.
+#if GAME_DETERMINISTIC
+void kinematics_step_fixed(Kinematics* k, s32 first, s32 end, f32 delta_time, Vec2 view_dim, u64* offscreen_mask) {
+  Fixed dt = fixed_from_f32(delta_time);
+
+  for(s32 i = first; i < end; i++) {
+    k->vx[i] = fixed_mul(k->vx[i], k->friction[i]);
+    k->vy[i] = fixed_mul(k->vy[i], k->friction[i]);
+
+    k->dx[i] = fixed_mul(k->vx[i], dt);
+    k->dy[i] = fixed_mul(k->vy[i], dt);
+    k->x[i] += k->dx[i];
+    k->y[i] += k->dy[i];
+  }
+
+  if(!offscreen_mask) return;
+
+  Fixed w = fixed_from_f32(view_dim.x);
+  Fixed h = fixed_from_f32(view_dim.y);
+  for(s32 i = first; i < end; i++) {
+    Fixed r = k->radius[i];
+    b32 offscreen = (k->x[i] < -r || k->x[i] > w + r ||
+                     k->y[i] < -r || k->y[i] > h + r);
+
+    if(offscreen) bit_set_set(offscreen_mask, i);
+    else          bit_set_unset(offscreen_mask, i);
+  }
+}
+#else
+void kinematics_step_scalar(Kinematics* k, s32 first, s32 end, f32 delta_time, Vec2 view_dim, u64* offscreen_mask) {
+  for(s32 i = first; i < end; i++) {
+    k->vx[i] *= k->friction[i];
+    k->vy[i] *= k->friction[i];
+
+    k->dx[i] = k->vx[i]*delta_time;
+    k->dy[i] = k->vy[i]*delta_time;
+    k->x[i] += k->dx[i];
+    k->y[i] += k->dy[i];
+  }
+
+  if(!offscreen_mask) return;
+
+  for(s32 i = first; i < end; i++) {
+    f32 r = k->radius[i];
+    b32 offscreen = (k->x[i] < -r || k->x[i] > view_dim.x + r ||
+                     k->y[i] < -r || k->y[i] > view_dim.y + r);
+
+    if(offscreen) bit_set_set(offscreen_mask, i);
+    else          bit_set_unset(offscreen_mask, i);
+  }
+}
+
+#if GAME_SSE2
+void kinematics_step_sse2(Kinematics* k, s32 first, s32 end, f32 delta_time, Vec2 view_dim, u64* offscreen_mask) {
+  __m128 dt = _mm_set1_ps(delta_time);
+  __m128 w  = _mm_set1_ps(view_dim.x);
+  __m128 h  = _mm_set1_ps(view_dim.y);
+  __m128 zero = _mm_setzero_ps();
+
+  for(s32 i = first; i < end; i += 4) {
+    __m128 friction = _mm_loadu_ps(k->friction + i);
+    __m128 vx = _mm_mul_ps(_mm_loadu_ps(k->vx + i), friction);
+    __m128 vy = _mm_mul_ps(_mm_loadu_ps(k->vy + i), friction);
+    __m128 dx = _mm_mul_ps(vx, dt);
+    __m128 dy = _mm_mul_ps(vy, dt);
+    __m128 x  = _mm_add_ps(_mm_loadu_ps(k->x + i), dx);
+    __m128 y  = _mm_add_ps(_mm_loadu_ps(k->y + i), dy);
+
+    _mm_storeu_ps(k->vx + i, vx);
+    _mm_storeu_ps(k->vy + i, vy);
+    _mm_storeu_ps(k->dx + i, dx);
+    _mm_storeu_ps(k->dy + i, dy);
+    _mm_storeu_ps(k->x + i, x);
+    _mm_storeu_ps(k->y + i, y);
+
+    if(offscreen_mask) {
+      __m128 r     = _mm_loadu_ps(k->radius + i);
+      __m128 neg_r = _mm_sub_ps(zero, r);
+
+      __m128 out = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(x, neg_r), _mm_cmpgt_ps(x, _mm_add_ps(w, r))),
+                             _mm_or_ps(_mm_cmplt_ps(y, neg_r), _mm_cmpgt_ps(y, _mm_add_ps(h, r))));
+
+      u64 bits = (u64)_mm_movemask_ps(out);
+      offscreen_mask[i/64] &= ~(0xfULL << (i%64));
+      offscreen_mask[i/64] |= bits << (i%64);
+    }
+  }
+}
+#endif // GAME_SSE2
+
+#if GAME_AVX2
+AVX2_FUNCTION
+void kinematics_step_avx2(Kinematics* k, s32 first, s32 end, f32 delta_time, Vec2 view_dim, u64* offscreen_mask) {
+  __m256 dt = _mm256_set1_ps(delta_time);
+  __m256 w  = _mm256_set1_ps(view_dim.x);
+  __m256 h  = _mm256_set1_ps(view_dim.y);
+  __m256 zero = _mm256_setzero_ps();
+
+  for(s32 i = first; i < end; i += 8) {
+    __m256 friction = _mm256_loadu_ps(k->friction + i);
+    __m256 vx = _mm256_mul_ps(_mm256_loadu_ps(k->vx + i), friction);
+    __m256 vy = _mm256_mul_ps(_mm256_loadu_ps(k->vy + i), friction);
+    __m256 dx = _mm256_mul_ps(vx, dt);
+    __m256 dy = _mm256_mul_ps(vy, dt);
+    __m256 x  = _mm256_add_ps(_mm256_loadu_ps(k->x + i), dx);
+    __m256 y  = _mm256_add_ps(_mm256_loadu_ps(k->y + i), dy);
+
+    _mm256_storeu_ps(k->vx + i, vx);
+    _mm256_storeu_ps(k->vy + i, vy);
+    _mm256_storeu_ps(k->dx + i, dx);
+    _mm256_storeu_ps(k->dy + i, dy);
+    _mm256_storeu_ps(k->x + i, x);
+    _mm256_storeu_ps(k->y + i, y);
+
+    if(offscreen_mask) {
+      __m256 r     = _mm256_loadu_ps(k->radius + i);
+      __m256 neg_r = _mm256_sub_ps(zero, r);
+
+      __m256 out = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(x, neg_r, _CMP_LT_OQ), _mm256_cmp_ps(x, _mm256_add_ps(w, r), _CMP_GT_OQ)),
+                                _mm256_or_ps(_mm256_cmp_ps(y, neg_r, _CMP_LT_OQ), _mm256_cmp_ps(y, _mm256_add_ps(h, r), _CMP_GT_OQ)));
+
+      u64 bits = (u64)_mm256_movemask_ps(out);
+      offscreen_mask[i/64] &= ~(0xffULL << (i%64));
+      offscreen_mask[i/64] |= bits << (i%64);
+    }
+  }
+}
+#endif // GAME_AVX2
+#endif // GAME_DETERMINISTIC
+
+typedef void Kinematics_Step_Proc(Kinematics* k, s32 first, s32 end, f32 delta_time, Vec2 view_dim, u64* offscreen_mask);
+
+#if GAME_DETERMINISTIC
+global_var Kinematics_Step_Proc* global_kinematics_step_kernel = kinematics_step_fixed;
+
+// The fixed step is the only one, integer math doesn't need a reference version.
+void kinematics_bind_kernels(Simd_Level level) {
+  global_kinematics_step_kernel = kinematics_step_fixed;
+}
+#else
+global_var Kinematics_Step_Proc* global_kinematics_step_kernel = kinematics_step_scalar;
+
+void kinematics_bind_kernels(Simd_Level level) {
+  global_kinematics_step_kernel = kinematics_step_scalar;
+#if GAME_SSE2
+  if(level >= Simd_Level_SSE2) global_kinematics_step_kernel = kinematics_step_sse2;
+#endif
+#if GAME_AVX2
+  if(level >= Simd_Level_AVX2) global_kinematics_step_kernel = kinematics_step_avx2;
+#endif
+}
+#endif
+
+// Steps the objects in [first, end), skipping runs of 64 without a live one in active_mask.
+void kinematics_step(Kinematics* k, u64* active_mask, s32 first, s32 end, f32 delta_time, Vec2 view_dim, u64* offscreen_mask) {
+  Assert(first % 64 == 0 && end % 64 == 0 && end <= k->capacity);
+  
+  for(s32 at = first; at < end; at += 64) {
+    if(!active_mask[at/64]) {
+      if(offscreen_mask) offscreen_mask[at/64] = 0;
+      continue;
+    }
+    global_kinematics_step_kernel(k, at, at + 64, delta_time, view_dim, offscreen_mask);
+  }
+}
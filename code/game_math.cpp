@@ -14,6 +14,238 @@ s32 round_f32_to_s32(f32 value) {
   return r;
 }
 
+f32 pow_f32_s32(f32 x, s32 n) {
+  Assert(n >= 0);
+  f32 r = 1.0f;
+  while(n) {
+    if(n & 1) r *= x;
+    x *= x;
+    n >>= 1;
+  }
+  return r;
+}
+
+// x^(1/n) for x in (0, 1]. Newton's method from 1 down, only + * and /, so unlike powf it
+// gives the same bits with every compiler and libm.
+f32 root_f32_s32(f32 x, s32 n) {
+  Assert(x > 0.0f && x <= 1.0f && n > 0);
+  f32 r = 1.0f;
+  Loop(i, 64) {
+    f32 next = r - (pow_f32_s32(r, n) - x)/((f32)n*pow_f32_s32(r, n - 1));
+    if(next >= r) break;
+    r = next;
+  }
+  return r;
+}
+
+//
+// Note: Trig
+//
+// sin and cos out of one range reduction. The angle is brought into [-pi/4, pi/4] around
+// the nearest multiple of pi/2, the quadrant picks which polynomial is sin and which is cos
+// and their signs. They're the same on every platform, unlike the libm ones.
+//
+// Trig_Accuracy_High is within about 1e-7 of the real thing for |angle| < 1e4 and is what
+// the simulation uses. Trig_Accuracy_Low is within 4e-4, good enough for anything that's
+// only drawn.
+//
+// With GAME_DETERMINISTIC the high accuracy calls and vec2_angle go to the fixed point
+// tables in game_fixed.cpp instead, within about 5e-5.
+//
+
+enum Trig_Accuracy {
+  Trig_Accuracy_High,
+  Trig_Accuracy_Low,
+};
+
+#define TRIG_TWO_OVER_PI 0.636619772f
+#define TRIG_PI_OVER_2_HI 1.5703125f          // few mantissa bits so q*hi is exact
+#define TRIG_PI_OVER_2_LO 4.83826794897e-4f
+
+// Polynomials on [-pi/4, pi/4], the high ones are the cephes sinf/cosf coefficients.
+f32 trig_sin_poly(f32 r, f32 r2, Trig_Accuracy accuracy) {
+  if(accuracy == Trig_Accuracy_Low) return r + r*r2*(-1.6666667e-1f + r2*8.3333333e-3f);
+  return r + r*r2*(-1.6666654611e-1f + r2*(8.3321608736e-3f + r2*-1.9515295891e-4f));
+}
+
+f32 trig_cos_poly(f32 r2, Trig_Accuracy accuracy) {
+  if(accuracy == Trig_Accuracy_Low) return 1.0f + r2*(-0.5f + r2*4.1666667e-2f);
+  return 1.0f - 0.5f*r2 + r2*r2*(4.166664568298827e-2f + r2*(-1.388731625493765e-3f + r2*2.443315711809948e-5f));
+}
+
+void trig_sincos_poly(f32 angle, f32* sin_out, f32* cos_out, Trig_Accuracy accuracy) {
+  f32 half = angle < 0.0f ? -0.5f : 0.5f;
+  s32 q = (s32)(angle*TRIG_TWO_OVER_PI + half);
+  
+  f32 r  = (angle - (f32)q*TRIG_PI_OVER_2_HI) - (f32)q*TRIG_PI_OVER_2_LO;
+  f32 r2 = r*r;
+  f32 s = trig_sin_poly(r, r2, accuracy);
+  f32 c = trig_cos_poly(r2, accuracy);
+  
+  if(q & 1) { f32 t = s; s = c; c = t; }
+  if(q & 2)       s = -s;
+  if((q + 1) & 2) c = -c;
+  
+  *sin_out = s;
+  *cos_out = c;
+}
+
+#if GAME_DETERMINISTIC
+void fixed_sincos_f32(f32 angle, f32* sin_out, f32* cos_out);
+f32 fixed_atan2_f32(f32 y, f32 x);
+#endif
+
+void sincos_f32(f32 angle, f32* sin_out, f32* cos_out, Trig_Accuracy accuracy = Trig_Accuracy_High) {
+#if GAME_DETERMINISTIC
+  if(accuracy == Trig_Accuracy_High) {
+    fixed_sincos_f32(angle, sin_out, cos_out);
+    return;
+  }
+#endif
+  trig_sincos_poly(angle, sin_out, cos_out, accuracy);
+}
+
+f32 sin_f32(f32 angle, Trig_Accuracy accuracy = Trig_Accuracy_High) {
+  f32 s, c;
+  sincos_f32(angle, &s, &c, accuracy);
+  return s;
+}
+
+f32 cos_f32(f32 angle, Trig_Accuracy accuracy = Trig_Accuracy_High) {
+  f32 s, c;
+  sincos_f32(angle, &s, &c, accuracy);
+  return c;
+}
+
+// Batch form, sin_out[i] and cos_out[i] of angles[i]. Same results as sincos_f32.
+void sincos_n_scalar(f32* sin_out, f32* cos_out, f32* angles, s32 count, Trig_Accuracy accuracy) {
+  Loop(i, count) sincos_f32(angles[i], &sin_out[i], &cos_out[i], accuracy);
+}
+
+#if GAME_SSE2
+void sincos_n_sse2(f32* sin_out, f32* cos_out, f32* angles, s32 count, Trig_Accuracy accuracy) {
+  __m128 two_over_pi = _mm_set1_ps(TRIG_TWO_OVER_PI);
+  __m128 pio2_hi = _mm_set1_ps(TRIG_PI_OVER_2_HI);
+  __m128 pio2_lo = _mm_set1_ps(TRIG_PI_OVER_2_LO);
+  __m128 sign_bit = _mm_set1_ps(-0.0f);
+  __m128 half = _mm_set1_ps(0.5f);
+  __m128 one  = _mm_set1_ps(1.0f);
+  __m128i int_one = _mm_set1_epi32(1);
+  __m128i int_two = _mm_set1_epi32(2);
+  
+  b32 low = (accuracy == Trig_Accuracy_Low);
+  __m128 s1 = _mm_set1_ps(low ? -1.6666667e-1f : -1.6666654611e-1f);
+  __m128 s2 = _mm_set1_ps(low ?  8.3333333e-3f :  8.3321608736e-3f);
+  __m128 s3 = _mm_set1_ps(low ?  0.0f          : -1.9515295891e-4f);
+  __m128 c1 = _mm_set1_ps(low ?  4.1666667e-2f :  4.166664568298827e-2f);
+  __m128 c2 = _mm_set1_ps(low ?  0.0f          : -1.388731625493765e-3f);
+  __m128 c3 = _mm_set1_ps(low ?  0.0f          :  2.443315711809948e-5f);
+  
+  s32 i = 0;
+  for(; i + 4 <= count; i += 4) {
+    __m128 x = _mm_loadu_ps(angles + i);
+    
+    // round half away from zero, like the scalar version
+    __m128 signed_half = _mm_or_ps(_mm_and_ps(x, sign_bit), half);
+    __m128i q  = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, two_over_pi), signed_half));
+    __m128  qf = _mm_cvtepi32_ps(q);
+    
+    __m128 r  = _mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(qf, pio2_hi)), _mm_mul_ps(qf, pio2_lo));
+    __m128 r2 = _mm_mul_ps(r, r);
+    
+    __m128 s, c;
+    if(low) {
+      s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), _mm_add_ps(s1, _mm_mul_ps(r2, s2))));
+      c = _mm_add_ps(one, _mm_mul_ps(r2, _mm_add_ps(_mm_sub_ps(_mm_setzero_ps(), half), _mm_mul_ps(r2, c1))));
+    }
+    else {
+      __m128 sp = _mm_add_ps(s1, _mm_mul_ps(r2, _mm_add_ps(s2, _mm_mul_ps(r2, s3))));
+      s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sp));
+      
+      __m128 cp = _mm_add_ps(c1, _mm_mul_ps(r2, _mm_add_ps(c2, _mm_mul_ps(r2, c3))));
+      c = _mm_add_ps(_mm_sub_ps(one, _mm_mul_ps(half, r2)), _mm_mul_ps(_mm_mul_ps(r2, r2), cp));
+    }
+    
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, int_one), int_one));
+    __m128 sw = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+    __m128 cw = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+    
+    __m128 negate_s = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, int_two), int_two));
+    __m128 negate_c = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_add_epi32(q, int_one), int_two), int_two));
+    sw = _mm_xor_ps(sw, _mm_and_ps(negate_s, sign_bit));
+    cw = _mm_xor_ps(cw, _mm_and_ps(negate_c, sign_bit));
+    
+    _mm_storeu_ps(sin_out + i, sw);
+    _mm_storeu_ps(cos_out + i, cw);
+  }
+  
+  for(; i < count; i += 1) sincos_f32(angles[i], &sin_out[i], &cos_out[i], accuracy);
+}
+#endif
+
+#if GAME_AVX2
+// sincos_n_sse2 eight at a time, the rest goes to it.
+AVX2_FUNCTION
+void sincos_n_avx2(f32* sin_out, f32* cos_out, f32* angles, s32 count, Trig_Accuracy accuracy) {
+  __m256 two_over_pi = _mm256_set1_ps(TRIG_TWO_OVER_PI);
+  __m256 pio2_hi = _mm256_set1_ps(TRIG_PI_OVER_2_HI);
+  __m256 pio2_lo = _mm256_set1_ps(TRIG_PI_OVER_2_LO);
+  __m256 sign_bit = _mm256_set1_ps(-0.0f);
+  __m256 half = _mm256_set1_ps(0.5f);
+  __m256 one  = _mm256_set1_ps(1.0f);
+  __m256i int_one = _mm256_set1_epi32(1);
+  __m256i int_two = _mm256_set1_epi32(2);
+  
+  b32 low = (accuracy == Trig_Accuracy_Low);
+  __m256 s1 = _mm256_set1_ps(low ? -1.6666667e-1f : -1.6666654611e-1f);
+  __m256 s2 = _mm256_set1_ps(low ?  8.3333333e-3f :  8.3321608736e-3f);
+  __m256 s3 = _mm256_set1_ps(low ?  0.0f          : -1.9515295891e-4f);
+  __m256 c1 = _mm256_set1_ps(low ?  4.1666667e-2f :  4.166664568298827e-2f);
+  __m256 c2 = _mm256_set1_ps(low ?  0.0f          : -1.388731625493765e-3f);
+  __m256 c3 = _mm256_set1_ps(low ?  0.0f          :  2.443315711809948e-5f);
+  
+  s32 i = 0;
+  for(; i + 8 <= count; i += 8) {
+    __m256 x = _mm256_loadu_ps(angles + i);
+    
+    __m256 signed_half = _mm256_or_ps(_mm256_and_ps(x, sign_bit), half);
+    __m256i q  = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(x, two_over_pi), signed_half));
+    __m256  qf = _mm256_cvtepi32_ps(q);
+    
+    __m256 r  = _mm256_sub_ps(_mm256_sub_ps(x, _mm256_mul_ps(qf, pio2_hi)), _mm256_mul_ps(qf, pio2_lo));
+    __m256 r2 = _mm256_mul_ps(r, r);
+    
+    __m256 s, c;
+    if(low) {
+      s = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), _mm256_add_ps(s1, _mm256_mul_ps(r2, s2))));
+      c = _mm256_add_ps(one, _mm256_mul_ps(r2, _mm256_add_ps(_mm256_sub_ps(_mm256_setzero_ps(), half), _mm256_mul_ps(r2, c1))));
+    }
+    else {
+      __m256 sp = _mm256_add_ps(s1, _mm256_mul_ps(r2, _mm256_add_ps(s2, _mm256_mul_ps(r2, s3))));
+      s = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), sp));
+      
+      __m256 cp = _mm256_add_ps(c1, _mm256_mul_ps(r2, _mm256_add_ps(c2, _mm256_mul_ps(r2, c3))));
+      c = _mm256_add_ps(_mm256_sub_ps(one, _mm256_mul_ps(half, r2)), _mm256_mul_ps(_mm256_mul_ps(r2, r2), cp));
+    }
+    
+    __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, int_one), int_one));
+    __m256 sw = _mm256_blendv_ps(s, c, swap);
+    __m256 cw = _mm256_blendv_ps(c, s, swap);
+    
+    __m256 negate_s = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, int_two), int_two));
+    __m256 negate_c = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_add_epi32(q, int_one), int_two), int_two));
+    sw = _mm256_xor_ps(sw, _mm256_and_ps(negate_s, sign_bit));
+    cw = _mm256_xor_ps(cw, _mm256_and_ps(negate_c, sign_bit));
+    
+    _mm256_storeu_ps(sin_out + i, sw);
+    _mm256_storeu_ps(cos_out + i, cw);
+  }
+  
+  sincos_n_sse2(sin_out + i, cos_out + i, angles + i, count - i, accuracy);
+}
+#endif
+
+
 //
 // Note: Vec2
 //
@@ -30,29 +262,38 @@ Vec2 vec2(f32 x, f32 y) {
 }
 
 Vec2 vec2(f32 angle) {
-  return {cosf(angle), sinf(angle)};
+  Vec2 r;
+  sincos_f32(angle, &r.y, &r.x);
+  return r;
 }
 
 f32 vec2_angle(Vec2 v) {
+#if GAME_DETERMINISTIC
+  f32 r = fixed_atan2_f32(v.y, v.x);
+#else
   f32 r = atan2f(v.y, v.x);
+#endif
   return r;
 }
 
-f32 vec2_length(Vec2 v) { return sqrtf(v.x*v.x + v.y*v.y); }
+f32 vec2_length(Vec2 v)    { return sqrtf(v.x*v.x + v.y*v.y); }
+f32 vec2_length_sq(Vec2 v) { return v.x*v.x + v.y*v.y; }
+f32 vec2_dot(Vec2 a, Vec2 b) { return a.x*b.x + a.y*b.y; }
 
 Vec2 vec2_normalize(Vec2 v) {
   f32 l = sqrtf(v.x*v.x + v.y*v.y);
   if(l == 0.0f) return {0, 0};
-  return {v.x/l, v.y/l};
+  
+  f32 inv_l = 1.0f/l;
+  return {v.x*inv_l, v.y*inv_l};
 }
 
 Vec2 vec2_rotate(Vec2 v, f32 angle) {
-  Vec2 r = {
-     v.x*cosf(angle) - v.y*sinf(angle),
-     v.x*sinf(angle) + v.y*cosf(angle)
-  };
-    
-    return r;
+  f32 s, c;
+  sincos_f32(angle, &s, &c);
+  
+  Vec2 r = {v.x*c - v.y*s, v.x*s + v.y*c};
+  return r;
 }
 
 Vec2 vec2_perp(Vec2 v) {
@@ -84,6 +325,489 @@ f32 vec2_lerp_x_to_y(Vec2 v, f32 t) {
   return r;
 }
 
+//
+// Note: Vec2 batches
+//
+// The same operation over a whole array of points. The SSE2 versions do two points per
+// register and give the same results as the scalar ones. out may be the same array as in.
+//
+
+// out[i] = offset + rotate(in[i], angle)*scale, one cos/sin pair for all of them.
+void vec2_transform_points_scalar(Vec2* out, Vec2* in, s32 count, f32 angle, f32 scale, Vec2 offset) {
+  f32 s, c;
+  sincos_f32(angle, &s, &c);
+  c *= scale;
+  s *= scale;
+  
+  Loop(i, count) {
+    Vec2 v = in[i];
+    out[i] = {v.x*c - v.y*s + offset.x, v.x*s + v.y*c + offset.y};
+  }
+}
+
+void vec2_normalize_n_scalar(Vec2* out, Vec2* in, s32 count) {
+  Loop(i, count) out[i] = vec2_normalize(in[i]);
+}
+
+void vec2_lerp_n_scalar(Vec2* out, Vec2* a, Vec2* b, s32 count, f32 t) {
+  Loop(i, count) out[i] = a[i] + (b[i] - a[i])*t;
+}
+
+void vec2_length_sq_n_scalar(f32* out, Vec2* in, s32 count) {
+  Loop(i, count) out[i] = vec2_length_sq(in[i]);
+}
+
+#if GAME_SSE2
+void vec2_transform_points_sse2(Vec2* out, Vec2* in, s32 count, f32 angle, f32 scale, Vec2 offset) {
+  f32 s, c;
+  sincos_f32(angle, &s, &c);
+  c *= scale;
+  s *= scale;
+  
+  // (x, y) -> (x*c + y*-s, y*c + x*s)
+  __m128 vc  = _mm_set1_ps(c);
+  __m128 vs  = _mm_set_ps(s, -s, s, -s);
+  __m128 off = _mm_set_ps(offset.y, offset.x, offset.y, offset.x);
+  
+  s32 i = 0;
+  for(; i + 2 <= count; i += 2) {
+    __m128 v  = _mm_loadu_ps((f32*)(in + i));
+    __m128 sw = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 r  = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v, vc), _mm_mul_ps(sw, vs)), off);
+    _mm_storeu_ps((f32*)(out + i), r);
+  }
+  
+  for(; i < count; i += 1) {
+    Vec2 v = in[i];
+    out[i] = {v.x*c - v.y*s + offset.x, v.x*s + v.y*c + offset.y};
+  }
+}
+
+// The same steps as vec2_normalize, so the results match it bit for bit.
+void vec2_normalize_n_sse2(Vec2* out, Vec2* in, s32 count) {
+  __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  
+  s32 i = 0;
+  for(; i + 2 <= count; i += 2) {
+    __m128 v  = _mm_loadu_ps((f32*)(in + i));
+    __m128 sq = _mm_mul_ps(v, v);
+    __m128 len_sq = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+    
+    __m128 inv_l = _mm_div_ps(one, _mm_sqrt_ps(len_sq));
+    __m128 r = _mm_and_ps(_mm_mul_ps(v, inv_l), _mm_cmpneq_ps(len_sq, zero));
+    _mm_storeu_ps((f32*)(out + i), r);
+  }
+  
+  for(; i < count; i += 1) out[i] = vec2_normalize(in[i]);
+}
+
+void vec2_lerp_n_sse2(Vec2* out, Vec2* a, Vec2* b, s32 count, f32 t) {
+  __m128 vt = _mm_set1_ps(t);
+  
+  s32 i = 0;
+  for(; i + 2 <= count; i += 2) {
+    __m128 va = _mm_loadu_ps((f32*)(a + i));
+    __m128 vb = _mm_loadu_ps((f32*)(b + i));
+    _mm_storeu_ps((f32*)(out + i), _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), vt)));
+  }
+  
+  for(; i < count; i += 1) out[i] = a[i] + (b[i] - a[i])*t;
+}
+
+void vec2_length_sq_n_sse2(f32* out, Vec2* in, s32 count) {
+  s32 i = 0;
+  for(; i + 4 <= count; i += 4) {
+    __m128 v0 = _mm_loadu_ps((f32*)(in + i));
+    __m128 v1 = _mm_loadu_ps((f32*)(in + i + 2));
+    __m128 xs = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 ys = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(xs, xs), _mm_mul_ps(ys, ys)));
+  }
+  
+  for(; i < count; i += 1) out[i] = vec2_length_sq(in[i]);
+}
+#endif
+
+//
+// Note: Collision primitives
+//
+
+// Parameter in [0, 1] of the point on segment a-b closest to p.
+f32 segment_closest_t(Vec2 a, Vec2 b, Vec2 p) {
+  Vec2 ab = b - a;
+  f32 len_sq = vec2_length_sq(ab);
+  if(len_sq == 0.0f) return 0.0f;
+  
+  f32 t = vec2_dot(p - a, ab)/len_sq;
+  t = Clamp(t, 0.0f, 1.0f);
+  return t;
+}
+
+f32 segment_distance_sq(Vec2 a, Vec2 b, Vec2 p) {
+  f32 t = segment_closest_t(a, b, p);
+  Vec2 closest = a + (b - a)*t;
+  f32 r = vec2_length_sq(p - closest);
+  return r;
+}
+
+// Capsule is the segment a-b inflated by capsule_radius.
+b32 capsule_vs_circle(Vec2 a, Vec2 b, f32 capsule_radius, Vec2 center, f32 radius) {
+  f32 reach = capsule_radius + radius;
+  b32 r = segment_distance_sq(a, b, center) <= reach*reach;
+  return r;
+}
+
+b32 segment_vs_circle(Vec2 a, Vec2 b, Vec2 center, f32 radius) {
+  return capsule_vs_circle(a, b, 0.0f, center, radius);
+}
+
+// Circle of radius r0 moving from p0 to p1 against a static circle. On a hit toi is the
+// fraction of the move at first contact, 0 if they already overlap at p0.
+b32 swept_circle_vs_circle(Vec2 p0, Vec2 p1, f32 r0, Vec2 center, f32 r1, f32* toi) {
+  Vec2 d = p1 - p0;
+  Vec2 m = p0 - center;
+  f32 reach = r0 + r1;
+  
+  f32 c = vec2_length_sq(m) - reach*reach;
+  if(c <= 0.0f) { *toi = 0.0f; return true; }
+  
+  f32 a = vec2_length_sq(d);
+  f32 b = vec2_dot(m, d);
+  if(a == 0.0f || b > 0.0f) return false;
+  
+  f32 disc = b*b - a*c;
+  if(disc < 0.0f) return false;
+  
+  f32 t = (-b - sqrtf(disc))/a;
+  if(t > 1.0f) return false;
+  
+  *toi = t;
+  return true;
+}
+
+// dir must be normalized. On a hit t is the distance along the ray, 0 if origin is inside.
+b32 ray_vs_circle(Vec2 origin, Vec2 dir, Vec2 center, f32 radius, f32* t) {
+  Vec2 m = origin - center;
+  f32 b = vec2_dot(m, dir);
+  f32 c = vec2_length_sq(m) - radius*radius;
+  if(c > 0.0f && b > 0.0f) return false;
+  
+  f32 disc = b*b - c;
+  if(disc < 0.0f) return false;
+  
+  *t = Max(-b - sqrtf(disc), 0.0f);
+  return true;
+}
+
+//
+// Batch versions, one capsule or moving circle against 'count' circles stored as arrays.
+// Hits are written as bits into hit_mask (BIT_SET_WORD_COUNT(count) words, cleared first).
+//
+void capsule_vs_circles_scalar(Vec2 a, Vec2 b, f32 capsule_radius,
+                               f32* xs, f32* ys, f32* radii, s32 count, u64* hit_mask) {
+  bit_set_clear(hit_mask, count);
+  Loop(i, count) {
+    if(capsule_vs_circle(a, b, capsule_radius, {xs[i], ys[i]}, radii[i])) bit_set_set(hit_mask, i);
+  }
+}
+
+// tois[i] is the toi of a hit, 1 for a miss.
+void swept_circle_vs_circles_scalar(Vec2 p0, Vec2 p1, f32 r0,
+                                    f32* xs, f32* ys, f32* radii, s32 count, u64* hit_mask, f32* tois) {
+  bit_set_clear(hit_mask, count);
+  Loop(i, count) {
+    f32 toi = 1.0f;
+    if(swept_circle_vs_circle(p0, p1, r0, {xs[i], ys[i]}, radii[i], &toi)) bit_set_set(hit_mask, i);
+    tois[i] = toi;
+  }
+}
+
+#if GAME_SSE2
+void capsule_vs_circles_sse2(Vec2 a, Vec2 b, f32 capsule_radius,
+                             f32* xs, f32* ys, f32* radii, s32 count, u64* hit_mask) {
+  Vec2 ab = b - a;
+  f32 len_sq = vec2_length_sq(ab);
+  if(len_sq == 0.0f) {
+    capsule_vs_circles_scalar(a, b, capsule_radius, xs, ys, radii, count, hit_mask);
+    return;
+  }
+  
+  bit_set_clear(hit_mask, count);
+  
+  // The same operations in the same order as capsule_vs_circle, so the bits are the same
+  // as the scalar ones, also right on the edge.
+  __m128 ax  = _mm_set1_ps(a.x),  ay  = _mm_set1_ps(a.y);
+  __m128 abx = _mm_set1_ps(ab.x), aby = _mm_set1_ps(ab.y);
+  __m128 vlen_sq = _mm_set1_ps(len_sq);
+  __m128 cr   = _mm_set1_ps(capsule_radius);
+  __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  
+  s32 i = 0;
+  for(; i + 4 <= count; i += 4) {
+    __m128 x = _mm_loadu_ps(xs + i);
+    __m128 y = _mm_loadu_ps(ys + i);
+    __m128 px = _mm_sub_ps(x, ax);
+    __m128 py = _mm_sub_ps(y, ay);
+    
+    __m128 t = _mm_div_ps(_mm_add_ps(_mm_mul_ps(px, abx), _mm_mul_ps(py, aby)), vlen_sq);
+    t = _mm_min_ps(_mm_max_ps(t, zero), one);
+    
+    __m128 dx = _mm_sub_ps(x, _mm_add_ps(ax, _mm_mul_ps(abx, t)));
+    __m128 dy = _mm_sub_ps(y, _mm_add_ps(ay, _mm_mul_ps(aby, t)));
+    __m128 dist_sq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+    
+    __m128 reach = _mm_add_ps(cr, _mm_loadu_ps(radii + i));
+    s32 bits = _mm_movemask_ps(_mm_cmple_ps(dist_sq, _mm_mul_ps(reach, reach)));
+    hit_mask[i/64] |= (u64)bits << (i%64);
+  }
+  
+  for(; i < count; i += 1) {
+    if(capsule_vs_circle(a, b, capsule_radius, {xs[i], ys[i]}, radii[i])) bit_set_set(hit_mask, i);
+  }
+}
+
+void swept_circle_vs_circles_sse2(Vec2 p0, Vec2 p1, f32 r0,
+                                  f32* xs, f32* ys, f32* radii, s32 count, u64* hit_mask, f32* tois) {
+  bit_set_clear(hit_mask, count);
+  
+  Vec2 d = p1 - p0;
+  f32 a = vec2_length_sq(d);
+  
+  // The operations of swept_circle_vs_circle, the early outs become masks.
+  __m128 p0x = _mm_set1_ps(p0.x), p0y = _mm_set1_ps(p0.y);
+  __m128 dx  = _mm_set1_ps(d.x),  dy  = _mm_set1_ps(d.y);
+  __m128 va  = _mm_set1_ps(a);
+  __m128 vr0 = _mm_set1_ps(r0);
+  __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+  __m128 sign = _mm_set1_ps(-0.0f);
+  
+  s32 i = 0;
+  for(; i + 4 <= count; i += 4) {
+    __m128 mx = _mm_sub_ps(p0x, _mm_loadu_ps(xs + i));
+    __m128 my = _mm_sub_ps(p0y, _mm_loadu_ps(ys + i));
+    __m128 reach = _mm_add_ps(vr0, _mm_loadu_ps(radii + i));
+    
+    __m128 c = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(mx, mx), _mm_mul_ps(my, my)), _mm_mul_ps(reach, reach));
+    __m128 b = _mm_add_ps(_mm_mul_ps(mx, dx), _mm_mul_ps(my, dy));
+    __m128 disc = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(va, c));
+    
+    // a == 0 makes t NaN or infinite, which fails t <= 1 the same as the scalar early out
+    __m128 t = _mm_div_ps(_mm_sub_ps(_mm_xor_ps(b, sign), _mm_sqrt_ps(_mm_max_ps(disc, zero))), va);
+    
+    __m128 overlapping = _mm_cmple_ps(c, zero);
+    __m128 approaching = _mm_and_ps(_mm_cmple_ps(b, zero), _mm_cmpge_ps(disc, zero));
+    __m128 in_reach    = _mm_andnot_ps(overlapping, _mm_and_ps(approaching, _mm_cmple_ps(t, one)));
+    
+    __m128 toi = _mm_or_ps(_mm_and_ps(in_reach, t), _mm_andnot_ps(in_reach, one));
+    toi = _mm_andnot_ps(overlapping, toi);
+    _mm_storeu_ps(tois + i, toi);
+    
+    s32 bits = _mm_movemask_ps(_mm_or_ps(overlapping, in_reach));
+    hit_mask[i/64] |= (u64)bits << (i%64);
+  }
+  
+  for(; i < count; i += 1) {
+    f32 toi = 1.0f;
+    if(swept_circle_vs_circle(p0, p1, r0, {xs[i], ys[i]}, radii[i], &toi)) bit_set_set(hit_mask, i);
+    tois[i] = toi;
+  }
+}
+#endif
+
+#if GAME_AVX2
+// The SSE2 versions eight at a time. The compares are the ordered ones like SSE2's, false
+// when a NaN is involved.
+AVX2_FUNCTION
+void capsule_vs_circles_avx2(Vec2 a, Vec2 b, f32 capsule_radius,
+                             f32* xs, f32* ys, f32* radii, s32 count, u64* hit_mask) {
+  Vec2 ab = b - a;
+  f32 len_sq = vec2_length_sq(ab);
+  if(len_sq == 0.0f) {
+    capsule_vs_circles_scalar(a, b, capsule_radius, xs, ys, radii, count, hit_mask);
+    return;
+  }
+  
+  bit_set_clear(hit_mask, count);
+  
+  __m256 ax  = _mm256_set1_ps(a.x),  ay  = _mm256_set1_ps(a.y);
+  __m256 abx = _mm256_set1_ps(ab.x), aby = _mm256_set1_ps(ab.y);
+  __m256 vlen_sq = _mm256_set1_ps(len_sq);
+  __m256 cr   = _mm256_set1_ps(capsule_radius);
+  __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+  
+  s32 i = 0;
+  for(; i + 8 <= count; i += 8) {
+    __m256 x = _mm256_loadu_ps(xs + i);
+    __m256 y = _mm256_loadu_ps(ys + i);
+    __m256 px = _mm256_sub_ps(x, ax);
+    __m256 py = _mm256_sub_ps(y, ay);
+    
+    __m256 t = _mm256_div_ps(_mm256_add_ps(_mm256_mul_ps(px, abx), _mm256_mul_ps(py, aby)), vlen_sq);
+    t = _mm256_min_ps(_mm256_max_ps(t, zero), one);
+    
+    __m256 dx = _mm256_sub_ps(x, _mm256_add_ps(ax, _mm256_mul_ps(abx, t)));
+    __m256 dy = _mm256_sub_ps(y, _mm256_add_ps(ay, _mm256_mul_ps(aby, t)));
+    __m256 dist_sq = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+    
+    __m256 reach = _mm256_add_ps(cr, _mm256_loadu_ps(radii + i));
+    s32 bits = _mm256_movemask_ps(_mm256_cmp_ps(dist_sq, _mm256_mul_ps(reach, reach), _CMP_LE_OQ));
+    hit_mask[i/64] |= (u64)bits << (i%64);
+  }
+  
+  for(; i < count; i += 1) {
+    if(capsule_vs_circle(a, b, capsule_radius, {xs[i], ys[i]}, radii[i])) bit_set_set(hit_mask, i);
+  }
+}
+
+AVX2_FUNCTION
+void swept_circle_vs_circles_avx2(Vec2 p0, Vec2 p1, f32 r0,
+                                  f32* xs, f32* ys, f32* radii, s32 count, u64* hit_mask, f32* tois) {
+  bit_set_clear(hit_mask, count);
+  
+  Vec2 d = p1 - p0;
+  f32 a = vec2_length_sq(d);
+  
+  __m256 p0x = _mm256_set1_ps(p0.x), p0y = _mm256_set1_ps(p0.y);
+  __m256 dx  = _mm256_set1_ps(d.x),  dy  = _mm256_set1_ps(d.y);
+  __m256 va  = _mm256_set1_ps(a);
+  __m256 vr0 = _mm256_set1_ps(r0);
+  __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+  __m256 sign = _mm256_set1_ps(-0.0f);
+  
+  s32 i = 0;
+  for(; i + 8 <= count; i += 8) {
+    __m256 mx = _mm256_sub_ps(p0x, _mm256_loadu_ps(xs + i));
+    __m256 my = _mm256_sub_ps(p0y, _mm256_loadu_ps(ys + i));
+    __m256 reach = _mm256_add_ps(vr0, _mm256_loadu_ps(radii + i));
+    
+    __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(mx, mx), _mm256_mul_ps(my, my)), _mm256_mul_ps(reach, reach));
+    __m256 b = _mm256_add_ps(_mm256_mul_ps(mx, dx), _mm256_mul_ps(my, dy));
+    __m256 disc = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(va, c));
+    
+    __m256 t = _mm256_div_ps(_mm256_sub_ps(_mm256_xor_ps(b, sign), _mm256_sqrt_ps(_mm256_max_ps(disc, zero))), va);
+    
+    __m256 overlapping = _mm256_cmp_ps(c, zero, _CMP_LE_OQ);
+    __m256 approaching = _mm256_and_ps(_mm256_cmp_ps(b, zero, _CMP_LE_OQ), _mm256_cmp_ps(disc, zero, _CMP_GE_OQ));
+    __m256 in_reach    = _mm256_andnot_ps(overlapping, _mm256_and_ps(approaching, _mm256_cmp_ps(t, one, _CMP_LE_OQ)));
+    
+    __m256 toi = _mm256_blendv_ps(one, t, in_reach);
+    toi = _mm256_andnot_ps(overlapping, toi);
+    _mm256_storeu_ps(tois + i, toi);
+    
+    s32 bits = _mm256_movemask_ps(_mm256_or_ps(overlapping, in_reach));
+    hit_mask[i/64] |= (u64)bits << (i%64);
+  }
+  
+  for(; i < count; i += 1) {
+    f32 toi = 1.0f;
+    if(swept_circle_vs_circle(p0, p1, r0, {xs[i], ys[i]}, radii[i], &toi)) bit_set_set(hit_mask, i);
+    tois[i] = toi;
+  }
+}
+#endif
+
+//
+// Note: Kernel dispatch
+//
+// The kernels above are called through this table, math_bind_kernels fills it in for the
+// cpu we're running on. It starts out on the scalar versions.
+//
+// On x86-64 this picks nothing the compiler didn't already assume: GAME_SSE2 is only on
+// when the build targets SSE2, which every x86-64 build does, and there are no AVX2
+// versions. So in practice the choice is SSE2, or scalar with GAME_FORCE_SCALAR for
+// checking the SIMD paths against the reference. test_kernels.cpp tests every entry.
+//
+
+typedef void Sincos_N_Proc(f32* sin_out, f32* cos_out, f32* angles, s32 count, Trig_Accuracy accuracy);
+typedef void Vec2_Transform_Points_Proc(Vec2* out, Vec2* in, s32 count, f32 angle, f32 scale, Vec2 offset);
+typedef void Vec2_Normalize_N_Proc(Vec2* out, Vec2* in, s32 count);
+typedef void Vec2_Lerp_N_Proc(Vec2* out, Vec2* a, Vec2* b, s32 count, f32 t);
+typedef void Vec2_Length_Sq_N_Proc(f32* out, Vec2* in, s32 count);
+typedef void Capsule_Vs_Circles_Proc(Vec2 a, Vec2 b, f32 capsule_radius,
+                                     f32* xs, f32* ys, f32* radii, s32 count, u64* hit_mask);
+typedef void Swept_Circle_Vs_Circles_Proc(Vec2 p0, Vec2 p1, f32 r0,
+                                          f32* xs, f32* ys, f32* radii, s32 count, u64* hit_mask, f32* tois);
+
+struct Math_Kernels {
+  Sincos_N_Proc*                sincos_n;
+  Vec2_Transform_Points_Proc*   vec2_transform_points;
+  Vec2_Normalize_N_Proc*        vec2_normalize_n;
+  Vec2_Lerp_N_Proc*             vec2_lerp_n;
+  Vec2_Length_Sq_N_Proc*        vec2_length_sq_n;
+  Capsule_Vs_Circles_Proc*      capsule_vs_circles;
+  Swept_Circle_Vs_Circles_Proc* swept_circle_vs_circles;
+};
+
+Math_Kernels math_kernels_scalar(void) {
+  Math_Kernels r = {};
+  r.sincos_n                = sincos_n_scalar;
+  r.vec2_transform_points   = vec2_transform_points_scalar;
+  r.vec2_normalize_n        = vec2_normalize_n_scalar;
+  r.vec2_lerp_n             = vec2_lerp_n_scalar;
+  r.vec2_length_sq_n        = vec2_length_sq_n_scalar;
+  r.capsule_vs_circles      = capsule_vs_circles_scalar;
+  r.swept_circle_vs_circles = swept_circle_vs_circles_scalar;
+  return r;
+}
+
+global_var Math_Kernels global_math_kernels = math_kernels_scalar();
+
+void math_bind_kernels(Simd_Level level) {
+  Math_Kernels* k = &global_math_kernels;
+  *k = math_kernels_scalar();
+  
+#if GAME_SSE2
+  if(level >= Simd_Level_SSE2) {
+    k->sincos_n                = sincos_n_sse2;
+    k->vec2_transform_points   = vec2_transform_points_sse2;
+    k->vec2_normalize_n        = vec2_normalize_n_sse2;
+    k->vec2_lerp_n             = vec2_lerp_n_sse2;
+    k->vec2_length_sq_n        = vec2_length_sq_n_sse2;
+    k->capsule_vs_circles      = capsule_vs_circles_sse2;
+    k->swept_circle_vs_circles = swept_circle_vs_circles_sse2;
+  }
+#endif
+#if GAME_AVX2
+  if(level >= Simd_Level_AVX2) {
+    k->sincos_n                = sincos_n_avx2;
+    k->capsule_vs_circles      = capsule_vs_circles_avx2;
+    k->swept_circle_vs_circles = swept_circle_vs_circles_avx2;
+  }
+#endif
+}
+
+void sincos_n(f32* sin_out, f32* cos_out, f32* angles, s32 count, Trig_Accuracy accuracy = Trig_Accuracy_High) {
+#if GAME_DETERMINISTIC
+  if(accuracy == Trig_Accuracy_High) {
+    sincos_n_scalar(sin_out, cos_out, angles, count, accuracy);
+    return;
+  }
+#endif
+  global_math_kernels.sincos_n(sin_out, cos_out, angles, count, accuracy);
+}
+
+void vec2_transform_points(Vec2* out, Vec2* in, s32 count, f32 angle, f32 scale, Vec2 offset) {
+  global_math_kernels.vec2_transform_points(out, in, count, angle, scale, offset);
+}
+
+void vec2_rotate_points(Vec2* out, Vec2* in, s32 count, f32 angle) {
+  vec2_transform_points(out, in, count, angle, 1.0f, {0, 0});
+}
+
+void vec2_normalize_n(Vec2* out, Vec2* in, s32 count)               { global_math_kernels.vec2_normalize_n(out, in, count); }
+void vec2_lerp_n(Vec2* out, Vec2* a, Vec2* b, s32 count, f32 t)     { global_math_kernels.vec2_lerp_n(out, a, b, count, t); }
+void vec2_length_sq_n(f32* out, Vec2* in, s32 count)                { global_math_kernels.vec2_length_sq_n(out, in, count); }
+
+void capsule_vs_circles(Vec2 a, Vec2 b, f32 capsule_radius,
+                        f32* xs, f32* ys, f32* radii, s32 count, u64* hit_mask) {
+  global_math_kernels.capsule_vs_circles(a, b, capsule_radius, xs, ys, radii, count, hit_mask);
+}
+
+void swept_circle_vs_circles(Vec2 p0, Vec2 p1, f32 r0,
+                             f32* xs, f32* ys, f32* radii, s32 count, u64* hit_mask, f32* tois) {
+  global_math_kernels.swept_circle_vs_circles(p0, p1, r0, xs, ys, radii, count, hit_mask, tois);
+}
+
 //
 // Note: Vec3
 //
@@ -118,6 +118,10 @@ Allocator allocator_create(u8* base, u64 size) {
 
 u8* allocator_alloc(Allocator* allocator, u64 desired_size) {
   
+  // Rounded up so the entry behind the allocation, and with it the next allocation, stay
+  // 8 byte aligned.
+  desired_size = (desired_size + 7) & ~7ULL;
+  
   Free_List_Entry* best = NULL;
   Free_List_Entry* prev = NULL;
   
@@ -194,6 +198,15 @@ u8* allocator_alloc(Allocator* allocator, u64 desired_size) {
 #define allocator_alloc_struct(allocator, type)       (type*)allocator_alloc(allocator, sizeof(type))
 #define allocator_alloc_array(allocator, type, count) (type*)allocator_alloc(allocator, sizeof(type)*count)
 
+// One past the last allocation, the alloc_list is sorted by position.
+u8* allocator_allocations_end(Allocator* allocator) {
+  u8* r = allocator->base;
+  for(Allocation_Header* header = allocator->alloc_list.first; header; header = header->next) {
+    r = allocator->base + header->pos + header->size;
+  }
+  return r;
+}
+
 void allocator_free(Allocator* allocator, void* ptr) {
   if(ptr == NULL) return;
   
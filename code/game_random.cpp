@@ -1,63 +1,313 @@
-
 //
 // Game Random
 //
+// xoshiro128+ (Blackman and Vigna). The state is seeded with splitmix64, random_jump moves
+// a series 2^64 numbers ahead, so series split off one seed with jumps never overlap.
+//
+// The game draws from separate streams, so e.g. drawing more particles or explosions never
+// changes what the spawning code gets. Random_Series_Wide is four series side by side for
+// filling whole arrays, with SSE2 four numbers at a time. Particles draw from those, one
+// per job worker.
+//
+// Random_Counter has no state to share at all, see the counter based section at the end.
+//
 
 struct Random_Series {
-  u32 seed;
-  u32 index;
+  u32 s[4];
 };
 
+u32 random_rotl(u32 x, s32 k) { return (x << k) | (x >> (32 - k)); }
+
+// splitmix64's finalizer.
+u64 random_mix64(u64 x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30))*0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27))*0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
 void random_begin(Random_Series* series, u32 seed) {
-  series->seed = seed;
-  series->index = seed;
+  Loop(i, 2) {
+    u64 z = random_mix64((u64)seed + (u64)i*0x9e3779b97f4a7c15ULL);
+    series->s[2*i + 0] = (u32)z;
+    series->s[2*i + 1] = (u32)(z >> 32);
+  }
 }
 
+// The low bits are the weakest, everything below uses the high ones.
 u32 random_u32(Random_Series* series) {
-  u32 r = series->index;
+  u32* s = series->s;
+  u32 r = s[0] + s[3];
+  u32 t = s[1] << 9;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = random_rotl(s[3], 11);
 
-  // xorshift from handmade hero
-  r ^= (r << 13);
-  r ^= (r >> 7);
-  r ^= (r << 17);
-  
-  series->index = r;
   return r;
 }
 
+// Same as 2^64 calls to random_u32.
+void random_jump(Random_Series* series) {
+  u32 jump[4] = {0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b};
+
+  u32 s[4] = {};
+  Loop(i, 4) {
+    Loop(b, 32) {
+      if(jump[i] & (1u << b)) {
+        Loop(k, 4) s[k] ^= series->s[k];
+      }
+      random_u32(series);
+    }
+  }
+  Loop(k, 4) series->s[k] = s[k];
+}
+
 b32 random_b32(Random_Series* series) {
-  b32 r = (random_u32(series)%2 == 0);
+  b32 r = (random_u32(series) >> 31) == 0;
   return r;
 }
 
+// [0, 1) in steps of 2^-24, every float the top 24 bits can make.
 f32 random_f32(Random_Series* series) {
-  f32 d = (f32)(random_u32(series)%1000 + 1);
-  f32 r = d/1000.0f;
+  f32 r = (f32)(random_u32(series) >> 8)*(1.0f/16777216.0f);
   return r;
 }
 
+// [min, max) without modulo bias (Lemire's multiply and reject).
+s32 random_range(Random_Series* series, s32 min, s32 max) {
+  Assert(max > min);
+  u32 range = (u32)(max - min);
 
-b32 random_chance(Random_Series* series, int value) {
-  b32 r = (random_u32(series)%value == 0);
+  u64 m = (u64)random_u32(series)*range;
+  if((u32)m < range) {
+    u32 threshold = (0u - range)%range;
+    while((u32)m < threshold) m = (u64)random_u32(series)*range;
+  }
+
+  s32 r = min + (s32)(m >> 32);
   return r;
 }
 
-s32 random_range(Random_Series* random, s32 min, s32 max) {
-  s32 r = min + (s32)(random_u32(random)%(max - min));
+// One in 'value'.
+b32 random_chance(Random_Series* series, int value) {
+  b32 r = (random_range(series, 0, value) == 0);
   return r;
 }
 
-global_var Random_Series global_random;
+//
+// Wide series
+//
+
+struct Random_Series_Wide {
+  u32 s[4][4]; // s[k][lane] is word k of that lane's state
+};
+
+// The lanes are 'series' jumped 0, 1, 2 and 3 times, series ends up past all of them.
+void random_begin_wide(Random_Series_Wide* wide, Random_Series* series) {
+  Loop(lane, 4) {
+    Loop(k, 4) wide->s[k][lane] = series->s[k];
+    random_jump(series);
+  }
+}
+
+// out[i] in [min, max), fills count rounded up to four numbers of the series.
+void random_fill_f32_scalar(Random_Series_Wide* wide, f32* out, s32 count, f32 min, f32 max) {
+  u32 (*s)[4] = wide->s;
+
+  for(s32 i = 0; i < count; i += 4) {
+    Loop(lane, 4) {
+      u32 r = s[0][lane] + s[3][lane];
+      u32 t = s[1][lane] << 9;
+      s[2][lane] ^= s[0][lane];
+      s[3][lane] ^= s[1][lane];
+      s[1][lane] ^= s[2][lane];
+      s[0][lane] ^= s[3][lane];
+      s[2][lane] ^= t;
+      s[3][lane] = random_rotl(s[3][lane], 11);
+
+      f32 u = (f32)(s32)(r >> 8)*(1.0f/16777216.0f);
+      if(i + lane < count) out[i + lane] = min + u*(max - min);
+    }
+  }
+}
+
+#if GAME_SSE2
+void random_fill_f32_sse2(Random_Series_Wide* wide, f32* out, s32 count, f32 min, f32 max) {
+  __m128i s0 = _mm_loadu_si128((__m128i*)wide->s[0]);
+  __m128i s1 = _mm_loadu_si128((__m128i*)wide->s[1]);
+  __m128i s2 = _mm_loadu_si128((__m128i*)wide->s[2]);
+  __m128i s3 = _mm_loadu_si128((__m128i*)wide->s[3]);
+
+  __m128 scale = _mm_set1_ps(1.0f/16777216.0f);
+  __m128 vmin  = _mm_set1_ps(min);
+  __m128 span  = _mm_set1_ps(max - min);
+
+  for(s32 i = 0; i < count; i += 4) {
+    __m128i r = _mm_add_epi32(s0, s3);
+    __m128i t = _mm_slli_epi32(s1, 9);
+    s2 = _mm_xor_si128(s2, s0);
+    s3 = _mm_xor_si128(s3, s1);
+    s1 = _mm_xor_si128(s1, s2);
+    s0 = _mm_xor_si128(s0, s3);
+    s2 = _mm_xor_si128(s2, t);
+    s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+
+    __m128 u = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(r, 8)), scale);
+    __m128 v = _mm_add_ps(vmin, _mm_mul_ps(u, span));
+
+    if(i + 4 <= count) {
+      _mm_storeu_ps(out + i, v);
+    }
+    else {
+      f32 tail[4];
+      _mm_storeu_ps(tail, v);
+      for(s32 lane = 0; i + lane < count; lane++) out[i + lane] = tail[lane];
+    }
+  }
+
+  _mm_storeu_si128((__m128i*)wide->s[0], s0);
+  _mm_storeu_si128((__m128i*)wide->s[1], s1);
+  _mm_storeu_si128((__m128i*)wide->s[2], s2);
+  _mm_storeu_si128((__m128i*)wide->s[3], s3);
+}
+#endif
+
+typedef void Random_Fill_F32_Proc(Random_Series_Wide* wide, f32* out, s32 count, f32 min, f32 max);
+
+global_var Random_Fill_F32_Proc* global_random_fill_f32_kernel = random_fill_f32_scalar;
+
+void random_bind_kernels(Simd_Level level) {
+  global_random_fill_f32_kernel = random_fill_f32_scalar;
+#if GAME_SSE2
+  if(level >= Simd_Level_SSE2) global_random_fill_f32_kernel = random_fill_f32_sse2;
+#endif
+}
+
+void random_fill_f32(Random_Series_Wide* wide, f32* out, s32 count, f32 min, f32 max) {
+  global_random_fill_f32_kernel(wide, out, count, min, max);
+}
+
+void random_fill_f32(Random_Series_Wide* wide, f32* out, s32 count, Vec2 range) {
+  random_fill_f32(wide, out, count, range.min, range.max);
+}
+
+//
+// Streams
+//
+
+enum Random_Stream {
+  Random_Stream_Gameplay, // spawns, levels, anything the simulation depends on
+  Random_Stream_Cosmetic, // only changes how things look
+
+  Random_Stream_Count
+};
+
+global_var Random_Series global_random_streams[Random_Stream_Count];
+global_var u64 global_random_key;
+
+// Particles only change how things look. Every worker has its own stream, so spawning
+// them from a parallel pass doesn't need any locking.
+global_var Random_Series_Wide global_particle_streams[MAX_JOB_WORKERS];
+
+
+// All streams come from one seed, a jump apart.
+void random_begin(u32 seed) {
+  Random_Series series;
+  random_begin(&series, seed);
+
+  Loop(i, Random_Stream_Count) {
+    global_random_streams[i] = series;
+    random_jump(&series);
+  }
+  Loop(worker, MAX_JOB_WORKERS) random_begin_wide(&global_particle_streams[worker], &series);
+  global_random_key = random_mix64(seed) | 1;
+}
 
-void random_begin(u32 seed)  { random_begin(&global_random, seed); }
-u32  random_u32(void)         { return random_u32(&global_random); }
-b32  random_b32(void)         { return random_b32(&global_random); }
-f32  random_f32(void)         { return random_f32(&global_random); }
+Random_Series* random_stream(Random_Stream stream) { return &global_random_streams[stream]; }
+
+// The one of the worker we're running on.
+Random_Series_Wide* random_particle_stream(void) { return &global_particle_streams[job_this_worker()]; }
+
+// The plain calls draw from the gameplay stream.
+u32  random_u32(void) { return random_u32(&global_random_streams[Random_Stream_Gameplay]); }
+b32  random_b32(void) { return random_b32(&global_random_streams[Random_Stream_Gameplay]); }
+f32  random_f32(void) { return random_f32(&global_random_streams[Random_Stream_Gameplay]); }
 
 f32 random_f32(f32 min, f32 max) {
   f32 r = min + random_f32()*(max - min);
   return r;
 }
 
-b32  random_chance(int value)       { return random_chance(&global_random, value); }
-s32  random_range(int min, int max) { return random_range(&global_random, min, max); }
+b32  random_chance(int value)       { return random_chance(&global_random_streams[Random_Stream_Gameplay], value); }
+s32  random_range(int min, int max) { return random_range(&global_random_streams[Random_Stream_Gameplay], min, max); }
+
+// Where all the streams are, to put them back later (e.g. with a snapshot of the game).
+struct Random_State {
+  Random_Series streams[Random_Stream_Count];
+  Random_Series_Wide particle_streams[MAX_JOB_WORKERS];
+  u64 key;
+};
+
+Random_State random_save(void) {
+  Random_State r = {};
+  Loop(i, Random_Stream_Count) r.streams[i] = global_random_streams[i];
+  Loop(i, MAX_JOB_WORKERS) r.particle_streams[i] = global_particle_streams[i];
+  r.key = global_random_key;
+  return r;
+}
+
+void random_restore(Random_State* state) {
+  Loop(i, Random_Stream_Count) global_random_streams[i] = state->streams[i];
+  Loop(i, MAX_JOB_WORKERS) global_particle_streams[i] = state->particle_streams[i];
+  global_random_key = state->key;
+}
+
+//
+// Counter based
+//
+// Squares (Widynski) turns a 64 bit counter and the key into a number, nothing is carried
+// from one number to the next. random_counter hashes what the numbers are for into the
+// starting counter: an object, a tick, a purpose and an index within the object. Whoever
+// asks with the same four gets the same numbers, in any order and on any worker.
+//
+
+struct Random_Counter {
+  u64 counter;
+};
+
+u32 random_squares32(u64 counter, u64 key) {
+  u64 x = counter*key;
+  u64 y = x;
+  u64 z = y + key;
+  
+  x = x*x + y; x = (x >> 32) | (x << 32);
+  x = x*x + z; x = (x >> 32) | (x << 32);
+  x = x*x + y; x = (x >> 32) | (x << 32);
+  return (u32)((x*x + z) >> 32);
+}
+
+Random_Counter random_counter(u32 id, u32 tick, u32 purpose, u32 index = 0) {
+  Random_Counter r = {};
+  r.counter = random_mix64(((u64)id << 32 | tick) ^ random_mix64((u64)purpose << 32 | index));
+  return r;
+}
+
+u32 random_u32(Random_Counter* c) {
+  u32 r = random_squares32(c->counter, global_random_key);
+  c->counter += 1;
+  return r;
+}
+
+f32 random_f32(Random_Counter* c) {
+  f32 r = (f32)(random_u32(c) >> 8)*(1.0f/16777216.0f);
+  return r;
+}
+
+f32 random_f32(Random_Counter* c, Vec2 range) {
+  f32 r = range.min + random_f32(c)*(range.max - range.min);
+  return r;
+}
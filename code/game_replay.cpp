@@ -0,0 +1,437 @@
+//
+// Replay
+//
+// A replay is one level from set_level_to_initial_state on: the seed it started with, the
+// input of every tick and, every state_interval ticks, the simulation state flattened into
+// State_Sections together with their hashes. The clock starts over at tick 0 for every
+// replayed level, so none of it depends on what was played before.
+//
+// GAME_REPLAY_RECORD=path writes one, every new level starts the file over.
+// GAME_REPLAY_CHECK=path starts the game right in the recorded level, feeds it the recorded
+// input and compares the hashes. The first state that differs is diffed field by field
+// against the recorded one. Recording with one build and checking with another is the
+// cross build check, e.g. the build.bat build against a Linux one, both with
+// GAME_DETERMINISTIC, or the build before a change to the update order against the one
+// after. game_test records one every run and 'game_test check path' checks another
+// build's, see test_sim.cpp.
+//
+
+#define REPLAY_MAGIC   0x59414c50 // "PLAY"
+#define REPLAY_VERSION 4
+
+#define REPLAY_MAX_SECTIONS   8
+#define REPLAY_MAX_DIFF_LINES 32
+
+//
+// State sections
+//
+
+enum State_Field_Type {
+  State_Field_S32,
+  State_Field_U32,
+  State_Field_F32,
+};
+
+struct State_Field {
+  char* name;
+  State_Field_Type type;
+};
+
+// One part of the simulation state as records of field_count words. Only values, so it's
+// the same for any build that simulates the same.
+struct State_Section {
+  char* name;
+  State_Field* fields;
+  s32 field_count;
+
+  u32* words;
+  s32 word_count;
+  s32 word_capacity;
+};
+
+void state_section_init(State_Section* section, Allocator* allocator, char* name, State_Field* fields, s32 field_count, s32 record_capacity) {
+  *section = {};
+  section->name          = name;
+  section->fields        = fields;
+  section->field_count   = field_count;
+  section->word_capacity = field_count*record_capacity;
+  section->words         = allocator_alloc_array(allocator, u32, section->word_capacity);
+}
+
+void state_put(State_Section* section, u32 value) {
+  Assert(section->word_count < section->word_capacity);
+  section->words[section->word_count++] = value;
+}
+
+void state_put(State_Section* section, s32 value) { state_put(section, (u32)value); }
+
+void state_put(State_Section* section, f32 value) {
+  u32 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  state_put(section, bits);
+}
+
+s32 state_record_count(State_Section* section, s32 word_count) { return word_count/section->field_count; }
+
+//
+// Replay files
+//
+
+// Everything the simulation reads from the player, sampled once per tick.
+struct Sim_Input {
+  Vec2 move_dir;
+  Vec2 shoot_dir;
+};
+
+struct Replay_Header {
+  u32 magic;
+  u32 version;
+  u32 seed;
+  s32 level_played_times;
+  u32 is_deterministic; // GAME_DETERMINISTIC of the build that recorded it
+  s32 state_interval;
+  s32 section_count;
+};
+
+// Every record in the file starts with its type.
+enum Replay_Record_Type {
+  Replay_Record_Tick = 1,
+  Replay_Record_State,
+};
+
+struct Replay_Tick {
+  Sim_Input input;
+  b32 should_update_level; // false for the ticks that run behind the death screen
+};
+
+// Followed by the words of every section, one after the other.
+struct Replay_State {
+  u32 tick;
+  u64 hashes[REPLAY_MAX_SECTIONS];
+  s32 word_counts[REPLAY_MAX_SECTIONS];
+};
+
+enum Replay_Mode {
+  Replay_Mode_None,
+  Replay_Mode_Record,
+  Replay_Mode_Check,
+};
+
+struct Replay {
+  Replay_Mode mode;
+  char* path;
+  Replay_Header header;
+  s32 state_interval;
+  s32 section_count;
+
+  // recording
+  FILE* file;
+
+  // checking, the whole file is read at once and walked along with the ticks
+  u8* data;
+  s64 size;
+  s64 cursor;
+  s32 tick_count;
+  s32 state_count;
+  s32 mismatch_count;
+  u32 first_mismatch_tick;
+  b32 is_done;
+};
+
+global_var Replay global_replay;
+
+b32 replay_is_active(void)   { return global_replay.mode != Replay_Mode_None; }
+b32 replay_is_checking(void) { return global_replay.mode == Replay_Mode_Check && !global_replay.is_done; }
+
+// The next size bytes of the replay being checked, NULL past the end.
+void* replay_peek(Replay* r, s64 size) {
+  if(r->cursor + size > r->size) return NULL;
+  return r->data + r->cursor;
+}
+
+void* replay_take(Replay* r, s64 size) {
+  void* p = replay_peek(r, size);
+  if(p) r->cursor += size;
+  return p;
+}
+
+// Records are only 4 byte aligned in the file, the ones with u64s in them are copied out.
+b32 replay_read(Replay* r, void* out, s64 size) {
+  void* p = replay_take(r, size);
+  if(p) memcpy(out, p, size);
+  return p != NULL;
+}
+
+u32 replay_peek_type(Replay* r) {
+  u32* type = (u32*)replay_peek(r, sizeof(u32));
+  return type ? *type : 0;
+}
+
+// Records to record_path, or else checks check_path, NULL for neither. A replay that can't
+// be read turns checking off.
+void replay_open(char* record_path, char* check_path) {
+  Replay* r = &global_replay;
+  s32 state_interval = r->state_interval;
+  s32 section_count  = r->section_count;
+  *r = {};
+  r->state_interval = state_interval;
+  r->section_count  = section_count;
+
+  if(record_path && record_path[0]) {
+    r->mode = Replay_Mode_Record;
+    r->path = record_path;
+    return;
+  }
+  if(!check_path || !check_path[0]) return;
+
+  FILE* file = fopen(check_path, "rb");
+  if(!file) {
+    TraceLog(LOG_WARNING, "REPLAY: Can't open %s", check_path);
+    return;
+  }
+
+  fseek(file, 0, SEEK_END);
+  r->size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  r->data = (u8*)MemAlloc((u32)Max(r->size, 1));
+  b32 ok = fread(r->data, 1, (size_t)r->size, file) == (size_t)r->size;
+  fclose(file);
+
+  Replay_Header* header = (Replay_Header*)replay_take(r, sizeof(Replay_Header));
+  ok = ok && header && header->magic == REPLAY_MAGIC && header->version == REPLAY_VERSION;
+  ok = ok && header->section_count == section_count;
+
+  if(!ok) {
+    TraceLog(LOG_WARNING, "REPLAY: %s is not a replay of this version", check_path);
+    MemFree(r->data);
+    replay_open(NULL, NULL);
+    return;
+  }
+
+  if(header->is_deterministic != GAME_DETERMINISTIC) {
+    TraceLog(LOG_WARNING, "REPLAY: Recorded with GAME_DETERMINISTIC %d, this build has %d", header->is_deterministic, GAME_DETERMINISTIC);
+  }
+
+  r->mode   = Replay_Mode_Check;
+  r->path   = check_path;
+  r->header = *header;
+  TraceLog(LOG_INFO, "REPLAY: Checking %s, a state every %d ticks", check_path, header->state_interval);
+}
+
+// Back to neither, with the file written out.
+void replay_close(void) {
+  Replay* r = &global_replay;
+  if(r->file) fclose(r->file);
+  if(r->data) MemFree(r->data);
+  replay_open(NULL, NULL);
+}
+
+// Picks the mode from the environment.
+void replay_init(s32 state_interval, s32 section_count) {
+  Assert(section_count <= REPLAY_MAX_SECTIONS);
+
+  Replay* r = &global_replay;
+  r->state_interval = state_interval;
+  r->section_count  = section_count;
+  replay_open(getenv("GAME_REPLAY_RECORD"), getenv("GAME_REPLAY_CHECK"));
+}
+
+s32 replay_level_played_times(void) { return global_replay.header.level_played_times; }
+
+// Called when a level starts, returns the seed to start it with. Recording makes up a new
+// one from 'seed'.
+u32 replay_begin_level(u32 seed, s32 level_played_times) {
+  Replay* r = &global_replay;
+
+  if(r->mode == Replay_Mode_Record) {
+    if(r->file) fclose(r->file);
+    r->file = fopen(r->path, "wb");
+    if(!r->file) {
+      TraceLog(LOG_WARNING, "REPLAY: Can't write %s", r->path);
+      r->mode = Replay_Mode_None;
+      return seed;
+    }
+
+    r->header = {};
+    r->header.magic   = REPLAY_MAGIC;
+    r->header.version = REPLAY_VERSION;
+    r->header.seed    = seed;
+    r->header.level_played_times = level_played_times;
+    r->header.is_deterministic   = GAME_DETERMINISTIC;
+    r->header.state_interval     = r->state_interval;
+    r->header.section_count      = r->section_count;
+    fwrite(&r->header, sizeof(r->header), 1, r->file);
+  }
+
+  if(r->mode == Replay_Mode_Check) {
+    // Only the level the game starts in is the recorded one.
+    if(r->tick_count > 0) r->is_done = true;
+    else                  seed = r->header.seed;
+  }
+
+  return seed;
+}
+
+void replay_finish_check(Replay* r) {
+  r->is_done = true;
+  if(r->mismatch_count) {
+    TraceLog(LOG_WARNING, "REPLAY: %d of %d states differ, the first at tick %u", r->mismatch_count, r->state_count, r->first_mismatch_tick);
+  }
+  else {
+    TraceLog(LOG_INFO, "REPLAY: All %d states of %d ticks match", r->state_count, r->tick_count);
+  }
+}
+
+// Swaps in the recorded input while checking.
+void replay_input(Sim_Input* input, b32* should_update_level) {
+  Replay* r = &global_replay;
+  if(!replay_is_checking()) return;
+
+  Replay_Tick* tick = NULL;
+  if(replay_peek_type(r) == Replay_Record_Tick) {
+    replay_take(r, sizeof(u32));
+    tick = (Replay_Tick*)replay_take(r, sizeof(Replay_Tick));
+  }
+  if(!tick) {
+    replay_finish_check(r);
+    return;
+  }
+
+  *input = tick->input;
+  *should_update_level = tick->should_update_level;
+  r->tick_count += 1;
+}
+
+// Whether replay_end_tick wants the state this tick ends in.
+b32 replay_wants_state(u32 tick) {
+  Replay* r = &global_replay;
+
+  if(r->mode == Replay_Mode_Record) {
+    return r->file && r->state_interval > 0 && tick % r->state_interval == 0;
+  }
+  if(replay_is_checking() && replay_peek_type(r) == Replay_Record_State) {
+    u8* record = (u8*)replay_peek(r, sizeof(u32) + sizeof(Replay_State));
+    if(!record) return false;
+
+    Replay_State state;
+    memcpy(&state, record + sizeof(u32), sizeof(state));
+    return state.tick == tick;
+  }
+  return false;
+}
+
+void replay_format_field(char* buffer, s32 buffer_size, State_Field_Type type, u32 word) {
+  switch(type) {
+    case State_Field_S32: { snprintf(buffer, buffer_size, "%d", (s32)word); } break;
+    case State_Field_U32: { snprintf(buffer, buffer_size, "%u", word);      } break;
+    case State_Field_F32: {
+      f32 value;
+      memcpy(&value, &word, sizeof(value));
+      snprintf(buffer, buffer_size, "%.9g", value);
+    } break;
+  }
+}
+
+// Logs the fields that differ in the sections whose hash doesn't match, records are
+// compared by position.
+void replay_diff_state(Replay_State* recorded, u32* recorded_words, State_Section* sections, u64* hashes) {
+  Replay* r = &global_replay;
+  s32 lines = 0;
+
+  Loop(i, r->section_count) {
+    State_Section* section = &sections[i];
+    u32* words = recorded_words;
+    recorded_words += recorded->word_counts[i];
+
+    if(recorded->hashes[i] == hashes[i]) continue;
+
+    s32 recorded_records = state_record_count(section, recorded->word_counts[i]);
+    s32 records          = state_record_count(section, section->word_count);
+    TraceLog(LOG_WARNING, "REPLAY:   %s differs, %d records recorded, %d now", section->name, recorded_records, records);
+
+    Loop(record, Min(recorded_records, records)) {
+      Loop(field, section->field_count) {
+        s64 at = record*section->field_count + field;
+        if(words[at] == section->words[at]) continue;
+
+        if(lines == REPLAY_MAX_DIFF_LINES) {
+          TraceLog(LOG_WARNING, "REPLAY:     ...");
+          return;
+        }
+        lines += 1;
+
+        State_Field* f = &section->fields[field];
+        char was[32], is[32];
+        replay_format_field(was, sizeof(was), f->type, words[at]);
+        replay_format_field(is,  sizeof(is),  f->type, section->words[at]);
+        TraceLog(LOG_WARNING, "REPLAY:     %s[%d].%s: %s recorded, %s now", section->name, (s32)record, f->name, was, is);
+      }
+    }
+  }
+}
+
+// Called after every tick with what it ran on and, if replay_wants_state said so, the
+// sections of the state it ended in.
+void replay_end_tick(u32 tick, Sim_Input input, b32 should_update_level, State_Section* sections) {
+  Replay* r = &global_replay;
+
+  u64 hashes[REPLAY_MAX_SECTIONS] = {};
+  if(sections) {
+    Loop(i, r->section_count) hashes[i] = hash64(sections[i].words, sections[i].word_count*sizeof(u32));
+  }
+
+  if(r->mode == Replay_Mode_Record && r->file) {
+    u32 type = Replay_Record_Tick;
+    Replay_Tick t = {};
+    t.input = input;
+    t.should_update_level = should_update_level;
+    fwrite(&type, sizeof(type), 1, r->file);
+    fwrite(&t, sizeof(t), 1, r->file);
+
+    if(sections) {
+      Replay_State state = {};
+      state.tick = tick;
+      Loop(i, r->section_count) {
+        state.hashes[i]      = hashes[i];
+        state.word_counts[i] = sections[i].word_count;
+      }
+      type = Replay_Record_State;
+      fwrite(&type, sizeof(type), 1, r->file);
+      fwrite(&state, sizeof(state), 1, r->file);
+      Loop(i, r->section_count) fwrite(sections[i].words, sizeof(u32), sections[i].word_count, r->file);
+    }
+  }
+
+  if(replay_is_checking()) {
+    if(sections) {
+      replay_take(r, sizeof(u32));
+      Replay_State recorded;
+      u32* recorded_words = NULL;
+      if(replay_read(r, &recorded, sizeof(recorded))) {
+        s64 word_count = 0;
+        Loop(i, r->section_count) word_count += recorded.word_counts[i];
+        recorded_words = (u32*)replay_take(r, word_count*sizeof(u32));
+      }
+      if(!recorded_words) {
+        replay_finish_check(r);
+        return;
+      }
+
+      b32 matches = true;
+      Loop(i, r->section_count) matches = matches && recorded.hashes[i] == hashes[i];
+
+      if(!matches) {
+        if(r->mismatch_count == 0) {
+          r->first_mismatch_tick = tick;
+          TraceLog(LOG_WARNING, "REPLAY: State differs first at tick %u", tick);
+          replay_diff_state(&recorded, recorded_words, sections, hashes);
+        }
+        r->mismatch_count += 1;
+      }
+      r->state_count += 1;
+    }
+
+    if(r->cursor == r->size) replay_finish_check(r);
+  }
+}
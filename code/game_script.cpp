@@ -0,0 +1,32 @@
+//
+// Script
+//
+// Stackless coroutines for entity behaviour, protothread style. A script is a plain
+// function whose body sits between ScriptBegin and ScriptEnd. ScriptYield and ScriptWait
+// return from it and the next call jumps straight back to where it left off.
+//
+// Locals don't survive a yield, anything that has to lives in the entity. A yield can't
+// come after a local declared in the same block (the jump back would skip its
+// initialization), wrap that code in its own braces.
+//
+
+struct Script {
+  s32 resume_point; // 0 is the start of the script
+  u32 wake_tick;    // not resumed before this tick
+  b32 is_done;
+};
+
+b32 script_should_resume(Script* script, u32 tick) {
+  b32 r = !script->is_done && tick >= script->wake_tick;
+  return r;
+}
+
+#define ScriptBegin(script) switch((script)->resume_point) { case 0:
+#define ScriptEnd(script)   } (script)->is_done = true; return
+
+// __COUNTER__ instead of __LINE__ so two yields can share a line, it's expanded once per
+// use and passed on so the store and the case label get the same value.
+#define ScriptYield(script) ScriptYield_(script, __COUNTER__ + 1)
+#define ScriptYield_(script, point) do { (script)->resume_point = (point); return; case (point):; } while(0)
+
+#define ScriptWaitTicks(script, now_tick, ticks) do { (script)->wake_tick = (now_tick) + (ticks); ScriptYield(script); } while(0)
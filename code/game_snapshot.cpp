@@ -0,0 +1,77 @@
+//
+// Snapshots
+//
+// A ring of copies of one block of memory, a save overwrites the oldest copy. Saving and
+// restoring are one memcpy each. Restoring copies back to the same addresses, the block
+// never moves, so pointers in it that point into it stay right and don't have to be
+// offsets.
+//
+
+#include <string.h>
+
+struct Snapshot_Ring {
+  u8* block;
+  s64 block_size;
+
+  u8*  copies;  // capacity copies of the block, back to back
+  u32* ticks;   // what each copy was saved on
+  s32 capacity;
+  s32 newest;
+  s32 count;
+
+  // of the last save and restore, for the debug info
+  f64 save_seconds;
+  f64 restore_seconds;
+};
+
+void snapshot_ring_init(Snapshot_Ring* ring, Allocator* allocator, u8* block, s64 block_size, s32 capacity) {
+  Assert(capacity > 0);
+
+  *ring = {};
+  ring->block      = block;
+  ring->block_size = block_size;
+  ring->copies     = (u8*)allocator_alloc(allocator, block_size*capacity);
+  ring->ticks      = allocator_alloc_array(allocator, u32, capacity);
+  ring->capacity   = capacity;
+  ring->newest     = capacity - 1;
+  Assert(ring->copies && ring->ticks);
+}
+
+void snapshot_ring_clear(Snapshot_Ring* ring) { ring->count = 0; }
+
+u8* snapshot_copy(Snapshot_Ring* ring, s32 index) {
+  u8* r = ring->copies + (s64)index*ring->block_size;
+  return r;
+}
+
+void snapshot_save(Snapshot_Ring* ring, u32 tick) {
+  f64 start_time = GetTime();
+
+  ring->newest = (ring->newest + 1) % ring->capacity;
+  memcpy(snapshot_copy(ring, ring->newest), ring->block, ring->block_size);
+  ring->ticks[ring->newest] = tick;
+  if(ring->count < ring->capacity) ring->count += 1;
+
+  ring->save_seconds = GetTime() - start_time;
+}
+
+// Goes back to the copy 'back' saves before the newest one. The copies after it are
+// dropped, that future isn't going to happen anymore. The one restored is kept, so e.g. a
+// look ahead can come back to the same tick again and again.
+b32 snapshot_restore(Snapshot_Ring* ring, s32 back = 0) {
+  if(back < 0 || back >= ring->count) return false;
+
+  f64 start_time = GetTime();
+
+  ring->newest = (ring->newest - back + ring->capacity) % ring->capacity;
+  ring->count -= back;
+  memcpy(ring->block, snapshot_copy(ring, ring->newest), ring->block_size);
+
+  ring->restore_seconds = GetTime() - start_time;
+  return true;
+}
+
+u32 snapshot_newest_tick(Snapshot_Ring* ring) {
+  Assert(ring->count > 0);
+  return ring->ticks[ring->newest];
+}
@@ -0,0 +1,43 @@
+//
+// Sorting
+//
+
+// Stable LSD radix sort of (key, value) pairs by key, a byte per pass. Bytes that are the
+// same for every key are skipped. The result ends up in keys/values, tmp_keys/tmp_values
+// are scratch space of the same size.
+void radix_sort_u64(u64* keys, u32* values, u64* tmp_keys, u32* tmp_values, s32 count) {
+  u64* src_keys   = keys;
+  u32* src_values = values;
+  u64* dst_keys   = tmp_keys;
+  u32* dst_values = tmp_values;
+
+  for(s32 shift = 0; shift < 64; shift += 8) {
+    s32 offsets[256] = {};
+    Loop(i, count) offsets[(src_keys[i] >> shift) & 0xff] += 1;
+
+    if(count == 0 || offsets[(src_keys[0] >> shift) & 0xff] == count) continue;
+
+    s32 total = 0;
+    Loop(b, 256) {
+      s32 c = offsets[b];
+      offsets[b] = total;
+      total += c;
+    }
+
+    Loop(i, count) {
+      s32 at = offsets[(src_keys[i] >> shift) & 0xff]++;
+      dst_keys[at]   = src_keys[i];
+      dst_values[at] = src_values[i];
+    }
+
+    u64* swap_keys   = src_keys;   src_keys   = dst_keys;   dst_keys   = swap_keys;
+    u32* swap_values = src_values; src_values = dst_values; dst_values = swap_values;
+  }
+
+  if(src_keys != keys) {
+    Loop(i, count) {
+      keys[i]   = src_keys[i];
+      values[i] = src_values[i];
+    }
+  }
+}
@@ -1,6 +1,9 @@
-
 //
-// Timer 
+// Timer
+//
+// Timers are a start and an end tick on the fixed simulation clock, so there is nothing
+// to accumulate: ended/active are compares against the current tick and the progress is
+// worked out when it's asked for.
 //
 
 enum Timer_State {
@@ -12,29 +15,67 @@ enum Timer_State {
 };
 
 struct Timer {
-  f64 passed_time, target_time;
+  u32 start_tick, end_tick;
   Timer_State state;
 };
 
+// The clock every timer runs on, moved forward once per simulation tick.
+struct Timer_Clock {
+  u32 tick;
+  f32 tick_duration;
+};
+
+global_var Timer_Clock global_timer_clock;
+
+void timer_clock_init(f32 tick_duration, u32 tick) {
+  global_timer_clock.tick_duration = tick_duration;
+  global_timer_clock.tick = tick;
+}
+
+void timer_clock_set_tick(u32 tick) { global_timer_clock.tick = tick; }
+u32  timer_clock_tick(void)         { return global_timer_clock.tick; }
+
+// Whole ticks, rounded up so a timer never runs shorter than asked for.
+u32 ticks_from_seconds(f64 seconds, f32 tick_duration) {
+  Assert(tick_duration > 0.0f);
+  if(seconds <= 0.0) return 0;
+
+  u32 r = (u32)ceil(seconds/(f64)tick_duration - 0.001);
+  return r;
+}
+
+u32 timer_ticks_from_seconds(f64 seconds) {
+  u32 r = ticks_from_seconds(seconds, global_timer_clock.tick_duration);
+  return r;
+}
+
 Timer timer_start(f64 target) {
   Timer r = {};
-  r.passed_time = 0.0f;
-  r.target_time = target;
+  r.start_tick = global_timer_clock.tick;
+  r.end_tick   = r.start_tick + timer_ticks_from_seconds(target);
   r.state = Timer_State_Active;
   return r;
 }
 
+// Starts over with the same duration.
 void timer_reset(Timer* timer) {
-  timer->passed_time = 0.0f;
+  u32 duration = timer->end_tick - timer->start_tick;
+  timer->start_tick = global_timer_clock.tick;
+  timer->end_tick   = timer->start_tick + duration;
   timer->state = Timer_State_Active;
 }
 
+b32 timer_has_reached_end(Timer timer) {
+  b32 r = (s32)(global_timer_clock.tick - timer.end_tick) >= 0;
+  return r;
+}
+
+// Returns true once, on the first call at or after the end tick. Time comes from the
+// clock, 'seconds' is only there so the old call sites keep compiling.
 b32 timer_step(Timer* timer, f64 seconds) {
   b32 ended_this_frame = false;
-  
-  timer->passed_time += seconds;
-  if(timer->passed_time >= timer->target_time) {
-    timer->passed_time = timer->target_time;
+
+  if(timer->state == Timer_State_Active && timer_has_reached_end(*timer)) {
     ended_this_frame = true;
     timer->state = Timer_State_Ended;
   }
@@ -42,16 +83,19 @@ b32 timer_step(Timer* timer, f64 seconds) {
 }
 
 b32 timer_step(Timer* timer, f64 seconds, f64 target) {
-  timer->target_time = target;
+  timer->end_tick = timer->start_tick + timer_ticks_from_seconds(target);
   return timer_step(timer, seconds);
 }
 
 f32 timer_procent(Timer timer) {
-  f32 r = timer.passed_time/timer.target_time;
+  u32 duration = timer.end_tick - timer.start_tick;
+  if(duration == 0) return 1.0f;
+
+  s32 passed = (s32)(global_timer_clock.tick - timer.start_tick);
+  f32 r = Clamp((f32)passed/(f32)duration, 0.0f, 1.0f);
   return r;
 }
 
 b32 timer_is_inactive(Timer t) { return(t.state == Timer_State_Inactive); }
-b32 timer_is_active(Timer t)   { return(t.state == Timer_State_Active); }
-b32 timer_ended(Timer t)       { return(t.state == Timer_State_Ended); }
-
+b32 timer_is_active(Timer t)   { return(t.state == Timer_State_Active && !timer_has_reached_end(t)); }
+b32 timer_ended(Timer t)       { return(t.state != Timer_State_Inactive && timer_has_reached_end(t)); }
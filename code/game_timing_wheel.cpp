@@ -0,0 +1,200 @@
+//
+// Timing wheel
+//
+// Hierarchical timing wheel over integer ticks. Adding and cancelling a timer is O(1) and
+// advancing by one tick only touches the timers that expire on it, plus an occasional
+// cascade of one slot down from a coarser level.
+//
+// Level 0 has one slot per tick for the next 64 ticks, level 1 one slot per 64 ticks and
+// so on. Timers are nodes in a fixed pool, linked into their slot by index.
+//
+
+#define TIMING_WHEEL_SLOT_BITS   6
+#define TIMING_WHEEL_SLOT_COUNT  (1 << TIMING_WHEEL_SLOT_BITS)
+#define TIMING_WHEEL_SLOT_MASK   (TIMING_WHEEL_SLOT_COUNT - 1)
+#define TIMING_WHEEL_LEVEL_COUNT 4
+#define TIMING_WHEEL_MAX_DELAY   (1u << (TIMING_WHEEL_SLOT_BITS*TIMING_WHEEL_LEVEL_COUNT))
+
+#define TIMING_WHEEL_NIL -1
+
+// Where a node is linked.
+enum Wheel_List {
+  Wheel_List_Free    = -1,
+  Wheel_List_Expired = -2,
+  // >= 0 is level*TIMING_WHEEL_SLOT_COUNT + slot
+};
+
+struct Wheel_Node {
+  u32 expire_tick;
+  u32 payload;
+  s32 prev, next;
+  s32 list;
+  u32 generation;
+};
+
+// Stays valid after the timer fires or is cancelled, it just stops matching the node.
+struct Wheel_Handle {
+  s32 index;
+  u32 generation;
+};
+
+struct Timing_Wheel {
+  Wheel_Node* nodes;
+  s32 node_count;
+  s32 first_free;
+
+  s32 slots[TIMING_WHEEL_LEVEL_COUNT*TIMING_WHEEL_SLOT_COUNT];
+  s32 first_expired;
+
+  u32 now; // last tick that was advanced to
+};
+
+void timing_wheel_unlink(Timing_Wheel* wheel, s32 index) {
+  Wheel_Node* node = &wheel->nodes[index];
+
+  s32* head = NULL;
+  if(node->list == Wheel_List_Free)         head = &wheel->first_free;
+  else if(node->list == Wheel_List_Expired) head = &wheel->first_expired;
+  else                                      head = &wheel->slots[node->list];
+
+  if(node->prev != TIMING_WHEEL_NIL) wheel->nodes[node->prev].next = node->next;
+  else                               *head = node->next;
+  if(node->next != TIMING_WHEEL_NIL) wheel->nodes[node->next].prev = node->prev;
+
+  node->prev = node->next = TIMING_WHEEL_NIL;
+}
+
+void timing_wheel_link(Timing_Wheel* wheel, s32 index, s32 list) {
+  Wheel_Node* node = &wheel->nodes[index];
+
+  s32* head = NULL;
+  if(list == Wheel_List_Free)         head = &wheel->first_free;
+  else if(list == Wheel_List_Expired) head = &wheel->first_expired;
+  else                                head = &wheel->slots[list];
+
+  node->list = list;
+  node->prev = TIMING_WHEEL_NIL;
+  node->next = *head;
+  if(*head != TIMING_WHEEL_NIL) wheel->nodes[*head].prev = index;
+  *head = index;
+}
+
+// Picks the slot from how far away the expiry is, the finer the closer.
+void timing_wheel_insert(Timing_Wheel* wheel, s32 index) {
+  Wheel_Node* node = &wheel->nodes[index];
+
+  u32 delay = node->expire_tick - wheel->now;
+  Assert(delay > 0 && delay < TIMING_WHEEL_MAX_DELAY);
+
+  s32 level = 0;
+  while(delay >= (1u << (TIMING_WHEEL_SLOT_BITS*(level + 1)))) level += 1;
+
+  s32 slot = (node->expire_tick >> (TIMING_WHEEL_SLOT_BITS*level)) & TIMING_WHEEL_SLOT_MASK;
+  timing_wheel_link(wheel, index, level*TIMING_WHEEL_SLOT_COUNT + slot);
+}
+
+void timing_wheel_clear(Timing_Wheel* wheel, u32 now) {
+  wheel->now = now;
+  wheel->first_free    = TIMING_WHEEL_NIL;
+  wheel->first_expired = TIMING_WHEEL_NIL;
+  Loop(i, ArrayCount(wheel->slots)) wheel->slots[i] = TIMING_WHEEL_NIL;
+
+  for(s32 i = wheel->node_count - 1; i >= 0; i--) {
+    wheel->nodes[i].generation += 1;
+    timing_wheel_link(wheel, i, Wheel_List_Free);
+  }
+}
+
+void timing_wheel_init(Timing_Wheel* wheel, Wheel_Node* nodes, s32 node_count, u32 now) {
+  *wheel = {};
+  wheel->nodes = nodes;
+  wheel->node_count = node_count;
+  zero_memory((u8*)nodes, node_count*sizeof(Wheel_Node));
+
+  timing_wheel_clear(wheel, now);
+}
+
+// Expiries at or before the current tick fire on the next advance.
+Wheel_Handle timing_wheel_add(Timing_Wheel* wheel, u32 expire_tick, u32 payload) {
+  s32 index = wheel->first_free;
+  Assert(index != TIMING_WHEEL_NIL);
+
+  timing_wheel_unlink(wheel, index);
+
+  Wheel_Node* node = &wheel->nodes[index];
+  if((s32)(expire_tick - wheel->now) <= 0) expire_tick = wheel->now + 1;
+  node->expire_tick = expire_tick;
+  node->payload = payload;
+
+  timing_wheel_insert(wheel, index);
+
+  Wheel_Handle r = {index, node->generation};
+  return r;
+}
+
+b32 timing_wheel_is_pending(Timing_Wheel* wheel, Wheel_Handle handle) {
+  if(handle.index < 0 || handle.index >= wheel->node_count) return false;
+
+  Wheel_Node* node = &wheel->nodes[handle.index];
+  b32 r = node->generation == handle.generation && node->list != Wheel_List_Free;
+  return r;
+}
+
+// Cancelling a timer that already fired or was cancelled does nothing.
+void timing_wheel_cancel(Timing_Wheel* wheel, Wheel_Handle handle) {
+  if(!timing_wheel_is_pending(wheel, handle)) return;
+
+  timing_wheel_unlink(wheel, handle.index);
+  wheel->nodes[handle.index].generation += 1;
+  timing_wheel_link(wheel, handle.index, Wheel_List_Free);
+}
+
+// Re-inserts every node of one coarse slot, they all land on finer levels.
+void timing_wheel_cascade(Timing_Wheel* wheel, s32 level) {
+  s32 slot = (wheel->now >> (TIMING_WHEEL_SLOT_BITS*level)) & TIMING_WHEEL_SLOT_MASK;
+  s32* head = &wheel->slots[level*TIMING_WHEEL_SLOT_COUNT + slot];
+
+  s32 index = *head;
+  *head = TIMING_WHEEL_NIL;
+  while(index != TIMING_WHEEL_NIL) {
+    s32 next = wheel->nodes[index].next;
+
+    if(wheel->nodes[index].expire_tick == wheel->now) timing_wheel_link(wheel, index, Wheel_List_Expired);
+    else                                              timing_wheel_insert(wheel, index);
+    index = next;
+  }
+}
+
+// Moves one tick forward. Whatever expires on it can then be taken with timing_wheel_pop_expired.
+void timing_wheel_advance(Timing_Wheel* wheel) {
+  wheel->now += 1;
+
+  for(s32 level = 1; level < TIMING_WHEEL_LEVEL_COUNT; level++) {
+    u32 finer_bits = wheel->now & ((1u << (TIMING_WHEEL_SLOT_BITS*level)) - 1);
+    if(finer_bits != 0) break;
+    timing_wheel_cascade(wheel, level);
+  }
+
+  s32* head = &wheel->slots[wheel->now & TIMING_WHEEL_SLOT_MASK];
+  s32 index = *head;
+  *head = TIMING_WHEEL_NIL;
+  while(index != TIMING_WHEEL_NIL) {
+    s32 next = wheel->nodes[index].next;
+    Assert(wheel->nodes[index].expire_tick == wheel->now);
+    timing_wheel_link(wheel, index, Wheel_List_Expired);
+    index = next;
+  }
+}
+
+// Returns false once there are no more expired timers. The node goes back to the free list.
+b32 timing_wheel_pop_expired(Timing_Wheel* wheel, u32* payload) {
+  s32 index = wheel->first_expired;
+  if(index == TIMING_WHEEL_NIL) return false;
+
+  *payload = wheel->nodes[index].payload;
+
+  timing_wheel_unlink(wheel, index);
+  wheel->nodes[index].generation += 1;
+  timing_wheel_link(wheel, index, Wheel_List_Free);
+  return true;
+}
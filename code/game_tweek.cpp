@@ -17,17 +17,69 @@
 #define TARGET_FPS        60
 #define TARGET_DELTA_TIME (1.0f/(f32)TARGET_FPS)
 
+// The simulation steps at a fixed rate of its own, bullets use swept tests so a lower
+// rate (e.g. -DSIM_TICKS_PER_SECOND=30) doesn't make them skip over things.
+#ifndef SIM_TICKS_PER_SECOND
+#define SIM_TICKS_PER_SECOND TARGET_FPS
+#endif
+#define SIM_DELTA_TIME          (1.0f/(f32)SIM_TICKS_PER_SECOND)
+#define MAX_SIM_STEPS_PER_FRAME 4
+
 #define TITLE             "Arcade Jam"
 
 #define MAX_MASTER_VOLUME  12
 #define MASTER_VOLUME_STEP 1
 
 #define MAX_ENTITIES      256
-#define MAX_PROJECTILES   512
+#define MAX_PROJECTILES   512 // per faction pool
 #define MAX_CHAIN_CIRCLES 512
 #define MAX_SCORE_DOTS    512
 #define MAX_PARTICLES     512
 #define MAX_EXPLOSIONS    16
+#define MAX_LASER_BEAMS   64
+
+#define MAX_PLAYER_PROJECTILES   128
+#define MAX_CHAIN_PROJECTILES    512
+#define MAX_INFECTOR_PROJECTILES 256
+
+// Each particle, explosion, laser beam and projectile slot holds at most one pending timer.
+#define MAX_TIMER_WHEEL_NODES (MAX_PARTICLES + MAX_EXPLOSIONS + MAX_LASER_BEAMS + \
+                               MAX_PLAYER_PROJECTILES + MAX_CHAIN_PROJECTILES + MAX_INFECTOR_PROJECTILES)
+
+// Side effects queued in one tick, a beam burning through a chain circle alone can push
+// two per segment.
+#define MAX_SIM_EVENTS 4096
+
+// Worker threads for the parallel simulation passes, 0 is one per processor. Passes over
+// fewer live objects than the threshold stay on the main thread. Both can be set from the
+// build line, e.g. to try many workers on a small machine.
+#ifndef JOB_WORKER_COUNT
+#define JOB_WORKER_COUNT       0
+#endif
+#ifndef JOB_PARALLEL_THRESHOLD
+#define JOB_PARALLEL_THRESHOLD 128
+#endif
+#define PARALLEL_FOR_GRAIN     64
+
+// Collision pair search, see game_contacts.cpp. The biggest body set is all enemy bullets.
+// The most pairs come from player bullets feeding circles, the only pass that takes them all.
+#define MAX_CONTACT_BODIES      Max(MAX_CHAIN_PROJECTILES + MAX_INFECTOR_PROJECTILES, MAX_CHAIN_CIRCLES)
+#define MAX_CONTACT_PAIRS       (MAX_CHAIN_CIRCLES*MAX_PLAYER_PROJECTILES)
+#define CONTACT_STRIP_COUNT     16
+
+// Runs every SIMD kernel on its scalar version, so does GAME_FORCE_SCALAR=1 in the environment.
+#define FORCE_SCALAR_KERNELS 0
+
+// Replays keep the simulation state every this many ticks, a check finds the first
+// difference only to within that. See game_replay.cpp.
+#define REPLAY_STATE_INTERVAL 60
+
+// Game_State and the simulation pools, about 350KB of it is in use. The ring keeps a
+// snapshot of all of it every SIM_SNAPSHOT_INTERVAL ticks, the debug rewind (R with the
+// debug info up) reaches back that many of them.
+#define SIM_BLOCK_SIZE        KB(512)
+#define SIM_SNAPSHOT_INTERVAL 30
+#define SIM_SNAPSHOT_COUNT    8
 
 
 //
@@ -64,9 +116,12 @@ Vec4 WHITE_VEC4 = {1, 1, 1, 1};
 
 #define LASER_TURRET_HIT_POINTS 10
 
-#define LASER_TURRET_PROJECTILE_RADIUS     20.0f
-#define LASER_TURRET_PROJECTILE_LIFETIME   5.0f
-#define LASER_TURRET_PROJECTILE_FADE_AFTER 4.8f
+#define LASER_TURRET_AIM_LEFT_PER_SECOND 0.22f // of the angle to the player, while targeting
+
+#define LASER_BEAM_RADIUS        20.0f
+#define LASER_BEAM_LIFETIME      5.0f
+#define LASER_BEAM_FADE_AFTER    4.8f
+#define LASER_BEAM_SEGMENT_COUNT 65
 
 //
 // Triple gun turret
@@ -102,6 +157,7 @@ Vec4 WHITE_VEC4 = {1, 1, 1, 1};
 #define CHAIN_ACTIVATOR_END_RADIUS     20.0f
 #define CHAIN_ACTIVATOR_ORBITAL_RADIUS 8.0f
 #define CHAIN_ACTIVATOR_MOVE_SPEED     45.0f
+#define CHAIN_ACTIVATOR_FRICTION       0.16f // velocity left after a second, once it has been hit
 
 #define CHAIN_ACTIVATOR_START_COLOR YELLOW_VEC4
 #define CHAIN_ACTIVATOR_END_COLOR   WHITE_VEC4
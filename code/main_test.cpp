@@ -0,0 +1,56 @@
+//
+// Headless tests and benchmarks, built by build_test.bat. No window, audio or raylib, see
+// test_headless.cpp.
+//
+//   game_test          checks the trig against libm, every SIMD kernel against its scalar
+//                      version, the contact passes against a plain search, that a short
+//                      run of the simulation is the same on 1 and on all workers, that
+//                      going back to a snapshot and playing on again gives the same state
+//                      down to the bytes, that a snapshot save and restore is in budget,
+//                      and that a replay it records checks out with the scalar kernels
+//   game_test_30hz     the same checks with the simulation built at 30 ticks per second
+//   game_test_det      the same checks with GAME_DETERMINISTIC
+//   game_test bench    the same, then times the kernels (and libm's sinf and cosf), the
+//                      simulation on 1 to N workers and a snapshot save and restore
+//   game_test check p  the same checks, then the replay p another build recorded, the
+//                      cross build check
+//
+// Exits with 1 if a check failed.
+//
+
+#include <raylib.h>
+#include <string.h>
+
+#include "game.cpp"
+
+#include "test_headless.cpp"
+#include "test_kernels.cpp"
+#include "test_sim.cpp"
+
+int main(int argc, char** argv) {
+  b32 run_benchmarks = argc > 1 && strcmp(argv[1], "bench") == 0;
+  char* check_path = (argc > 2 && strcmp(argv[1], "check") == 0) ? argv[2] : NULL;
+
+  // the fixed point trig tables and the job system come up here
+  init_game();
+  
+  Simd_Level level = cpu_simd_level(false);
+  printf("simd: %s%s\n", simd_level_names[level], GAME_SSE2 ? "" : " (no sse2 kernels compiled in)");
+
+  if(level >= Simd_Level_SSE2 || !GAME_SSE2) test_kernels();
+  printf("kernels: %d checks, %d failed\n", test_check_count, test_failure_count);
+
+  if(run_benchmarks && level >= Simd_Level_SSE2) bench_kernels();
+
+  test_contacts();
+  test_bullet_step();
+  test_projectile_life_time();
+  bench_worker_scaling(run_benchmarks ? 10000 : 1000);
+  test_rollback(run_benchmarks ? 10000 : 3000);
+  test_snapshot_budget(run_benchmarks ? 1000 : 100);
+  test_replay();
+  if(check_path) test_check(test_check_replay(check_path), "replay of another build", 0);
+  printf("%d checks, %d failed\n", test_check_count, test_failure_count);
+
+  return test_failure_count ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+//
+// Headless platform
+//
+// The raylib calls the game makes, for main_test.cpp which runs without a window, audio or
+// raylib itself. Time is real, so the timings the game takes mean something. Every frame
+// is exactly one simulation tick and the keys held are whatever headless_keys_down says.
+//
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+
+// Declared here instead of including windows.h, which clashes with raylib.h.
+extern "C" {
+  __declspec(dllimport) int __stdcall QueryPerformanceCounter(s64* count);
+  __declspec(dllimport) int __stdcall QueryPerformanceFrequency(s64* frequency);
+}
+
+f64 headless_seconds(void) {
+  s64 count, frequency;
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  f64 r = (f64)count/(f64)frequency;
+  return r;
+}
+
+#else
+
+#include <time.h>
+
+f64 headless_seconds(void) {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  f64 r = (f64)now.tv_sec + (f64)now.tv_nsec*1e-9;
+  return r;
+}
+
+#endif
+
+global_var b32 headless_keys_down[512];
+global_var u32 headless_random_value = 1;
+
+extern "C" {
+
+void BeginDrawing(void) {}
+void EndDrawing(void) {}
+void ClearBackground(Color color) {}
+void DrawCircle(int x, int y, float radius, Color color) {}
+void DrawCircleLines(int x, int y, float radius, Color color) {}
+void DrawLineEx(Vector2 start, Vector2 end, float thick, Color color) {}
+void DrawRectangleLinesEx(Rectangle rec, float thick, Color color) {}
+void DrawRectanglePro(Rectangle rec, Vector2 origin, float rotation, Color color) {}
+void DrawTextEx(Font font, const char* text, Vector2 position, float font_size, float spacing, Color tint) {}
+void DrawTexturePro(Texture2D texture, Rectangle source, Rectangle dest, Vector2 origin, float rotation, Color tint) {}
+void DrawTriangle(Vector2 v1, Vector2 v2, Vector2 v3, Color color) {}
+void DrawTriangleLines(Vector2 v1, Vector2 v2, Vector2 v3, Color color) {}
+
+Vector2 MeasureTextEx(Font font, const char* text, float font_size, float spacing) { return {font_size, font_size}; }
+
+float  GetFrameTime(void) { return SIM_DELTA_TIME; }
+double GetTime(void)      { return headless_seconds(); }
+int    GetRandomValue(int min, int max) { return min + (int)(headless_random_value%(u32)(max - min + 1)); }
+
+bool  IsKeyDown(int key)    { return key >= 0 && key < (int)ArrayCount(headless_keys_down) && headless_keys_down[key]; }
+bool  IsKeyPressed(int key) { return false; }
+bool  IsGamepadAvailable(int gamepad) { return false; }
+bool  IsGamepadButtonDown(int gamepad, int button)    { return false; }
+bool  IsGamepadButtonPressed(int gamepad, int button) { return false; }
+float GetGamepadAxisMovement(int gamepad, int axis)   { return 0.0f; }
+
+bool      FileExists(const char* file_name) { return false; }
+Texture2D LoadTexture(const char* file_name) { Texture2D r = {}; return r; }
+Font      LoadFontEx(const char* file_name, int font_size, int* font_chars, int glyph_count) { Font r = {}; r.baseSize = font_size; return r; }
+Sound     LoadSound(const char* file_name) { Sound r = {}; return r; }
+Music     LoadMusicStream(const char* file_name) { Music r = {}; return r; }
+
+float GetMusicTimeLength(Music music) { return 60.0f; }
+void  PlayMusicStream(Music music) {}
+void  PauseMusicStream(Music music) {}
+void  ResumeMusicStream(Music music) {}
+void  StopMusicStream(Music music) {}
+void  UpdateMusicStream(Music music) {}
+void  PlaySound(Sound sound) {}
+void  SetSoundVolume(Sound sound, float volume) {}
+void  SetMasterVolume(float volume) {}
+
+void* MemAlloc(unsigned int size) { return calloc(size, 1); }
+void  MemFree(void* ptr) { free(ptr); }
+
+const char* TextFormat(const char* text, ...) {
+  static char buffer[1024];
+  va_list args;
+  va_start(args, text);
+  vsnprintf(buffer, sizeof(buffer), text, args);
+  va_end(args);
+  return buffer;
+}
+
+// Only warnings and errors, the info lines of init_game would be in the way.
+void TraceLog(int log_level, const char* text, ...) {
+  if(log_level < LOG_WARNING) return;
+
+  va_list args;
+  va_start(args, text);
+  vprintf(text, args);
+  va_end(args);
+  printf("\n");
+}
+
+}
@@ -0,0 +1,696 @@
+//
+// Kernel tests
+//
+// Every SIMD kernel gets the same inputs as its scalar version, random ones and the edge
+// cases, and has to give the same bits. The benchmarks time them on the same inputs. The
+// AVX2 ones only run where the cpu has it.
+//
+
+global_var s32 test_check_count;
+global_var s32 test_failure_count;
+
+// The run carries on after a failure, so one run shows all of them.
+void test_check(b32 ok, char* name, s32 index) {
+  test_check_count += 1;
+  if(ok) return;
+
+  test_failure_count += 1;
+  if(test_failure_count <= 32) printf("FAIL %s [%d]\n", name, index);
+}
+
+b32 test_same_bits(f32 a, f32 b) {
+  b32 r = memcmp(&a, &b, sizeof(f32)) == 0;
+  return r;
+}
+
+// Seconds per call, the best of a few runs of 'calls' calls.
+#define TEST_BENCH_RUNS 5
+#define TestBench(seconds_out, calls, call) {                   \
+    f64 best_ = 1e9;                                            \
+    Loop(run_, TEST_BENCH_RUNS) {                               \
+      f64 start_ = GetTime();                                   \
+      Loop(call_, (calls)) { call; }                            \
+      best_ = Min(best_, (GetTime() - start_)/(f64)(calls));    \
+    }                                                           \
+    seconds_out = best_;                                        \
+  }
+
+b32 test_has_avx2(void) {
+  b32 r = GAME_AVX2 && cpu_simd_level(false) >= Simd_Level_AVX2;
+  return r;
+}
+
+void test_print_bench(char* name, s32 count, f64 scalar_seconds, f64 simd_seconds, f64 avx2_seconds = 0.0) {
+  printf("  %-24s %5d: scalar %9.1f ns, sse2 %9.1f ns, %5.2fx",
+         name, count, scalar_seconds*1e9, simd_seconds*1e9, scalar_seconds/simd_seconds);
+  if(avx2_seconds > 0.0) printf(", avx2 %9.1f ns, %5.2fx", avx2_seconds*1e9, scalar_seconds/avx2_seconds);
+  printf("\n");
+}
+
+Vec2 test_random_vec2(Random_Series* series, f32 min, f32 max) {
+  Vec2 r = {min + random_f32(series)*(max - min), min + random_f32(series)*(max - min)};
+  return r;
+}
+
+//
+// Trig
+//
+// sincos_f32 against libm in double, within what the comment in game_math.cpp promises,
+// and sincos_n_sse2 and sincos_n_avx2 the same bits as sincos_n_scalar.
+//
+
+#if GAME_DETERMINISTIC
+#define TEST_TRIG_HIGH_ERROR 5e-5 // the fixed point tables
+#else
+#define TEST_TRIG_HIGH_ERROR 1e-6
+#endif
+#define TEST_TRIG_LOW_ERROR  4e-4
+#define TEST_ANGLE_COUNT     4099
+
+// Angles all over |angle| < 1e4, with the quadrant edges and zeros in between.
+void test_fill_angles(Random_Series* series, f32* angles, s32 count) {
+  Loop(i, count) {
+    switch(i%4) {
+      case 0: { angles[i] = (random_f32(series)*2.0f - 1.0f)*1e4f; } break;
+      case 1: { angles[i] = (random_f32(series)*2.0f - 1.0f)*8.0f; } break;
+      case 2: { angles[i] = (f32)random_range(series, -64, 64)*(Pi32/4); } break;
+      case 3: { angles[i] = (i%8 == 3) ? 0.0f : -0.0f; } break;
+    }
+  }
+}
+
+void test_trig_accuracy(Trig_Accuracy accuracy, f32* angles, s32 count, char* name, f64 max_error) {
+  f64 worst = 0.0;
+  s32 worst_index = 0;
+  Loop(i, count) {
+    f32 s, c;
+    sincos_f32(angles[i], &s, &c, accuracy);
+    f64 error = Max(fabs((f64)s - sin((f64)angles[i])), fabs((f64)c - cos((f64)angles[i])));
+    if(error > worst) { worst = error; worst_index = (s32)i; }
+  }
+  printf("  %-24s max error %.2e at %g, allowed %.0e\n", name, worst, angles[worst_index], max_error);
+  test_check(worst <= max_error, name, worst_index);
+}
+
+void test_trig_kernels(void) {
+  Random_Series series;
+  random_begin(&series, 44);
+
+  f32 angles[TEST_ANGLE_COUNT];
+  test_fill_angles(&series, angles, TEST_ANGLE_COUNT);
+
+  printf("trig against libm:\n");
+  test_trig_accuracy(Trig_Accuracy_High, angles, TEST_ANGLE_COUNT, "sincos_f32 high", TEST_TRIG_HIGH_ERROR);
+  test_trig_accuracy(Trig_Accuracy_Low,  angles, TEST_ANGLE_COUNT, "sincos_f32 low",  TEST_TRIG_LOW_ERROR);
+
+#if GAME_SSE2
+  f32 scalar_sin[TEST_ANGLE_COUNT], scalar_cos[TEST_ANGLE_COUNT];
+  f32 simd_sin[TEST_ANGLE_COUNT],   simd_cos[TEST_ANGLE_COUNT];
+
+  Trig_Accuracy accuracies[] = {Trig_Accuracy_High, Trig_Accuracy_Low};
+  char* names[] = {"sincos_n high", "sincos_n low"};
+  Loop(a, ArrayCount(accuracies)) {
+    Trig_Accuracy accuracy = accuracies[a];
+#if GAME_DETERMINISTIC
+    if(accuracy == Trig_Accuracy_High) continue; // sincos_n keeps those on the fixed point scalar path
+#endif
+
+    // every count up to a few blocks of four, then all of them
+    Loop(round, 20) {
+      s32 count = (round < 19) ? round : TEST_ANGLE_COUNT;
+      sincos_n_scalar(scalar_sin, scalar_cos, angles, count, accuracy);
+      sincos_n_sse2(simd_sin, simd_cos, angles, count, accuracy);
+
+      Loop(i, count) {
+        b32 same = test_same_bits(scalar_sin[i], simd_sin[i]) && test_same_bits(scalar_cos[i], simd_cos[i]);
+        test_check(same, names[a], (s32)i);
+      }
+      
+#if GAME_AVX2
+      if(!test_has_avx2()) continue;
+      sincos_n_avx2(simd_sin, simd_cos, angles, count, accuracy);
+      Loop(i, count) {
+        b32 same = test_same_bits(scalar_sin[i], simd_sin[i]) && test_same_bits(scalar_cos[i], simd_cos[i]);
+        test_check(same, names[a], (s32)i);
+      }
+#endif
+    }
+  }
+#endif
+}
+
+void bench_trig_kernels(void) {
+  Random_Series series;
+  random_begin(&series, 44);
+
+  f32 angles[512], sins[512], coss[512];
+  Loop(i, ArrayCount(angles)) angles[i] = (random_f32(&series)*2.0f - 1.0f)*2.0f*Pi32;
+
+  f64 libm_seconds;
+  TestBench(libm_seconds, 2000, Loop(i, 512) { sins[i] = sinf(angles[i]); coss[i] = cosf(angles[i]); });
+  printf("  %-24s %5d: %9.1f ns\n", "libm sinf and cosf", 512, libm_seconds*1e9);
+
+#if GAME_SSE2
+  Trig_Accuracy accuracies[] = {Trig_Accuracy_High, Trig_Accuracy_Low};
+  char* names[] = {"sincos_n high", "sincos_n low"};
+  Loop(a, ArrayCount(accuracies)) {
+    f64 scalar_seconds, simd_seconds, avx2_seconds = 0.0;
+    TestBench(scalar_seconds, 2000, sincos_n_scalar(sins, coss, angles, 512, accuracies[a]));
+    TestBench(simd_seconds,   2000, sincos_n_sse2(sins, coss, angles, 512, accuracies[a]));
+#if GAME_AVX2
+    if(test_has_avx2()) TestBench(avx2_seconds, 2000, sincos_n_avx2(sins, coss, angles, 512, accuracies[a]));
+#endif
+    test_print_bench(names[a], 512, scalar_seconds, simd_seconds, avx2_seconds);
+  }
+#endif
+}
+
+//
+// Vec2 batches
+//
+
+#define TEST_POINT_COUNT 67 // odd, so the one point tail runs too
+
+b32 test_same_points(Vec2* a, Vec2* b, s32 count) {
+  b32 r = true;
+  Loop(i, count) r = r && test_same_bits(a[i].x, b[i].x) && test_same_bits(a[i].y, b[i].y);
+  return r;
+}
+
+void test_vec2_kernels(void) {
+#if GAME_SSE2
+  Random_Series series;
+  random_begin(&series, 43);
+
+  Vec2 a[TEST_POINT_COUNT], b[TEST_POINT_COUNT];
+  Vec2 scalar_out[TEST_POINT_COUNT], simd_out[TEST_POINT_COUNT];
+  f32 scalar_lengths[TEST_POINT_COUNT], simd_lengths[TEST_POINT_COUNT];
+
+  f32 angles[] = {0.0f, Pi32/2, Pi32, -Pi32, 2*Pi32, 1000.0f};
+  f32 scales[] = {1.0f, 0.0f, -2.5f, 1000.0f};
+  f32 ts[]     = {0.0f, 1.0f, 0.5f, -0.25f, 1.75f};
+
+  Loop(round, 400) {
+    s32 count = (round < TEST_POINT_COUNT) ? round : TEST_POINT_COUNT;
+    Loop(i, count) {
+      a[i] = test_random_vec2(&series, -2000.0f, 2000.0f);
+      b[i] = test_random_vec2(&series, -2000.0f, 2000.0f);
+      if(i%5 == 0) a[i] = vec2(0, 0);
+      if(i%7 == 0) a[i] = vec2(1e-30f, -1e-30f); // the length squared is 0, but not the vector
+      if(i%11 == 0) a[i] = vec2(3e19f, 3e19f);   // the length squared is infinite
+    }
+
+    f32 angle = (round%3 == 0) ? angles[round/3%ArrayCount(angles)] : random_f32(&series)*20.0f - 10.0f;
+    f32 scale = (round%4 == 0) ? scales[round/4%ArrayCount(scales)] : random_f32(&series)*3.0f;
+    f32 t     = (round%2 == 0) ? ts[round/2%ArrayCount(ts)]         : random_f32(&series);
+    Vec2 offset = test_random_vec2(&series, -500.0f, 500.0f);
+
+    vec2_transform_points_scalar(scalar_out, a, count, angle, scale, offset);
+    vec2_transform_points_sse2(simd_out, a, count, angle, scale, offset);
+    test_check(test_same_points(scalar_out, simd_out, count), "vec2_transform_points", round);
+
+    // in place, the way polygons are transformed
+    Loop(i, count) simd_out[i] = a[i];
+    vec2_transform_points_sse2(simd_out, simd_out, count, angle, scale, offset);
+    test_check(test_same_points(scalar_out, simd_out, count), "vec2_transform_points in place", round);
+
+    vec2_lerp_n_scalar(scalar_out, a, b, count, t);
+    vec2_lerp_n_sse2(simd_out, a, b, count, t);
+    test_check(test_same_points(scalar_out, simd_out, count), "vec2_lerp_n", round);
+    
+    vec2_normalize_n_scalar(scalar_out, a, count);
+    vec2_normalize_n_sse2(simd_out, a, count);
+    test_check(test_same_points(scalar_out, simd_out, count), "vec2_normalize_n", round);
+    
+    vec2_length_sq_n_scalar(scalar_lengths, a, count);
+    vec2_length_sq_n_sse2(simd_lengths, a, count);
+    b32 same = true;
+    Loop(i, count) same = same && test_same_bits(scalar_lengths[i], simd_lengths[i]);
+    test_check(same, "vec2_length_sq_n", round);
+  }
+#endif
+}
+
+void bench_vec2_kernels(void) {
+#if GAME_SSE2
+  Random_Series series;
+  random_begin(&series, 43);
+
+  Vec2 a[512], b[512], out[512];
+  f32 lengths[512];
+  Loop(i, ArrayCount(a)) {
+    a[i] = test_random_vec2(&series, -100.0f, 100.0f);
+    b[i] = test_random_vec2(&series, -100.0f, 100.0f);
+  }
+
+  // an explosion polygon's worth of points, and a lot of them
+  s32 counts[] = {16, 512};
+  Loop(c, ArrayCount(counts)) {
+    s32 count = counts[c];
+    f64 scalar_seconds, simd_seconds;
+
+    TestBench(scalar_seconds, 10000, vec2_transform_points_scalar(out, a, count, 0.3f, 2.0f, vec2(640, 360)));
+    TestBench(simd_seconds,   10000, vec2_transform_points_sse2(out, a, count, 0.3f, 2.0f, vec2(640, 360)));
+    test_print_bench("vec2_transform_points", count, scalar_seconds, simd_seconds);
+
+    TestBench(scalar_seconds, 10000, vec2_lerp_n_scalar(out, a, b, count, 0.3f));
+    TestBench(simd_seconds,   10000, vec2_lerp_n_sse2(out, a, b, count, 0.3f));
+    test_print_bench("vec2_lerp_n", count, scalar_seconds, simd_seconds);
+    
+    TestBench(scalar_seconds, 10000, vec2_normalize_n_scalar(out, a, count));
+    TestBench(simd_seconds,   10000, vec2_normalize_n_sse2(out, a, count));
+    test_print_bench("vec2_normalize_n", count, scalar_seconds, simd_seconds);
+    
+    TestBench(scalar_seconds, 10000, vec2_length_sq_n_scalar(lengths, a, count));
+    TestBench(simd_seconds,   10000, vec2_length_sq_n_sse2(lengths, a, count));
+    test_print_bench("vec2_length_sq_n", count, scalar_seconds, simd_seconds);
+  }
+#endif
+}
+
+//
+// Collision
+//
+
+#define TEST_CIRCLE_COUNT 203 // not a multiple of 4 or 64, so the tails run too
+
+// Circles spread around the capsule, every third one placed right on its edge, where the
+// compare comes down to the last bit of the distance.
+void test_fill_circles(Random_Series* series, Vec2 a, Vec2 b, f32 capsule_radius, f32* xs, f32* ys, f32* radii, s32 count) {
+  Vec2 ab = b - a;
+  Vec2 normal = vec2_length_sq(ab) > 0.0f ? vec2_normalize(vec2_perp(ab)) : vec2(1.0f, 0.0f);
+
+  Loop(i, count) {
+    f32 radius = 1.0f + random_f32(series)*30.0f;
+    Vec2 center = {};
+
+    switch(i%3) {
+      case 0: { center = a + test_random_vec2(series, -100.0f, 100.0f); } break;
+      case 1: { center = a + ab*random_f32(series); } break;
+      case 2: {
+        f32 side = random_b32(series) ? 1.0f : -1.0f;
+        center = a + ab*random_f32(series) + normal*((capsule_radius + radius)*side);
+      } break;
+    }
+
+    xs[i] = center.x;
+    ys[i] = center.y;
+    radii[i] = radius;
+  }
+}
+
+// The primitives against cases worked out by hand, and the time of impact against where
+// the moving circle really touches.
+void test_collision_primitives(void) {
+  f32 t = -1.0f;
+  
+  // moving right into a circle 10 ahead, first contact after 6 of the 20
+  test_check(swept_circle_vs_circle({0, 0}, {20, 0}, 2.0f, {10, 0}, 2.0f, &t) && t == 0.3f, "swept_circle_vs_circle, head on", 0);
+  test_check(swept_circle_vs_circle({0, 0}, {20, 0}, 2.0f, {1, 0}, 2.0f, &t) && t == 0.0f,  "swept_circle_vs_circle, overlapping at the start", 0);
+  test_check(!swept_circle_vs_circle({0, 0}, {-20, 0}, 2.0f, {10, 0}, 2.0f, &t),            "swept_circle_vs_circle, moving away", 0);
+  test_check(!swept_circle_vs_circle({0, 0}, {5, 0}, 2.0f, {10, 0}, 2.0f, &t),              "swept_circle_vs_circle, stops short", 0);
+  test_check(!swept_circle_vs_circle({0, 0}, {0, 0}, 2.0f, {10, 0}, 2.0f, &t),              "swept_circle_vs_circle, not moving", 0);
+  test_check(swept_circle_vs_circle({0, 0}, {20, 0}, 2.0f, {10, 4}, 2.0f, &t) && t == 0.5f, "swept_circle_vs_circle, grazing", 0);
+  test_check(!swept_circle_vs_circle({0, 0}, {20, 0}, 2.0f, {10, 4.01f}, 2.0f, &t),         "swept_circle_vs_circle, just missing", 0);
+  
+  // tunnelling: a bullet step as long as at 30 Hz, past a circle thinner than the step
+  test_check(swept_circle_vs_circle({0, 0}, {650.0f/30.0f, 0}, 6.0f, {11, 1}, 2.0f, &t), "swept_circle_vs_circle, passing through in one step", 0);
+  test_check(capsule_vs_circle({0, 0}, {650.0f/30.0f, 0}, 6.0f, {11, 1}, 2.0f),          "capsule_vs_circle, passing through in one step", 0);
+  
+  test_check(segment_vs_circle({-10, 3}, {10, 3}, {0, 0}, 3.0f),                "segment_vs_circle, touching", 0);
+  test_check(!segment_vs_circle({-10, 3.01f}, {10, 3.01f}, {0, 0}, 3.0f),       "segment_vs_circle, missing", 0);
+  test_check(segment_vs_circle({-1, 0}, {1, 0}, {0, 0}, 3.0f),                  "segment_vs_circle, inside", 0);
+  
+  test_check(ray_vs_circle({0, 0}, {1, 0}, {10, 0}, 2.0f, &t) && t == 8.0f,     "ray_vs_circle, ahead", 0);
+  test_check(ray_vs_circle({10, 1}, {1, 0}, {10, 0}, 2.0f, &t) && t == 0.0f,    "ray_vs_circle, inside", 0);
+  test_check(!ray_vs_circle({0, 0}, {-1, 0}, {10, 0}, 2.0f, &t),                "ray_vs_circle, behind", 0);
+  test_check(ray_vs_circle({0, 2}, {1, 0}, {10, 0}, 2.0f, &t) && t == 10.0f,    "ray_vs_circle, tangent", 0);
+  
+  // At the time of impact the circles touch, and the capsule of the move agrees on a hit.
+  Random_Series series;
+  random_begin(&series, 30);
+  Loop(round, 4000) {
+    Vec2 p0 = test_random_vec2(&series, -100.0f, 100.0f);
+    Vec2 p1 = p0 + test_random_vec2(&series, -60.0f, 60.0f);
+    Vec2 center = test_random_vec2(&series, -100.0f, 100.0f);
+    f32 r0 = 1.0f + random_f32(&series)*10.0f;
+    f32 r1 = 1.0f + random_f32(&series)*30.0f;
+    
+    f32 toi = -1.0f;
+    b32 hit = swept_circle_vs_circle(p0, p1, r0, center, r1, &toi);
+    if(!hit) continue;
+    
+    f32 distance = vec2_length(p0 + (p1 - p0)*toi - center);
+    b32 ok = toi >= 0.0f && toi <= 1.0f && capsule_vs_circle(p0, p1, r0, center, r1);
+    if(toi > 0.0f) ok = ok && Abs(distance - (r0 + r1)) <= 1e-3f*(r0 + r1);
+    else           ok = ok && distance <= (r0 + r1)*1.0001f;
+    test_check(ok, "swept_circle_vs_circle, touching at the time of impact", round);
+  }
+}
+
+void test_collision_kernels(void) {
+  test_collision_primitives();
+  
+#if GAME_SSE2
+  Random_Series series;
+  random_begin(&series, 29);
+
+  f32 xs[TEST_CIRCLE_COUNT], ys[TEST_CIRCLE_COUNT], radii[TEST_CIRCLE_COUNT];
+  u64 scalar_mask[BIT_SET_WORD_COUNT(TEST_CIRCLE_COUNT)];
+  u64 simd_mask[BIT_SET_WORD_COUNT(TEST_CIRCLE_COUNT)];
+  f32 scalar_tois[TEST_CIRCLE_COUNT], simd_tois[TEST_CIRCLE_COUNT];
+
+  Loop(round, 2000) {
+    Vec2 a = test_random_vec2(&series, 0.0f, 1280.0f);
+    Vec2 b = a + test_random_vec2(&series, -300.0f, 300.0f);
+    if(round%16 == 0) b = a; // a capsule that is only a circle
+    f32 capsule_radius = (round%8 == 0) ? 0.0f : random_f32(&series)*20.0f;
+
+    // counts from 0 up, and the full set most of the time
+    s32 count = (round < 70) ? round : TEST_CIRCLE_COUNT;
+
+    test_fill_circles(&series, a, b, capsule_radius, xs, ys, radii, count);
+    capsule_vs_circles_scalar(a, b, capsule_radius, xs, ys, radii, count, scalar_mask);
+    capsule_vs_circles_sse2(a, b, capsule_radius, xs, ys, radii, count, simd_mask);
+
+    Loop(w, BIT_SET_WORD_COUNT(count)) {
+      test_check(scalar_mask[w] == simd_mask[w], "capsule_vs_circles", round);
+    }
+    
+    // the same segment as a circle moving from a to b
+    swept_circle_vs_circles_scalar(a, b, capsule_radius, xs, ys, radii, count, scalar_mask, scalar_tois);
+    swept_circle_vs_circles_sse2(a, b, capsule_radius, xs, ys, radii, count, simd_mask, simd_tois);
+    
+    Loop(w, BIT_SET_WORD_COUNT(count)) {
+      test_check(scalar_mask[w] == simd_mask[w], "swept_circle_vs_circles", round);
+    }
+    b32 same_tois = true;
+    Loop(i, count) same_tois = same_tois && test_same_bits(scalar_tois[i], simd_tois[i]);
+    test_check(same_tois, "swept_circle_vs_circles, tois", round);
+    
+#if GAME_AVX2
+    if(!test_has_avx2()) continue;
+    capsule_vs_circles_scalar(a, b, capsule_radius, xs, ys, radii, count, scalar_mask);
+    capsule_vs_circles_avx2(a, b, capsule_radius, xs, ys, radii, count, simd_mask);
+    Loop(w, BIT_SET_WORD_COUNT(count)) {
+      test_check(scalar_mask[w] == simd_mask[w], "capsule_vs_circles avx2", round);
+    }
+    
+    swept_circle_vs_circles_scalar(a, b, capsule_radius, xs, ys, radii, count, scalar_mask, scalar_tois);
+    swept_circle_vs_circles_avx2(a, b, capsule_radius, xs, ys, radii, count, simd_mask, simd_tois);
+    Loop(w, BIT_SET_WORD_COUNT(count)) {
+      test_check(scalar_mask[w] == simd_mask[w], "swept_circle_vs_circles avx2", round);
+    }
+    same_tois = true;
+    Loop(i, count) same_tois = same_tois && test_same_bits(scalar_tois[i], simd_tois[i]);
+    test_check(same_tois, "swept_circle_vs_circles avx2, tois", round);
+#endif
+  }
+#endif
+}
+
+void bench_collision_kernels(void) {
+#if GAME_SSE2
+  Random_Series series;
+  random_begin(&series, 29);
+
+  f32 xs[MAX_CHAIN_CIRCLES], ys[MAX_CHAIN_CIRCLES], radii[MAX_CHAIN_CIRCLES];
+  u64 mask[BIT_SET_WORD_COUNT(MAX_CHAIN_CIRCLES)];
+
+  Vec2 a = {200, 300};
+  Vec2 b = {900, 420};
+  test_fill_circles(&series, a, b, 8.0f, xs, ys, radii, MAX_CHAIN_CIRCLES);
+
+  f64 scalar_seconds, simd_seconds, avx2_seconds = 0.0;
+  TestBench(scalar_seconds, 10000, capsule_vs_circles_scalar(a, b, 8.0f, xs, ys, radii, MAX_CHAIN_CIRCLES, mask));
+  TestBench(simd_seconds,   10000, capsule_vs_circles_sse2(a, b, 8.0f, xs, ys, radii, MAX_CHAIN_CIRCLES, mask));
+#if GAME_AVX2
+  if(test_has_avx2()) TestBench(avx2_seconds, 10000, capsule_vs_circles_avx2(a, b, 8.0f, xs, ys, radii, MAX_CHAIN_CIRCLES, mask));
+#endif
+  test_print_bench("capsule_vs_circles", MAX_CHAIN_CIRCLES, scalar_seconds, simd_seconds, avx2_seconds);
+  
+  f32 tois[MAX_CHAIN_CIRCLES];
+  TestBench(scalar_seconds, 10000, swept_circle_vs_circles_scalar(a, b, 8.0f, xs, ys, radii, MAX_CHAIN_CIRCLES, mask, tois));
+  TestBench(simd_seconds,   10000, swept_circle_vs_circles_sse2(a, b, 8.0f, xs, ys, radii, MAX_CHAIN_CIRCLES, mask, tois));
+#if GAME_AVX2
+  if(test_has_avx2()) TestBench(avx2_seconds, 10000, swept_circle_vs_circles_avx2(a, b, 8.0f, xs, ys, radii, MAX_CHAIN_CIRCLES, mask, tois));
+#endif
+  test_print_bench("swept_circle_vs_circles", MAX_CHAIN_CIRCLES, scalar_seconds, simd_seconds, avx2_seconds);
+#endif
+}
+
+//
+// Kinematics
+//
+// kinematics_step_sse2 and _avx2 against kinematics_step_scalar, every array and the
+// offscreen bits.
+// Some objects stand still right on the screen edge, where in or out is one compare.
+//
+
+#define TEST_KINEMATICS_COUNT 192
+
+struct Test_Kinematics {
+  Kinematics_Real arrays[8][TEST_KINEMATICS_COUNT];
+  Kinematics k;
+};
+
+void test_kinematics_init(Test_Kinematics* t) {
+  Kinematics* k = &t->k;
+  *k = {};
+  k->capacity = TEST_KINEMATICS_COUNT;
+  k->x  = t->arrays[0];  k->y  = t->arrays[1];
+  k->vx = t->arrays[2];  k->vy = t->arrays[3];
+  k->dx = t->arrays[4];  k->dy = t->arrays[5];
+  k->friction = t->arrays[6];
+  k->radius   = t->arrays[7];
+}
+
+void test_fill_kinematics(Random_Series* series, Kinematics* k, Vec2 view_dim) {
+  f32 frictions[] = {1.0f, 0.0f, 0.97f, friction_per_tick(CHAIN_ACTIVATOR_FRICTION)};
+
+  Loop(i, k->capacity) {
+    Vec2 pos = test_random_vec2(series, -100.0f, view_dim.x + 100.0f);
+    Vec2 vel = test_random_vec2(series, -3000.0f, 3000.0f);
+    f32 friction = (i%3 == 0) ? frictions[random_range(series, 0, ArrayCount(frictions))] : random_f32(series);
+    f32 radius = (i%7 == 0) ? 0.0f : random_f32(series)*40.0f;
+
+    // standing on an edge, or just past it
+    if(i%5 == 0) {
+      vel = vec2(0, 0);
+      f32 past = random_b32(series) ? 0.0f : 0.5f;
+      switch(random_range(series, 0, 4)) {
+        case 0: { pos.x = -radius - past;             } break;
+        case 1: { pos.x = view_dim.x + radius + past; } break;
+        case 2: { pos.y = -radius - past;             } break;
+        case 3: { pos.y = view_dim.y + radius + past; } break;
+      }
+    }
+    kinematics_place(k, i, pos, vel, friction, radius);
+  }
+}
+
+// A per second friction turned into per tick has to come back to it after a second of
+// ticks, at any tick rate.
+void test_friction_per_tick(void) {
+  s32 rates[] = {30, 60, 120, 144, SIM_TICKS_PER_SECOND};
+  f32 per_seconds[] = {1.0f, 0.5f, 0.22f, CHAIN_ACTIVATOR_FRICTION, 0.046f, 1e-4f};
+
+  Loop(r, ArrayCount(rates)) {
+    Loop(i, ArrayCount(per_seconds)) {
+      f32 per_tick = root_f32_s32(per_seconds[i], rates[r]);
+      f32 back = pow_f32_s32(per_tick, rates[r]);
+      b32 ok = per_tick > 0.0f && per_tick <= 1.0f && Abs(back - per_seconds[i]) <= 1e-3f*per_seconds[i] + 1e-6f;
+      ok = ok && Abs(per_tick - powf(per_seconds[i], 1.0f/(f32)rates[r])) <= 1e-5f;
+      test_check(ok, "root_f32_s32, friction per second to per tick", r*ArrayCount(per_seconds) + i);
+    }
+  }
+}
+
+void test_kinematics_kernels(void) {
+#if GAME_SSE2 && !GAME_DETERMINISTIC
+  Random_Series series;
+  random_begin(&series, 42);
+
+  static Test_Kinematics scalar, simd, avx2;
+  test_kinematics_init(&scalar);
+  test_kinematics_init(&simd);
+  b32 has_avx2 = test_has_avx2();
+
+  u64 scalar_mask[BIT_SET_WORD_COUNT(TEST_KINEMATICS_COUNT)];
+  u64 simd_mask[BIT_SET_WORD_COUNT(TEST_KINEMATICS_COUNT)];
+  Vec2 view_dim = {WINDOW_WIDTH, WINDOW_HEIGHT};
+
+  Loop(round, 200) {
+    test_fill_kinematics(&series, &scalar.k, view_dim);
+    simd = scalar;
+    test_kinematics_init(&simd);
+    avx2 = scalar;
+    test_kinematics_init(&avx2);
+    u64 avx2_mask[ArrayCount(scalar_mask)];
+
+    // all of them, or only the last blocks of 64, the bits before those have to stay
+    s32 first = (round%2 == 0) ? 0 : 64;
+    Loop(w, ArrayCount(scalar_mask)) scalar_mask[w] = simd_mask[w] = avx2_mask[w] = (round%3 == 0) ? ~0ULL : (u64)random_u32(&series) << 16;
+
+    Loop(step, 3) {
+      u64* scalar_out = (round%4 == 3) ? 0 : scalar_mask;
+      u64* simd_out   = (round%4 == 3) ? 0 : simd_mask;
+      kinematics_step_scalar(&scalar.k, first, TEST_KINEMATICS_COUNT, SIM_DELTA_TIME, view_dim, scalar_out);
+      kinematics_step_sse2(&simd.k, first, TEST_KINEMATICS_COUNT, SIM_DELTA_TIME, view_dim, simd_out);
+#if GAME_AVX2
+      u64* avx2_out = (round%4 == 3) ? 0 : avx2_mask;
+      if(has_avx2) kinematics_step_avx2(&avx2.k, first, TEST_KINEMATICS_COUNT, SIM_DELTA_TIME, view_dim, avx2_out);
+#endif
+    }
+
+    b32 same = true;
+    Loop(a, 8) Loop(i, TEST_KINEMATICS_COUNT) same = same && test_same_bits(scalar.arrays[a][i], simd.arrays[a][i]);
+    test_check(same, "kinematics_step", round);
+
+    Loop(w, ArrayCount(scalar_mask)) test_check(scalar_mask[w] == simd_mask[w], "kinematics_step offscreen", round);
+    
+    if(!has_avx2) continue;
+    same = true;
+    Loop(a, 8) Loop(i, TEST_KINEMATICS_COUNT) same = same && test_same_bits(scalar.arrays[a][i], avx2.arrays[a][i]);
+    test_check(same, "kinematics_step avx2", round);
+    
+    Loop(w, ArrayCount(scalar_mask)) test_check(scalar_mask[w] == avx2_mask[w], "kinematics_step avx2 offscreen", round);
+  }
+#endif
+}
+
+void bench_kinematics_kernels(void) {
+#if GAME_SSE2 && !GAME_DETERMINISTIC
+  Random_Series series;
+  random_begin(&series, 42);
+
+  static Test_Kinematics t;
+  test_kinematics_init(&t);
+
+  u64 mask[BIT_SET_WORD_COUNT(TEST_KINEMATICS_COUNT)];
+  Vec2 view_dim = {WINDOW_WIDTH, WINDOW_HEIGHT};
+  test_fill_kinematics(&series, &t.k, view_dim);
+  Loop(i, TEST_KINEMATICS_COUNT) t.k.friction[i] = 1.0f; // otherwise the velocities end up denormal
+
+  f64 scalar_seconds, simd_seconds, avx2_seconds = 0.0;
+  TestBench(scalar_seconds, 10000, kinematics_step_scalar(&t.k, 0, TEST_KINEMATICS_COUNT, SIM_DELTA_TIME, view_dim, mask));
+  TestBench(simd_seconds,   10000, kinematics_step_sse2(&t.k, 0, TEST_KINEMATICS_COUNT, SIM_DELTA_TIME, view_dim, mask));
+#if GAME_AVX2
+  if(test_has_avx2()) TestBench(avx2_seconds, 10000, kinematics_step_avx2(&t.k, 0, TEST_KINEMATICS_COUNT, SIM_DELTA_TIME, view_dim, mask));
+#endif
+  test_print_bench("kinematics_step", TEST_KINEMATICS_COUNT, scalar_seconds, simd_seconds, avx2_seconds);
+#endif
+}
+
+//
+// Random fill
+//
+// random_fill_f32_sse2 the same bits and the same series after as random_fill_f32_scalar,
+// every lane its own series a jump apart, and the particle streams all different.
+//
+
+#define TEST_FILL_COUNT 203 // not a multiple of 4, so the tail runs too
+
+void test_random_kernels(void) {
+  Random_Series series;
+  random_begin(&series, 47);
+  Random_Series_Wide wide;
+  random_begin_wide(&wide, &series);
+
+  // lane k draws what the k times jumped series would, at u32 precision before scaling
+  {
+    Random_Series lanes[4];
+    random_begin(&lanes[0], 47);
+    for(s32 lane = 1; lane < 4; lane++) {
+      lanes[lane] = lanes[lane - 1];
+      random_jump(&lanes[lane]);
+    }
+
+    Random_Series_Wide copy = wide;
+    f32 out[16];
+    random_fill_f32_scalar(&copy, out, ArrayCount(out), 0.0f, 1.0f);
+    Loop(i, ArrayCount(out)) test_check(test_same_bits(out[i], random_f32(&lanes[i%4])), "random_fill_f32 lanes", i);
+  }
+
+  Loop(round, 8) {
+    s32 count = round == 0 ? 1 : TEST_FILL_COUNT - round;
+    f32 min = -10.0f*round, max = 3.0f + round;
+
+    Random_Series_Wide scalar_wide = wide;
+    f32 scalar_out[TEST_FILL_COUNT];
+    random_fill_f32_scalar(&scalar_wide, scalar_out, count, min, max);
+
+    b32 in_range = true;
+    Loop(i, count) in_range = in_range && scalar_out[i] >= min && scalar_out[i] <= max;
+    test_check(in_range, "random_fill_f32 range", round);
+
+#if GAME_SSE2
+    Random_Series_Wide simd_wide = wide;
+    f32 simd_out[TEST_FILL_COUNT];
+    random_fill_f32_sse2(&simd_wide, simd_out, count, min, max);
+
+    b32 same = true;
+    Loop(i, count) same = same && test_same_bits(scalar_out[i], simd_out[i]);
+    test_check(same, "random_fill_f32", round);
+    test_check(memcmp(&scalar_wide, &simd_wide, sizeof(wide)) == 0, "random_fill_f32 series", round);
+#endif
+    wide = scalar_wide;
+  }
+
+  // the workers' particle streams never share a series
+  Random_State saved = random_save();
+  random_begin(47u);
+  test_check(random_particle_stream() == &global_particle_streams[0], "random_particle_stream main", 0);
+  Loop(a, MAX_JOB_WORKERS) {
+    for(s32 b = a + 1; b < MAX_JOB_WORKERS; b++) {
+      test_check(memcmp(&global_particle_streams[a], &global_particle_streams[b], sizeof(Random_Series_Wide)) != 0,
+                 "particle streams", a*MAX_JOB_WORKERS + b);
+    }
+  }
+  random_restore(&saved);
+}
+
+void bench_random_kernels(void) {
+#if GAME_SSE2
+  Random_Series series;
+  random_begin(&series, 47);
+  Random_Series_Wide wide;
+  random_begin_wide(&wide, &series);
+
+  // a particle trail, and a lot of numbers
+  f32 out[512];
+  s32 counts[] = {8, 512};
+  Loop(c, ArrayCount(counts)) {
+    s32 count = counts[c];
+    f64 scalar_seconds, simd_seconds;
+    TestBench(scalar_seconds, 10000, random_fill_f32_scalar(&wide, out, count, 1.0f, 3.0f));
+    TestBench(simd_seconds,   10000, random_fill_f32_sse2(&wide, out, count, 1.0f, 3.0f));
+    test_print_bench("random_fill_f32", count, scalar_seconds, simd_seconds);
+  }
+#endif
+}
+
+//
+// All of them
+//
+// One test for every entry of Math_Kernels and for every other table a bind_kernels
+// fills in.
+//
+
+void test_kernels(void) {
+  test_trig_kernels();
+  test_vec2_kernels();
+  test_collision_kernels();
+  test_friction_per_tick();
+  test_kinematics_kernels();
+  test_random_kernels();
+}
+
+void bench_kernels(void) {
+  printf("kernels, per call:\n");
+  bench_trig_kernels();
+  bench_vec2_kernels();
+  bench_collision_kernels();
+  bench_kinematics_kernels();
+  bench_random_kernels();
+}
@@ -0,0 +1,435 @@
+//
+// Contacts
+//
+// Every report mode against a plain loop over all pairs, on every worker count. The
+// bodies are packed into a small area so most pairs overlap and the shared pair array gets
+// filled up to what contact_pair_bound allows.
+//
+
+#define TEST_CONTACT_A_COUNT MAX_CHAIN_CIRCLES
+#define TEST_CONTACT_B_COUNT MAX_PLAYER_PROJECTILES
+
+b32 test_contact_hit(Contact_Test test, Contact_Body* a, Contact_Body* b) {
+  b32 r = false;
+  switch(test) {
+    case Contact_Test_Circles: { r = vec2_length(a->start - b->start) <= a->radius + b->radius;          } break;
+    case Contact_Test_Swept_A: { r = capsule_vs_circle(a->start, a->end, a->radius, b->start, b->radius); } break;
+    case Contact_Test_Swept_B: { r = capsule_vs_circle(b->start, b->end, b->radius, a->start, a->radius); } break;
+  }
+  return r;
+}
+
+void test_contact_pass(Random_Series* series, Contact_Test test, Contact_Report report, f32 spread, s32 round) {
+  Contact_System* cs = &global_contact_system;
+
+  // The same bodies for every worker count.
+  Random_Series start = *series;
+  s32 max_workers = job_started_count();
+
+  for(s32 workers = 1; workers <= max_workers; workers++) {
+    job_system_use_workers(workers);
+    *series = start;
+
+    contact_pass_begin(test, report);
+    Loop(i, TEST_CONTACT_A_COUNT) {
+      Vec2 pos = vec2(WINDOW_WIDTH/2, 300) + test_random_vec2(series, -spread, spread);
+      Vec2 move = (test == Contact_Test_Swept_A) ? test_random_vec2(series, -40.0f, 40.0f) : vec2(0, 0);
+      contact_add_a((u32)i, pos - move, pos, 2.0f + random_f32(series)*20.0f);
+    }
+    Loop(i, TEST_CONTACT_B_COUNT) {
+      Vec2 pos = vec2(WINDOW_WIDTH/2, 300) + test_random_vec2(series, -spread, spread);
+      Vec2 move = (test == Contact_Test_Swept_B) ? test_random_vec2(series, -40.0f, 40.0f) : vec2(0, 0);
+      contact_add_b((u32)i, pos - move, pos, 2.0f + random_f32(series)*20.0f);
+    }
+
+    Contact_Pairs pairs = contact_pass_run();
+    test_check(cs->dropped == 0, "contacts, nothing dropped", round);
+
+    // Every pair is one that overlaps, in order and only once.
+    b32 pairs_ok = true;
+    Loop(k, pairs.count) {
+      u32 a = contact_a(pairs.keys[k]);
+      u32 b = contact_b(pairs.keys[k]);
+      if(!test_contact_hit(test, &cs->a[a], &cs->b[b])) pairs_ok = false;
+      if(k > 0 && pairs.keys[k - 1] >= pairs.keys[k])   pairs_ok = false;
+    }
+    test_check(pairs_ok, "contacts, sorted overlapping pairs", round);
+
+    // And the ones the mode asks for are there.
+    s32 next = 0;
+    Loop(a, cs->a_count) {
+      s32 first = next;
+      while(next < pairs.count && contact_a(pairs.keys[next]) == a) next += 1;
+
+      s32 expected_count = 0;
+      s32 expected_first_b = -1;
+      Loop(b, cs->b_count) {
+        if(!test_contact_hit(test, &cs->a[a], &cs->b[b])) continue;
+        if(expected_first_b < 0) expected_first_b = (s32)b;
+        expected_count += 1;
+      }
+
+      switch(report) {
+        case Contact_Report_All: {
+          test_check(next - first == expected_count, "contacts, all pairs", round);
+        } break;
+        case Contact_Report_First_B_Per_A: {
+          b32 ok = (expected_first_b < 0) ? next == first : next > first && (s32)contact_b(pairs.keys[first]) == expected_first_b;
+          test_check(ok, "contacts, first B per A", round);
+        } break;
+        case Contact_Report_Any_A_Per_B: break;
+      }
+    }
+
+    if(report == Contact_Report_Any_A_Per_B) {
+      Loop(b, cs->b_count) {
+        b32 expected = false;
+        Loop(a, cs->a_count) expected |= test_contact_hit(test, &cs->a[a], &cs->b[b]);
+
+        b32 found = false;
+        Loop(k, pairs.count) found |= contact_b(pairs.keys[k]) == b;
+        test_check(found == expected, "contacts, any A per B", round);
+      }
+    }
+  }
+  job_system_use_workers(max_workers);
+}
+
+void test_contacts(void) {
+  Random_Series series;
+  random_begin(&series, 41);
+
+  Loop(round, 8) {
+    // From everything overlapping to bodies spread over the whole screen.
+    f32 spread = (round%4 == 0) ? 10.0f : 40.0f + random_f32(&series)*600.0f;
+
+    test_contact_pass(&series, Contact_Test_Circles, Contact_Report_All,           spread, (s32)round);
+    test_contact_pass(&series, Contact_Test_Swept_B, Contact_Report_All,           spread, (s32)round);
+    test_contact_pass(&series, Contact_Test_Swept_A, Contact_Report_First_B_Per_A, spread, (s32)round);
+    test_contact_pass(&series, Contact_Test_Circles, Contact_Report_Any_A_Per_B,   spread, (s32)round);
+  }
+}
+
+//
+// Simulation benchmarks
+//
+// One level played headless, the same seed and the same keys every run. The player starts
+// over when dead or when the level is done. Each run ends with a hash of the simulation
+// state, runs on different worker counts have to come out the same.
+//
+
+#define BENCH_SEED 1234
+
+struct Bench_Run {
+  f64 seconds_per_tick;
+  u64 state_hash;
+  s32 restart_count;
+};
+
+// Toggles the movement and shooting keys at random, about every 32 ticks each.
+void bench_press_keys(Random_Series* series) {
+  s32 keys[] = {KEY_W, KEY_A, KEY_S, KEY_D, KEY_UP, KEY_DOWN, KEY_LEFT, KEY_RIGHT};
+  Loop(i, ArrayCount(keys)) {
+    if(random_chance(series, 32)) headless_keys_down[keys[i]] = !headless_keys_down[keys[i]];
+  }
+}
+
+u64 bench_state_hash(void) {
+  write_sim_state(global_state_sections);
+
+  u64 r = 0;
+  Loop(i, State_Section_Count) {
+    State_Section* section = &global_state_sections[i];
+    r = hash64(section->words, section->word_count*sizeof(u32), r);
+  }
+  return r;
+}
+
+// The level starts on tick 0 the way a replay does. Played more than once, so the
+// tutorial is skipped and goons come from the start.
+void bench_start_level(u32 seed) {
+  Game_State* gs = get_game_state();
+
+  random_begin(seed);
+  gs->sim_tick = 0;
+  timer_clock_set_tick(gs->sim_tick);
+  gs->level_played_times = 2;
+  set_level_to_initial_state();
+}
+
+// One tick with the keys pressed, true if the player had to start over.
+b32 bench_play_tick(Random_Series* keys) {
+  Game_State* gs = get_game_state();
+  
+  bench_press_keys(keys);
+  simulate_game(true);
+
+  b32 is_player_dead    = get_player()->hit_points <= 0;
+  b32 is_level_finished = gs->level_time_passed > gs->level_duration;
+  if(is_player_dead || is_level_finished) {
+    set_level_to_initial_state();
+    return true;
+  }
+  return false;
+}
+
+Bench_Run bench_play_level(u32 seed, s32 tick_count) {
+  Bench_Run r = {};
+
+  Random_Series keys;
+  random_begin(&keys, seed);
+  Loop(i, ArrayCount(headless_keys_down)) headless_keys_down[i] = false;
+
+  bench_start_level(seed);
+
+  f64 start_time = GetTime();
+  Loop(tick, tick_count) {
+    if(bench_play_tick(&keys)) r.restart_count += 1;
+  }
+  r.seconds_per_tick = (GetTime() - start_time)/(f64)tick_count;
+
+  r.state_hash = bench_state_hash();
+  return r;
+}
+
+// 1 up to every started worker. The state has to be the same on all of them.
+void bench_worker_scaling(s32 tick_count) {
+  s32 max_workers = job_started_count();
+  printf("simulation at %d Hz, %d ticks of seed %d, %d worker%s started:\n", SIM_TICKS_PER_SECOND, tick_count, BENCH_SEED, max_workers, max_workers == 1 ? "" : "s");
+
+  Bench_Run first = {};
+  for(s32 workers = 1; workers <= max_workers; workers++) {
+    job_system_use_workers(workers);
+    Bench_Run run = bench_play_level(BENCH_SEED, tick_count);
+    if(workers == 1) first = run;
+
+    printf("  %2d worker%s %7.3f ms/tick, %5.2fx, %d restarts, state %016llx\n",
+           workers, workers == 1 ? ": " : "s:", run.seconds_per_tick*1000.0, first.seconds_per_tick/run.seconds_per_tick,
+           run.restart_count, (unsigned long long)run.state_hash);
+    test_check(run.state_hash == first.state_hash, "same state on any worker count", workers);
+    test_check(atomic_load_s32(&get_game_state()->sim_events.dropped) == 0, "no sim events dropped", workers);
+  }
+  job_system_use_workers(max_workers);
+}
+
+//
+// Projectiles
+//
+// A player bullet moves 650*SIM_DELTA_TIME in one tick, more than twice that at 30 Hz. A
+// small target in the middle of the step has to be hit, and one just past where the step
+// ends must not be.
+//
+
+void test_bullet_step(void) {
+  bench_start_level(BENCH_SEED);
+  Projectile_Pool* pool = get_projectile_pool(Projectile_Faction_Player);
+
+  Projectile* p = new_projectile(Projectile_Faction_Player);
+  s32 index = (s32)(p - pool->projectiles);
+  p->radius = 6;
+  p->dir = vec2(1, 0);
+  p->move_speed = 650;
+  Vec2 start = vec2(100, 300);
+  projectile_place(pool, p, start);
+  // ranges go by whole words of the active mask
+  s32 first = index/64*64;
+  move_projectile_range(pool, first, first + 64);
+
+  f32 step = 650.0f*SIM_DELTA_TIME;
+  test_check(Abs(projectile_pos(pool, p).x - (start.x + step)) <= 1e-2f, "bullet step, moved one tick", 0);
+  test_check(check_projectile_vs_circle(pool, p, start + vec2(step*0.5f, 1.0f), 2.0f), "bullet step, hits what it passed", 0);
+  test_check(!check_projectile_vs_circle(pool, p, start + vec2(step + 9.0f, 0.0f), 2.0f), "bullet step, misses what's ahead", 0);
+  remove_projectile(pool, p);
+}
+
+// Nothing in the game gives projectiles a life time right now, so the wheel path gets
+// checked here: it goes off on time, and not on a new bullet in the slot of one that left
+// the screen before its time was up.
+void test_projectile_life_time(void) {
+  Game_State* gs = get_game_state();
+  bench_start_level(BENCH_SEED);
+  Projectile_Pool* pool = get_projectile_pool(Projectile_Faction_Chain);
+
+  Projectile* p = new_projectile(Projectile_Faction_Chain);
+  s32 index = (s32)(p - pool->projectiles);
+  projectile_place(pool, p, vec2(100, 100));
+  projectile_set_life_time(pool, p, 4*SIM_DELTA_TIME);
+
+  Loop(tick, 6) {
+    gs->sim_tick += 1;
+    process_timer_events();
+    test_check(bit_set_is_set(pool->active_mask, index) == (tick < 3), "projectile life time, expires on its tick", tick);
+  }
+
+  // left the screen, and the slot went round the pool to a bullet without a life time
+  p = new_projectile(Projectile_Faction_Chain);
+  index = (s32)(p - pool->projectiles);
+  projectile_set_life_time(pool, p, 2*SIM_DELTA_TIME);
+  projectile_deactivate(pool, p);
+  Loop(i, pool->capacity) p = new_projectile(Projectile_Faction_Chain);
+  test_check(p == &pool->projectiles[index], "projectile life time, slot reused", 0);
+
+  Loop(tick, 4) {
+    gs->sim_tick += 1;
+    process_timer_events();
+  }
+  test_check(bit_set_is_set(pool->active_mask, index), "projectile life time, old timer cancelled", 0);
+}
+
+//
+// Snapshots
+//
+// The rollback check saves a snapshot every so often, plays on, goes back to it and plays
+// the same ticks with the same keys again. Both times have to end in the same state, the
+// same hash and the same bytes of the whole snapshot block. A save and a restore, what a
+// rollback pays before replaying, have to stay in budget on every run, the benchmark only
+// times more of them.
+//
+
+#define TEST_ROLLBACK_TICKS     120 // fewer than SIM_SNAPSHOT_COUNT - 1 saves of SIM_SNAPSHOT_INTERVAL
+#ifndef TEST_SNAPSHOT_BUDGET_US
+#define TEST_SNAPSHOT_BUDGET_US 50 // of an optimized build, sanitizer builds pass their own
+#endif
+
+// The snapshot block as a save would copy it, with the random streams in it. The player's
+// flap follows the wall clock and is only drawn, it's zeroed. The update and draw times
+// do too, but they sit in front of the block.
+void test_copy_sim_block(u8* out) {
+  Game_State* gs = get_game_state();
+  Snapshot_Ring* ring = &gs->snapshots;
+  
+  gs->random = random_save();
+  memcpy(out, ring->block, (size_t)ring->block_size);
+  
+  s64 flap_offset = (u8*)&get_player()->flap - ring->block;
+  memset(out + flap_offset, 0, sizeof(get_player()->flap));
+}
+
+// How many saves before the newest one the copy of 'tick' is, -1 if it's gone.
+s32 test_snapshot_back(Snapshot_Ring* ring, u32 tick) {
+  Loop(back, ring->count) {
+    s32 index = (ring->newest - (s32)back + ring->capacity) % ring->capacity;
+    if(ring->ticks[index] == tick) return (s32)back;
+  }
+  return -1;
+}
+
+void test_rollback(s32 tick_count) {
+  Game_State* gs = get_game_state();
+  
+  Random_Series keys;
+  random_begin(&keys, BENCH_SEED);
+  Loop(i, ArrayCount(headless_keys_down)) headless_keys_down[i] = false;
+  bench_start_level(BENCH_SEED);
+
+  s64 block_size = gs->snapshots.block_size;
+  u8* played_block   = (u8*)MemAlloc((u32)block_size);
+  u8* replayed_block = (u8*)MemAlloc((u32)block_size);
+
+  s32 rollback_count = 0;
+  Loop(tick, tick_count) {
+    bench_play_tick(&keys);
+    if(tick%500 != 250) continue;
+
+    save_sim_snapshot();
+    u32 start_tick = gs->sim_tick;
+    Random_Series start_keys = keys;
+    b32 start_keys_down[ArrayCount(headless_keys_down)];
+    memcpy(start_keys_down, headless_keys_down, sizeof(start_keys_down));
+
+    // a restart clears the snapshots, there's nothing to go back to
+    b32 restarted = false;
+    Loop(i, TEST_ROLLBACK_TICKS) restarted |= bench_play_tick(&keys);
+    if(restarted) continue;
+    u64 played_hash = bench_state_hash();
+    test_copy_sim_block(played_block);
+
+    b32 restored = restore_sim_snapshot(test_snapshot_back(&gs->snapshots, start_tick));
+    test_check(restored && gs->sim_tick == start_tick, "rollback, restore", rollback_count);
+
+    keys = start_keys;
+    memcpy(headless_keys_down, start_keys_down, sizeof(start_keys_down));
+    Loop(i, TEST_ROLLBACK_TICKS) bench_play_tick(&keys);
+    test_check(bench_state_hash() == played_hash, "rollback, same state played again", rollback_count);
+    test_copy_sim_block(replayed_block);
+    test_check(memcmp(played_block, replayed_block, (size_t)block_size) == 0, "rollback, same bytes played again", rollback_count);
+
+    rollback_count += 1;
+  }
+  printf("rollback: %d times %d ticks\n", rollback_count, TEST_ROLLBACK_TICKS);
+  test_check(atomic_load_s32(&gs->sim_events.dropped) == 0, "no sim events dropped", 0);
+  
+  MemFree(played_block);
+  MemFree(replayed_block);
+}
+
+// The best of a few runs of 'calls' saves and restores.
+void test_snapshot_budget(s32 calls) {
+  Snapshot_Ring* ring = &get_game_state()->snapshots;
+  save_sim_snapshot();
+
+  f64 seconds;
+  TestBench(seconds, calls, { save_sim_snapshot(); restore_sim_snapshot(0); });
+  printf("snapshot of %lld KB, save and restore %.1f us, allowed %d us\n",
+         (long long)ring->block_size/1024, seconds*1e6, TEST_SNAPSHOT_BUDGET_US);
+  test_check(seconds*1e6 <= TEST_SNAPSHOT_BUDGET_US, "snapshot save and restore in budget", 0);
+}
+
+//
+// Replays
+//
+// A level played with the bench keys is recorded to TEST_REPLAY_PATH and then checked with
+// the scalar kernels bound, which have to give the same states as the SIMD ones that
+// recorded it. The file stays, so 'game_test check path' of another build (the build.bat
+// one against a Linux one, or a GAME_DETERMINISTIC build on another compiler) checks the
+// same replay there.
+//
+
+#define TEST_REPLAY_TICKS 2000
+#define TEST_REPLAY_PATH  "game_test.replay"
+
+void test_bind_kernels(Simd_Level level) {
+  math_bind_kernels(level);
+  random_bind_kernels(level);
+  kinematics_bind_kernels(level);
+}
+
+// Plays the replay at path, true if every state it has matched.
+b32 test_check_replay(char* path) {
+  Game_State* gs = get_game_state();
+  Replay* r = &global_replay;
+
+  replay_open(NULL, path);
+  if(!replay_is_checking()) return false;
+
+  gs->level_played_times = replay_level_played_times();
+  set_level_to_initial_state();
+  while(replay_is_checking()) simulate_game(true);
+
+  b32 matches = r->state_count > 0 && r->mismatch_count == 0;
+  printf("replay: %s, %d ticks, %d of %d states differ\n", path, r->tick_count, r->mismatch_count, r->state_count);
+  replay_close();
+  return matches;
+}
+
+void test_replay(void) {
+  Game_State* gs = get_game_state();
+
+  Random_Series keys;
+  random_begin(&keys, BENCH_SEED);
+  Loop(i, ArrayCount(headless_keys_down)) headless_keys_down[i] = false;
+
+  // Starting the level over would start the file over too, so the recording ends there.
+  replay_open(TEST_REPLAY_PATH, NULL);
+  bench_start_level(BENCH_SEED);
+  Loop(tick, TEST_REPLAY_TICKS) {
+    bench_press_keys(&keys);
+    simulate_game(true);
+    if(get_player()->hit_points <= 0 || gs->level_time_passed > gs->level_duration) break;
+  }
+  replay_close();
+
+  test_bind_kernels(Simd_Level_Scalar);
+  test_check(test_check_replay(TEST_REPLAY_PATH), "replay, same states with the scalar kernels", 0);
+  test_bind_kernels(cpu_simd_level(false));
+}